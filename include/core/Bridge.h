@@ -3,13 +3,17 @@
 
 #include <QObject>
 #include <QString>
+#include <QVariantMap>
 #include <QVideoSink>
 #include <memory>
 #include <vector>
 #include <mutex>
+#include <atomic>
 #include "filters/QmlVideoSinkFilter.h"
 #include "core/Filter.h"
 
+class QThread;
+
 namespace pb
 {
     class TeeFilter;
@@ -20,6 +24,14 @@ class Bridge : public QObject
     Q_OBJECT
     Q_PROPERTY(QVideoSink *videoSink READ videoSink WRITE setVideoSink NOTIFY videoSinkChanged)
     Q_PROPERTY(QStringList hwTypes READ hwTypes CONSTANT)
+    Q_PROPERTY(bool adaptiveBitrate READ adaptiveBitrate WRITE setAdaptiveBitrate NOTIFY adaptiveBitrateChanged)
+    Q_PROPERTY(bool loopInput READ loopInput WRITE setLoopInput NOTIFY loopInputChanged)
+    Q_PROPERTY(int pacingMode READ pacingMode WRITE setPacingMode NOTIFY pacingModeChanged)
+    Q_PROPERTY(bool jitterBuffer READ jitterBuffer WRITE setJitterBuffer NOTIFY jitterBufferChanged)
+    Q_PROPERTY(bool audioPassthrough READ audioPassthrough WRITE setAudioPassthrough NOTIFY audioPassthroughChanged)
+    Q_PROPERTY(bool recordDirectIo READ recordDirectIo WRITE setRecordDirectIo NOTIFY recordDirectIoChanged)
+    Q_PROPERTY(bool udpPacing READ udpPacing WRITE setUdpPacing NOTIFY udpPacingChanged)
+    Q_PROPERTY(bool contentAdaptive READ contentAdaptive WRITE setContentAdaptive NOTIFY contentAdaptiveChanged)
 
 public:
     explicit Bridge(QObject *parent = nullptr);
@@ -28,21 +40,96 @@ public:
     QVideoSink *videoSink() const;
     void setVideoSink(QVideoSink *sink);
     QStringList hwTypes() const;
+    bool adaptiveBitrate() const { return m_adaptiveBitrate; }
+    void setAdaptiveBitrate(bool enabled);
+    // 文件输入到达结尾后从头循环 (对下一次启动的管线生效)
+    bool loopInput() const { return m_loopInput; }
+    void setLoopInput(bool enabled);
+    // 输入节拍：0 自动 (文件与点播实时、直播协议不节拍)，1 始终实时，2 全速 (批量转码)
+    int pacingMode() const { return m_pacingMode; }
+    void setPacingMode(int mode);
+    // 网络输入在解码前经过自适应抖动缓冲 (对下一次启动的管线生效)
+    bool jitterBuffer() const { return m_jitterBuffer; }
+    void setJitterBuffer(bool enabled);
+    // 输入带音频时以压缩形式直通到推流 / RTSP 输出 (对下一次启动的管线生效)
+    bool audioPassthrough() const { return m_audioPassthrough; }
+    void setAudioPassthrough(bool enabled);
+    // 本地录制文件使用 O_DIRECT 写入，绕过页缓存 (对下一次启动的管线生效)
+    bool recordDirectIo() const { return m_recordDirectIo; }
+    void setRecordDirectIo(bool enabled);
+    // udp:// / rtp:// 推流按节拍发送，平滑关键帧突发 (对下一次启动的管线生效)
+    bool udpPacing() const { return m_udpPacing; }
+    void setUdpPacing(bool enabled);
+    // 编码时识别屏幕 / 自然画面并在 GOP 边界切换编码参数，libx264 每次切换都要重建编码器 (对下一次启动的管线生效)
+    bool contentAdaptive() const { return m_contentAdaptive; }
+    void setContentAdaptive(bool enabled);
 
     Q_INVOKABLE void startPlay(const QString &url, const QString &hwType, int latencyLevel = 1);
     Q_INVOKABLE void startServe(const QString &source, int port, const QString &name, const QString &encoder, const QString &hw, int fps = 30, int latencyLevel = 1, bool echo = false, const QString &address = "");
     Q_INVOKABLE void startPush(const QString &input, const QString &output, const QString &encoder, const QString &hw, int fps = 30, int latencyLevel = 1, bool echo = false);
+    // 一次编码同时推送到多个输出 (如 RTMP + 本地录制 + UDP 组播)，每个输出独立排队与写出
+    Q_INVOKABLE void startPushMulti(const QString &input, const QStringList &outputs, const QString &encoder, const QString &hw, int fps = 30, int latencyLevel = 1, bool echo = false);
     Q_INVOKABLE void stopAll();
     Q_INVOKABLE QString urlToPath(const QUrl &url);
     Q_INVOKABLE QStringList getEncoders(const QString &codecType, const QString &hwType);
+    // 在不重建管线的情况下修改正在运行的编码器参数，bitrateKbps / fps 传 0 表示保持不变
+    Q_INVOKABLE bool updateEncoder(int bitrateKbps, int fps = 0);
+    // 运行中编码器的逐帧统计（延迟 / 大小直方图、分位数、按秒时间序列）
+    Q_INVOKABLE QVariantMap encoderStats();
+    // 运行中解码器的降级状态（落后时间、降级级别、丢弃帧数）
+    Q_INVOKABLE QVariantMap decoderStats();
+    // 网络输入抖动缓冲的状态（抖动、缓冲深度、乱序 / 迟到 / 丢失包数）
+    Q_INVOKABLE QVariantMap jitterStats();
+    // 推流输出写出队列的状态（排队帧数、写出耗时、整 GOP 丢弃次数），多输出时逐个列在 outputs 中
+    Q_INVOKABLE QVariantMap muxerStats();
+    // 将运行中编码器的逐帧数据写入 CSV（.json 则为 JSON Lines），空路径关闭
+    Q_INVOKABLE bool setEncoderTrace(const QString &path);
+    // 在后台校准编码器配置，之后 encoder 传 "auto" 的 startServe / startPush 会直接使用结果
+    Q_INVOKABLE void calibrateEncoders(int width, int height, int fps, const QString &hwType, int latencyLevel = 1);
 
 signals:
     void videoSinkChanged();
+    void adaptiveBitrateChanged();
+    void loopInputChanged();
+    void pacingModeChanged();
+    void jitterBufferChanged();
+    void audioPassthroughChanged();
+    void recordDirectIoChanged();
+    void udpPacingChanged();
+    void contentAdaptiveChanged();
+    void calibrationFinished(bool ok, const QString &encoder, const QString &preset, int threads, double fps, double psnr);
 
 private:
     pb::QmlVideoSinkFilter *m_qmlSink;
+    std::atomic<bool> m_adaptiveBitrate{false};
+    std::atomic<bool> m_loopInput{false};
+    std::atomic<int> m_pacingMode{0};
+    std::atomic<bool> m_jitterBuffer{true};
+    std::atomic<bool> m_audioPassthrough{true};
+    std::atomic<bool> m_recordDirectIo{false};
+    std::atomic<bool> m_udpPacing{true};
+    std::atomic<bool> m_contentAdaptive{false};
+    // 后台线程建链完成后登记；代数不匹配说明期间已 stopAll，新链直接丢弃
+    bool commitChain(uint64_t generation, const std::vector<std::shared_ptr<pb::Filter>> &filters);
+    // 登记正在初始化 (可能阻塞在网络 I/O) 的过滤器，stopAll 时可将其打断；同时记入建链线程自己的 tracked
+    void trackPending(std::vector<std::shared_ptr<pb::Filter>> &tracked, const std::shared_ptr<pb::Filter> &filter);
+    // 建链线程退出时调用：tracked 中未被 commitChain / stopAll 取走的过滤器撤销登记并停止
+    void releasePending(const std::vector<std::shared_ptr<pb::Filter>> &tracked);
+    // 建链线程进出时调用；有链在建或在运行时暂停后台编码器校准，避免与实时编码争抢 CPU
+    void beginBuild();
+    void endBuild();
+    // 需持有 m_chainMutex
+    void updateTunerGate();
+
     std::mutex m_chainMutex;
     std::vector<std::vector<std::shared_ptr<pb::Filter>>> m_chains;
+    std::vector<std::shared_ptr<pb::Filter>> m_pending;
+    std::atomic<uint64_t> m_generation{0};
+    int m_building = 0; // 正在后台建链的线程数 (受 m_chainMutex 保护)
+
+    // 手动校准在 Bridge 持有的线程中运行，析构时取消并等待
+    std::unique_ptr<QThread> m_calibrationThread;
+    std::atomic<bool> m_calibrationCancel{false};
 };
 
 #endif // BRIDGE_H
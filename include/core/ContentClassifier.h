@@ -0,0 +1,50 @@
+#ifndef CONTENTCLASSIFIER_H
+#define CONTENTCLASSIFIER_H
+
+#include <cstdint>
+#include <vector>
+
+namespace pb
+{
+    enum class ContentType
+    {
+        Natural = 0, // 摄像头 / 影视等自然画面
+        Screen = 1   // 桌面、文字、平坦色块，运动少
+    };
+
+    // 轻量级内容分类器：在隔行采样的亮度平面上统计运动、边缘和颜色分布，
+    // 并通过迟滞避免在两种编码配置之间来回切换。
+    class ContentClassifier
+    {
+    public:
+        struct Stats
+        {
+            double motion = 0.0;  // 与上一帧的平均绝对差 (每像素)
+            double flat = 0.0;    // 与右侧像素完全相等的比例
+            double edge = 0.0;    // 非平坦像素上的平均水平梯度
+            double topMass = 0.0; // 出现最多的 8 个亮度值所占比例
+        };
+
+        explicit ContentClassifier(ContentType initial = ContentType::Natural);
+
+        // 分析一帧亮度平面，返回当前（经过迟滞的）内容类型
+        ContentType analyze(const uint8_t *luma, int linesize, int width, int height);
+
+        ContentType current() const { return m_current; }
+        const Stats &lastStats() const { return m_lastStats; }
+        void reset(ContentType initial);
+
+    private:
+        Stats computeStats(const uint8_t *luma, int linesize, int width, int height);
+
+        ContentType m_current;
+        int m_votes = 0; // 连续偏向另一类型的次数
+        Stats m_lastStats;
+        std::vector<uint8_t> m_prevRows; // 上一帧的采样行，用于运动估计
+        int m_prevWidth = 0;
+        int m_prevHeight = 0;
+    };
+
+} // namespace pb
+
+#endif // CONTENTCLASSIFIER_H
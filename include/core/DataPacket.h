@@ -34,9 +34,13 @@ public:
     }
     PacketType type() const override { return PacketType::AV_PACKET; }
     AVPacket* get() { return packet; }
+    // 视频链路之外直通的压缩音频包标记为 AVMEDIA_TYPE_AUDIO
+    AVMediaType mediaType() const { return media_type; }
+    void setMediaType(AVMediaType type) { media_type = type; }
 
 private:
     AVPacket* packet = nullptr;
+    AVMediaType media_type = AVMEDIA_TYPE_VIDEO;
 };
 
 class AVFrameWrapper : public DataPacket {
@@ -0,0 +1,110 @@
+#ifndef ENCODERPROFILER_H
+#define ENCODERPROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+namespace pb
+{
+    // 编码器逐帧统计：send_frame -> receive_packet 延迟、输出大小、帧类型和 QP，
+    // 汇总为直方图与按秒滚动的时间序列，并可写出 CSV / JSON Lines 跟踪文件。
+    class EncoderProfiler
+    {
+    public:
+        struct Histogram
+        {
+            std::vector<double> bounds;   // 每个桶的上界，最后一个桶为 +inf
+            std::vector<uint64_t> counts; // bounds.size() + 1 个桶
+        };
+
+        struct SecondStats
+        {
+            int64_t second = 0; // 自开始统计以来的秒数
+            int frames = 0;
+            int keyframes = 0;
+            int64_t bytes = 0;
+            double avgLatencyMs = 0.0;
+            double maxLatencyMs = 0.0;
+            double avgQp = 0.0;
+        };
+
+        struct Snapshot
+        {
+            uint64_t frames = 0;
+            uint64_t keyframes = 0;
+            uint64_t stalls = 0;
+            double avgLatencyMs = 0.0;
+            double p50LatencyMs = 0.0;
+            double p95LatencyMs = 0.0;
+            double p99LatencyMs = 0.0;
+            double maxLatencyMs = 0.0;
+            double avgSize = 0.0;
+            double avgQp = 0.0;
+            Histogram latency;
+            Histogram size;
+            std::vector<SecondStats> timeline;
+        };
+
+        EncoderProfiler();
+        ~EncoderProfiler();
+
+        // 帧间隔决定卡顿阈值 (5 个帧间隔，至少 200 ms)
+        void setFrameInterval(double ms);
+        void onFrameSent(int64_t pts);
+        void onPacket(const AVPacket *pkt);
+
+        Snapshot snapshot() const;
+        void reset();
+
+        // 扩展名为 .json 时写 JSON Lines，否则写 CSV；空路径关闭跟踪
+        bool setTraceFile(const std::string &path);
+
+    private:
+        struct Accumulator
+        {
+            SecondStats stats;
+            double latencySum = 0.0;
+            double qpSum = 0.0;
+            int qpSamples = 0;
+        };
+
+        void pushSecond(int64_t second);
+
+        mutable std::mutex m_mutex;
+        std::chrono::steady_clock::time_point m_start;
+        std::deque<std::pair<int64_t, std::chrono::steady_clock::time_point>> m_pending;
+
+        double m_stallThresholdMs = 200.0;
+        uint64_t m_frames = 0;
+        uint64_t m_keyframes = 0;
+        uint64_t m_stalls = 0;
+        double m_latencySum = 0.0;
+        double m_maxLatency = 0.0;
+        double m_sizeSum = 0.0;
+        double m_qpSum = 0.0;
+        uint64_t m_qpSamples = 0;
+        Histogram m_latencyHist;
+        Histogram m_sizeHist;
+        std::vector<double> m_recentLatency; // 环形缓冲，用于分位数
+        size_t m_recentPos = 0;
+
+        Accumulator m_current;
+        std::deque<SecondStats> m_timeline;
+
+        std::ofstream m_trace;
+        bool m_traceJson = false;
+    };
+
+} // namespace pb
+
+#endif // ENCODERPROFILER_H
@@ -0,0 +1,90 @@
+#ifndef ENCODERTUNER_H
+#define ENCODERTUNER_H
+
+#include "core/Filter.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace pb
+{
+    struct EncoderConfig
+    {
+        std::string encoder;
+        std::string preset; // 空表示编码器默认
+        int threads = 0;    // 0 表示自动
+
+        // 校准结果
+        double fps = 0.0;       // 吞吐量
+        double latencyMs = 0.0; // send_frame -> receive_packet 平均延迟
+        double psnr = 0.0;      // 亮度 PSNR (dB)
+    };
+
+    // 编码器自动调优：用合成画面跑一遍候选 编码器 / 预设 / 线程数，
+    // 按分辨率、帧率、硬件类型和延迟等级记住满足目标的最快配置。
+    class EncoderTuner
+    {
+    public:
+        static EncoderTuner &instance()
+        {
+            static EncoderTuner inst;
+            return inst;
+        }
+
+        ~EncoderTuner();
+
+        // 运行校准并持久化结果，返回是否找到可用配置；cancelled 在每个候选之间检查，返回 true 时放弃 (不保存)
+        bool calibrate(int width, int height, int fps, const std::string &hwType, LatencyLevel level, EncoderConfig &best,
+                       const std::function<bool()> &cancelled = nullptr);
+        // 查找之前的校准结果
+        bool lookup(int width, int height, int fps, const std::string &hwType, LatencyLevel level, EncoderConfig &out);
+        // 未校准时的保守默认配置 (最快预设)，encoder 为空表示该硬件类型没有可用编码器
+        EncoderConfig defaultConfig(const std::string &hwType, LatencyLevel level) const;
+        // 排入后台校准，结果写入表中供之后的启动使用；同一组参数只排一次。
+        // 校准与实时编码争抢 CPU 会把吞吐量测低，因此只在没有管线运行时进行，中途有管线启动则放弃并稍后重跑
+        void calibrateInBackground(int width, int height, int fps, const std::string &hwType, LatencyLevel level);
+        // 由 Bridge 在管线启动 / 全部停止时通知
+        void setPipelinesRunning(bool running);
+
+    private:
+        EncoderTuner();
+
+        std::vector<EncoderConfig> candidates(const std::string &hwType, LatencyLevel level) const;
+        bool measure(EncoderConfig &cfg, int width, int height, int fps, const std::string &hwType, LatencyLevel level);
+        static std::string key(int width, int height, int fps, const std::string &hwType, LatencyLevel level);
+        void load();
+        void save();
+        void workerLoop();
+
+        struct Job
+        {
+            int width;
+            int height;
+            int fps;
+            std::string hwType;
+            LatencyLevel level;
+        };
+
+        std::mutex m_mutex;
+        std::map<std::string, EncoderConfig> m_table;
+        std::set<std::string> m_inFlight; // 已排队或正在后台校准的 key
+        std::string m_path;
+
+        // 后台校准线程：首次排队时启动，析构时 join
+        std::thread m_worker;
+        std::condition_variable m_cv;
+        std::deque<Job> m_jobs;
+        std::atomic<bool> m_pipelinesRunning{false};
+        std::atomic<bool> m_shutdown{false};
+    };
+
+} // namespace pb
+
+#endif // ENCODERTUNER_H
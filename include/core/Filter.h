@@ -23,6 +23,8 @@ namespace pb
         virtual void process(DataPacket::Ptr packet) = 0;
         virtual void start() {}
         virtual void stop() = 0;
+        // 只发出停止信号、打断阻塞中的 I/O，不等待线程退出；随后仍需调用 stop()
+        virtual void requestStop() {}
 
         void setNextFilter(Filter *next)
         {
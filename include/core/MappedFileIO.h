@@ -0,0 +1,53 @@
+#ifndef MAPPEDFILEIO_H
+#define MAPPEDFILEIO_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+extern "C"
+{
+#include <libavformat/avio.h>
+}
+
+namespace pb
+{
+    struct MappedRegion;
+
+    // 基于 mmap 的只读 AVIOContext：同一文件的多个管线共享一份映射 (和页缓存)，
+    // 顺序读取时提前 madvise(WILLNEED) 按 2MB 对齐的窗口预读。
+    // 每次读之前 fstat 确认文件未被截断或改写，否则 (访问映射会触发 SIGBUS) 改用 pread 读取。
+    // 仅 POSIX 平台可用，其他平台 open() 返回 nullptr，调用方回退到 FFmpeg 的 file 协议。
+    class MappedFileIO
+    {
+    public:
+        static std::unique_ptr<MappedFileIO> open(const std::string &path);
+        ~MappedFileIO();
+
+        MappedFileIO(const MappedFileIO &) = delete;
+        MappedFileIO &operator=(const MappedFileIO &) = delete;
+
+        // 交给 AVFormatContext::pb 使用 (需设置 AVFMT_FLAG_CUSTOM_IO)，生命周期由本对象管理
+        AVIOContext *context() const { return m_avio; }
+        int64_t size() const;
+
+    private:
+        MappedFileIO() = default;
+
+        static int readPacket(void *opaque, uint8_t *buf, int bufSize);
+        static int64_t seek(void *opaque, int64_t offset, int whence);
+        void adviseAhead();
+        // 文件大小或修改时间与映射时不同则切换到 pread，返回当前是否仍可安全访问映射
+        bool checkMapping();
+        int64_t currentSize() const;
+
+        std::shared_ptr<MappedRegion> m_region;
+        AVIOContext *m_avio = nullptr;
+        int64_t m_pos = 0;
+        int64_t m_advisedUntil = 0;
+        bool m_unmapped = false; // 文件已变化，只走 pread
+    };
+
+} // namespace pb
+
+#endif // MAPPEDFILEIO_H
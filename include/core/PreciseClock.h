@@ -0,0 +1,16 @@
+#ifndef PRECISECLOCK_H
+#define PRECISECLOCK_H
+
+#include <chrono>
+
+namespace pb
+{
+    // 睡眠到绝对截止时间：POSIX 上用 clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME)
+    // 睡到截止前 spinMargin，剩余部分自旋完成，避免调度粒度造成的过睡与误差累积。
+    // 不支持绝对睡眠的平台回退到 sleep_until。
+    void preciseSleepUntil(std::chrono::steady_clock::time_point deadline,
+                           std::chrono::microseconds spinMargin = std::chrono::microseconds(300));
+
+} // namespace pb
+
+#endif // PRECISECLOCK_H
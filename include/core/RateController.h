@@ -0,0 +1,59 @@
+#ifndef RATECONTROLLER_H
+#define RATECONTROLLER_H
+
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace pb
+{
+    class VideoEncoder;
+
+    // 根据网络反馈 (RTCP 接收报告的丢包 / 抖动) 和发送队列深度，
+    // 实时调整编码器的目标码率与帧率，使拥塞时画质平滑下降而不是堆积延迟。
+    class RateController
+    {
+    public:
+        RateController(std::weak_ptr<VideoEncoder> encoder, int64_t maxBitRate, int maxFps);
+
+        // fractionLost: 0.0 ~ 1.0，jitterMs: 到达间隔抖动 (毫秒)
+        void onReceiverReport(double fractionLost, double jitterMs);
+        // 发送队列当前深度与容量 (RtspServerFilter / Muxer)
+        void onQueueDepth(size_t depth, size_t capacity);
+
+        int64_t targetBitRate() const;
+        int targetFps() const;
+
+        // 用户手动修改码率 / 帧率后调用：以新值作为上限和当前目标，bitRate / fps 为 0 时保持不变
+        void reset(int64_t bitRate, int fps);
+
+    private:
+        void evaluate();
+        int fpsForBitRate(int64_t bitRate) const;
+
+        std::weak_ptr<VideoEncoder> m_encoder;
+
+        mutable std::mutex m_mutex;
+        int64_t m_maxBitRate;
+        int64_t m_minBitRate;
+        int64_t m_increaseStep; // 每个评估间隔的加性回升量
+        int m_maxFps;
+        double m_loss = 0.0;       // 平滑后的丢包率
+        double m_jitterMs = 0.0;   // 平滑后的抖动
+        double m_queueRatio = 0.0; // 平滑后的队列占用率
+        bool m_hasReport = false;
+
+        int64_t m_targetBitRate;
+        int m_targetFps;
+        int64_t m_appliedBitRate;
+        int m_appliedFps;
+
+        std::chrono::steady_clock::time_point m_lastEvaluate;
+        std::chrono::steady_clock::time_point m_lastDecrease;
+    };
+
+} // namespace pb
+
+#endif // RATECONTROLLER_H
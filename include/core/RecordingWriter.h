@@ -0,0 +1,104 @@
+#ifndef RECORDINGWRITER_H
+#define RECORDINGWRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include <libavformat/avio.h>
+}
+
+namespace pb
+{
+    struct RecordingRing;
+
+    // 录制文件专用的只写 AVIOContext：小块写入先攒进对齐的大缓冲区，写满后整块提交，
+    // 有 liburing 时经 io_uring 异步提交 (PIXELBRIDGE_HAVE_LIBURING)，否则同步 pwrite。
+    // 文件按块 fallocate 预分配，可选 O_DIRECT 绕过页缓存，大量并发录制时不挤占其他管线的缓存。
+    // 封装器回头修补文件头 (mp4 / flv 写尾) 时切换到普通缓冲写。
+    // 仅 POSIX 平台可用，其他平台 open() 返回 nullptr，调用方回退到 avio_open2。
+    class RecordingWriter
+    {
+    public:
+        struct Options
+        {
+            bool directIo = false;                          // O_DIRECT，文件系统不支持时自动退回缓冲写
+            int64_t preallocateChunk = 64ll * 1024 * 1024;  // 每次预分配的字节数，0 表示不预分配
+            size_t bufferSize = 1024 * 1024;                // 单次提交的块大小，向上取整到 4KB
+            int queueDepth = 4;                             // 同时在途的块数
+        };
+
+        static std::unique_ptr<RecordingWriter> open(const std::string &path, const Options &options);
+        ~RecordingWriter();
+
+        RecordingWriter(const RecordingWriter &) = delete;
+        RecordingWriter &operator=(const RecordingWriter &) = delete;
+
+        // 交给 AVFormatContext::pb 使用 (需设置 AVFMT_FLAG_CUSTOM_IO)，生命周期由本对象管理
+        AVIOContext *context() const { return m_avio; }
+        // 冲出 AVIO 缓冲并等待所有写入完成，截断到实际长度后关闭文件；返回 false 表示期间有写入失败
+        bool close();
+
+        bool usingIoUring() const { return m_ring != nullptr; }
+        bool usingDirectIo() const { return m_direct; }
+
+    private:
+        struct Block
+        {
+            uint8_t *data = nullptr;
+            size_t used = 0;
+            bool inFlight = false;
+            int64_t offset = 0;  // 在途写入的位置与长度，短写时补齐剩余部分
+            size_t length = 0;
+        };
+
+        RecordingWriter() = default;
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+        static int writePacket(void *opaque, const uint8_t *buf, int bufSize);
+#else
+        static int writePacket(void *opaque, uint8_t *buf, int bufSize);
+#endif
+        static int64_t seek(void *opaque, int64_t offset, int whence);
+
+        void append(const uint8_t *buf, size_t size);
+        // 提交当前块 (length 字节，位于 m_appendOffset)，并换到下一个空闲块
+        bool submit(size_t length);
+        bool writeSync(int fd, const uint8_t *data, size_t length, int64_t offset);
+        // 回收一个已完成的 io_uring 写入
+        bool reapOne();
+        bool drain();
+        void preallocate(int64_t end);
+        // 第一次非顺序写入时调用：把已缓冲的数据写出，此后全部走普通缓冲写
+        void enterRandomMode();
+        int bufferedFd();
+
+        std::string m_path;
+        int m_fd = -1;
+        int m_bufferedFd = -1;
+        bool m_direct = false;
+        AVIOContext *m_avio = nullptr;
+        RecordingRing *m_ring = nullptr;
+        int m_inFlight = 0;
+
+        std::vector<Block> m_blocks;
+        size_t m_current = 0;
+        size_t m_blockSize = 0;
+
+        bool m_sequential = true;
+        int64_t m_appendOffset = 0; // 当前块在文件中的起始位置
+        int64_t m_pos = 0;          // AVIO 视角的写位置
+        int64_t m_size = 0;         // 逻辑文件长度
+        int64_t m_preallocChunk = 0;
+        int64_t m_allocated = 0;
+        bool m_failed = false;
+        bool m_closed = false;
+    };
+
+} // namespace pb
+
+#endif // RECORDINGWRITER_H
@@ -0,0 +1,63 @@
+#ifndef STREAMINFOCACHE_H
+#define STREAMINFOCACHE_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+namespace pb
+{
+    // 上次探测到的视频流参数，用于跳过下次打开时的大部分 avformat_find_stream_info
+    struct StreamInfo
+    {
+        AVCodecID codecId = AV_CODEC_ID_NONE;
+        int width = 0;
+        int height = 0;
+        int pixFmt = -1;
+        int profile = -1;
+        int level = -1;
+        AVRational frameRate = {0, 1};
+        std::vector<uint8_t> extradata;
+    };
+
+    // 按输入 URL (以哈希为键，不在磁盘上保存明文凭据) 持久化流参数，
+    // 存放在 CacheLocation/stream_info.json。
+    class StreamInfoCache
+    {
+    public:
+        static StreamInfoCache &instance()
+        {
+            static StreamInfoCache inst;
+            return inst;
+        }
+
+        bool lookup(const std::string &url, StreamInfo &out);
+        void store(const std::string &url, const StreamInfo &info);
+        void invalidate(const std::string &url);
+
+        static StreamInfo fromParameters(const AVCodecParameters *par, AVRational frameRate);
+        // 只填充 par 中缺失的字段，探测出的值优先
+        static void applyTo(const StreamInfo &info, AVCodecParameters *par);
+
+    private:
+        StreamInfoCache();
+
+        static std::string key(const std::string &url);
+        void load();
+        void save();
+
+        std::mutex m_mutex;
+        std::map<std::string, StreamInfo> m_table;
+        std::string m_path;
+    };
+
+} // namespace pb
+
+#endif // STREAMINFOCACHE_H
@@ -0,0 +1,96 @@
+#ifndef UDPPACER_H
+#define UDPPACER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+#include <libavformat/avio.h>
+}
+
+namespace pb
+{
+    struct UdpTarget;
+
+    // udp:// 与 rtp:// 输出的发送端：替代 FFmpeg 的 udp 协议，封装器写出的每个数据报先进队列，
+    // 由发送线程按令牌桶节拍发出，关键帧的突发被摊到约一个帧间隔内；每次唤醒用 sendmmsg 批量发送。
+    // 发送速率取配置速率与 "积压 / 距最新数据报截止的剩余时间" 中的较大者，每次补充令牌时重新计算，积压最多延后一个帧间隔。
+    // rtp:// 的 RTCP 包不参与节拍，直接发往端口 +1。
+    // 支持 URL 参数 localaddr / localport / ttl / pkt_size；仅 POSIX 平台可用，其他平台 open() 返回 nullptr。
+    class UdpPacer
+    {
+    public:
+        struct Options
+        {
+            int64_t rateBps = 0;            // 令牌速率 (bit/s)，0 表示不按速率限制，只做批量发送
+            double frameInterval = 1.0 / 30; // 突发最多被摊开的时长
+        };
+
+        static std::unique_ptr<UdpPacer> open(const std::string &url, const Options &options);
+        ~UdpPacer();
+
+        UdpPacer(const UdpPacer &) = delete;
+        UdpPacer &operator=(const UdpPacer &) = delete;
+
+        // 交给 AVFormatContext::pb 使用 (需设置 AVFMT_FLAG_CUSTOM_IO)，生命周期由本对象管理
+        AVIOContext *context() const { return m_avio; }
+        void setRate(int64_t rateBps);
+        // 冲出 AVIO 缓冲，最多再用 kDrainTimeout 发完队列后停止发送线程
+        void close();
+
+        struct Stats
+        {
+            uint64_t datagrams = 0;
+            uint64_t batches = 0;     // sendmmsg 调用次数
+            uint64_t dropped = 0;     // 队列超限或发送失败丢弃的数据报
+            size_t backlogBytes = 0;
+        };
+        Stats stats() const;
+
+    private:
+        UdpPacer() = default;
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+        static int writePacket(void *opaque, const uint8_t *buf, int bufSize);
+#else
+        static int writePacket(void *opaque, uint8_t *buf, int bufSize);
+#endif
+        void senderLoop();
+        void sendBatch(std::vector<std::vector<uint8_t>> &batch);
+
+        UdpTarget *m_target = nullptr;
+        UdpTarget *m_rtcpTarget = nullptr;
+        AVIOContext *m_avio = nullptr;
+        std::string m_url;
+        double m_frameInterval = 1.0 / 30;
+
+        mutable std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::deque<std::vector<uint8_t>> m_queue;
+        size_t m_queuedBytes = 0;
+        int64_t m_rateBps = 0;
+        std::chrono::steady_clock::time_point m_drainDeadline; // 最新入队的数据报最晚应发出的时刻
+        double m_tokens = 0.0;      // 字节，可为负 (已透支)
+        std::chrono::steady_clock::time_point m_lastRefill;
+        bool m_stopping = false;
+        std::chrono::steady_clock::time_point m_stopDeadline;
+        std::thread m_thread;
+
+        std::atomic<uint64_t> m_datagrams{0};
+        std::atomic<uint64_t> m_batches{0};
+        std::atomic<uint64_t> m_dropped{0};
+        uint64_t m_sendErrors = 0;
+    };
+
+} // namespace pb
+
+#endif // UDPPACER_H
@@ -5,33 +5,169 @@
 #include <string>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <mutex>
 
 namespace pb
 {
+    class MappedFileIO;
 
     class Demuxer : public Filter
     {
     public:
+        enum class PacingMode
+        {
+            Auto = 0,            // 文件与点播 (http / rtmp 等) 实时回放，直播协议不节拍
+            Realtime = 1,        // 始终按时间戳实时输出
+            AsFastAsPossible = 2 // 不节拍，批量转码时以 CPU 全速运行
+        };
+
         Demuxer(const std::string &url);
         ~Demuxer();
 
         bool initialize() override;
         void process(DataPacket::Ptr packet) override; // Normally Demuxer is a source, it doesn't process incoming packets
         void stop() override;
+        void requestStop() override;
         void start() override;
 
+        // 返回的参数在 Demuxer 生命周期内有效，重连不会使其失效
         AVCodecParameters *getVideoCodecParameters() const;
+        AVRational getVideoTimeBase() const;
+        bool isNetworkInput() const;
+        // 直播协议 (rtsp / udp / rtp / srt)：数据按实时到达，不需要节拍，EOF 也意味着断流
+        bool isLiveInput() const;
+        // 没有音频流时返回 nullptr；时间基与视频一样在重连后保持不变
+        AVCodecParameters *getAudioCodecParameters() const;
+        AVRational getAudioTimeBase() const;
+
+        // 音频包以压缩形式直接送给 sink (标记为 AVMEDIA_TYPE_AUDIO)，不经过视频链路；
+        // 时间戳与视频包处于同一时间轴。需在 start() 之前设置
+        void setAudioSink(Filter *sink);
+
+        // 网络输入断开后按指数退避重连 (默认开启)，maxAttempts 为 0 表示不限次数
+        void setReconnect(bool enabled, int maxAttempts = 0);
+        int reconnectCount() const { return m_reconnects; }
+
+        // 需在 start() 之前设置
+        void setPacingMode(PacingMode mode);
+
+        // 文件输入循环播放：首遍把视频包紧凑地缓存在内存里 (带关键帧索引)，之后从内存重放，
+        // 时间戳跨循环保持连续。缓存超过 maxCacheBytes 时回退为 seek 到文件头，0 表示不缓存。
+        // 需在 start() 之前设置
+        void setLoop(bool enabled, size_t maxCacheBytes = 512 * 1024 * 1024);
+        int loopCount() const { return m_loopCount; }
+        // 跳转到相对文件开头的位置 (秒)，由读取线程在下一个包之前执行，落在之前最近的关键帧上
+        void seek(double seconds);
+
+        // 本地文件通过共享的 mmap 读取 (默认开启，需在 initialize() 之前设置)
+        void setMemoryMapped(bool enabled) { m_useMmap = enabled; }
+
+        // 网络输入使用持久化的流参数缓存缩短探测 (默认开启)
+        void setStreamInfoCache(bool enabled) { m_useStreamCache = enabled; }
+
+        struct StartupTimings
+        {
+            bool cacheHit = false;
+            double openMs = 0.0;            // avformat_open_input
+            double probeMs = 0.0;           // avformat_find_stream_info
+            double firstKeyframeMs = -1.0;  // 从 initialize() 开始到第一个关键帧
+        };
+        StartupTimings startupTimings() const { return m_timings; }
 
     private:
         void run();
+        bool openInput();
+        // openInput() 之后校验流参数缓存，过期时作废缓存并完整探测重开
+        bool openValidatedInput();
+        bool reconnect();
+        void holdLoop();
+        bool applyCachedStreamInfo();
+        // 缓存命中时在 initialize() 内读到第一个视频关键帧，尺寸与缓存不符返回 false；读到的包留给 run()
+        bool prefetchAndValidate();
+        bool validateCachedStreamInfo(const AVPacket *pkt);
+        int readNext(AVPacket *pkt);
+        void appendToLoopCache(const AVPacket *pkt);
+        void clearLoopCache();
+        bool rewind();
+        void seekTo(double seconds);
+        // 换算到统一时间基并加上重连偏移，保证输出时间戳连续；同时缓存最近的关键帧
+        void normalizeTimestamps(AVPacket *pkt);
+        // 音频沿用视频的重连 / 循环偏移；返回 false 表示该包无法对齐，应丢弃
+        bool normalizeAudioTimestamps(AVPacket *pkt);
         static int interrupt_callback(void *opaque);
+        // 为下一次阻塞调用设定截止时间，超时由 interrupt_callback 打断；0 表示不限时
+        void armDeadline(std::chrono::milliseconds timeout);
 
         std::string m_url;
         AVFormatContext *m_formatCtx = nullptr;
         std::thread m_thread;
         std::atomic<bool> m_running{false};
         std::atomic<bool> m_aborting{false};
+        std::atomic<int64_t> m_deadline{0}; // steady_clock 纳秒
         int m_videoStreamIndex = -1;
+        AVCodecParameters *m_videoParams = nullptr;
+        AVRational m_timeBase = {0, 1};
+        int m_audioStreamIndex = -1;
+        AVCodecParameters *m_audioParams = nullptr;
+        AVRational m_audioTimeBase = {0, 1};
+        Filter *m_audioSink = nullptr;
+        int m_demuxLog = 0;
+
+        bool m_reconnect = true;
+        int m_maxReconnectAttempts = 0;
+        std::atomic<int> m_reconnects{0};
+        std::mutex m_waitMutex;
+        std::condition_variable m_waitCv;
+        bool m_holding = false;
+
+        bool m_resync = false;
+        int64_t m_tsOffset = 0;
+        int64_t m_lastTs = AV_NOPTS_VALUE;
+        int64_t m_frameDuration = 1;
+        std::shared_ptr<AVPacketWrapper> m_lastKeyframe;
+
+        PacingMode m_pacingMode = PacingMode::Auto;
+
+        struct LoopPacket
+        {
+            uint32_t chunk;
+            uint32_t offset;
+            uint32_t size;
+            int flags;
+            int64_t pts;
+            int64_t dts;
+            int64_t duration;
+        };
+        struct LoopKeyframe
+        {
+            int64_t ts;
+            uint32_t index;
+        };
+        bool m_loop = false;
+        bool m_loopCaching = false;
+        bool m_loopReplaying = false;
+        size_t m_loopMaxBytes = 0;
+        size_t m_loopBytes = 0;
+        size_t m_loopChunkUsed = 0;
+        size_t m_loopPos = 0;
+        std::vector<AVBufferRef *> m_loopChunks;
+        std::vector<LoopPacket> m_loopPackets;
+        std::vector<LoopKeyframe> m_loopKeyframes;
+        std::atomic<int> m_loopCount{0};
+        std::atomic<double> m_seekRequest{-1.0};
+
+        bool m_useMmap = true;
+        std::unique_ptr<MappedFileIO> m_mappedIO;
+
+        bool m_useStreamCache = true;
+        std::deque<std::shared_ptr<AVPacketWrapper>> m_prefetched;
+        StartupTimings m_timings;
+        std::chrono::steady_clock::time_point m_startTime;
     };
 
 } // namespace pb
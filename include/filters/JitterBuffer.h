@@ -0,0 +1,94 @@
+#ifndef JITTERBUFFER_H
+#define JITTERBUFFER_H
+
+#include "core/Filter.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace pb
+{
+
+    // 网络输入与解码器之间的自适应抖动缓冲：按时间戳重排，
+    // 依据到达抖动 (RFC 3550 的平滑估计) 调整缓冲深度，在保证顺序解码的前提下保持最小延迟。
+    // RTP 包序号级别的重排由 FFmpeg 的 reorder_queue_size 完成，这里处理的是帧级别的乱序与到达抖动。
+    class JitterBuffer : public Filter
+    {
+    public:
+        explicit JitterBuffer(AVRational timeBase);
+        ~JitterBuffer();
+
+        bool initialize() override;
+        void process(DataPacket::Ptr packet) override;
+        void start() override;
+        void stop() override;
+        void requestStop() override;
+
+        // 缓冲深度的上下限，需在 initialize() 之前设置；未设置时按延迟等级选择
+        void setDelayRange(std::chrono::milliseconds minDelay, std::chrono::milliseconds maxDelay);
+
+        struct Stats
+        {
+            uint64_t received = 0;   // 收到的包数
+            uint64_t released = 0;   // 按序送出的包数
+            uint64_t reordered = 0;  // 乱序到达但仍赶上播放的包数
+            uint64_t late = 0;       // 晚于已送出的包到达而被丢弃的包数
+            uint64_t lost = 0;       // 按时间戳间隔推算的丢失帧数 (含 FFmpeg 标记为损坏的包)
+            double jitterMs = 0.0;   // 平滑后的到达抖动
+            double delayMs = 0.0;    // 当前缓冲深度
+            size_t depth = 0;        // 当前排队的包数
+        };
+        Stats stats() const;
+
+    private:
+        struct Entry
+        {
+            std::shared_ptr<AVPacketWrapper> packet;
+            std::chrono::steady_clock::time_point due;
+            bool timed; // 没有时间戳的包不参与丢包统计
+        };
+
+        void run();
+        void reset(double transit);
+        void updateDelay(double excess);
+        std::chrono::steady_clock::time_point dueTime(int64_t ts) const;
+        void countLoss(int64_t ts);
+
+        AVRational m_timeBase;
+        std::chrono::milliseconds m_minDelay{-1};
+        std::chrono::milliseconds m_maxDelay{-1};
+
+        std::thread m_thread;
+        std::atomic<bool> m_running{false};
+        mutable std::mutex m_mutex;
+        std::condition_variable m_cv;
+        // 键为 (代数, 时间戳)：时间戳不连续时代数加一，旧代数的包排在前面并立即送出
+        std::multimap<std::pair<uint64_t, int64_t>, Entry> m_queue;
+
+        // 以下状态受 m_mutex 保护
+        bool m_synced = false;
+        uint64_t m_generation = 0;
+        std::chrono::steady_clock::time_point m_epoch;
+        double m_minTransit = 0.0;  // 最小传输时延 (秒)，作为播放时钟的基线
+        double m_lastTransit = 0.0;
+        double m_jitter = 0.0;      // 秒
+        double m_delay = 0.0;       // 秒
+        int64_t m_lastIn = AV_NOPTS_VALUE;
+        int64_t m_highestIn = AV_NOPTS_VALUE;
+        int64_t m_lastOut = AV_NOPTS_VALUE;
+        int64_t m_frameDuration = 0;
+
+        std::atomic<uint64_t> m_received{0};
+        std::atomic<uint64_t> m_released{0};
+        std::atomic<uint64_t> m_reordered{0};
+        std::atomic<uint64_t> m_late{0};
+        std::atomic<uint64_t> m_lost{0};
+        int m_jitterLog = 0;
+    };
+
+} // namespace pb
+
+#endif // JITTERBUFFER_H
@@ -2,10 +2,20 @@
 #define MUXER_H
 
 #include "core/Filter.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 namespace pb
 {
+    class RateController;
+    class RecordingWriter;
+    class UdpPacer;
 
     class Muxer : public Filter
     {
@@ -18,14 +28,132 @@ namespace pb
 
         void process(DataPacket::Ptr packet) override;
         void stop() override;
+        void requestStop() override;
+
+        // 直通的压缩音频流 (来自 Demuxer::setAudioSink)，需在 initialize() 之前设置；
+        // 容器不支持该音频编码时忽略音频，只输出视频
+        void setAudioStream(const AVCodecParameters *params, AVRational timeBase);
+
+        // 写出队列的真实深度会作为拥塞信号反馈给码率控制器
+        void setRateController(std::shared_ptr<RateController> controller) { m_rateController = std::move(controller); }
+        const std::shared_ptr<RateController> &rateController() const { return m_rateController; }
+
+        // 写出队列最多容纳的视频帧数，需在 initialize() 之前设置；0 表示按延迟等级选择
+        void setQueueCapacity(size_t frames) { m_queueCapacity = frames; }
+
+        // 网络输出写失败后按指数退避重连 (默认开启)，期间队列作为积压缓冲，只保留最近关键帧起的内容；
+        // 重连成功后从关键帧开始补发，编码器无需重启。maxAttempts 为 0 表示不限次数
+        void setReconnect(bool enabled, int maxAttempts = 0);
+        int reconnectCount() const { return m_reconnects; }
+
+        // 本地文件输出经 RecordingWriter 写盘，directIo 时使用 O_DIRECT 绕过页缓存；需在 initialize() 之前设置
+        void setDirectIo(bool enabled) { m_directIo = enabled; }
+
+        // udp:// 与 rtp:// 输出经 UdpPacer 按节拍发送 (默认开启)，关键帧突发被摊到一个帧间隔内；
+        // rateBps 为 0 时取编码码率的 1.5 倍。需在 initialize() 之前设置
+        void setUdpPacing(bool enabled, int64_t rateBps = 0)
+        {
+            m_udpPacing = enabled;
+            m_pacingRate = rateBps;
+        }
+
+        const std::string &url() const { return m_url; }
+
+        struct Stats
+        {
+            size_t queuedFrames = 0;     // 队列中等待写出的视频帧
+            size_t capacity = 0;
+            uint64_t written = 0;        // 已写出的包数 (含音频)
+            uint64_t dropped = 0;        // 队列满时整 GOP 丢弃的包数
+            uint64_t droppedGops = 0;
+            double writeMs = 0.0;        // 单次写出耗时的平滑值
+            double peakWriteMs = 0.0;    // 最近的写出耗时峰值 (缓慢衰减)
+            bool connected = false;
+            bool failed = false;          // 输出已不可用 (文件写入失败如磁盘满，或重连放弃)，不再接收数据
+            std::string error;            // failed 时的错误描述
+            int reconnects = 0;
+            size_t pacerBacklogBytes = 0; // UdpPacer 队列中尚未发出的字节
+            uint64_t pacerDropped = 0;
+        };
+        Stats stats() const;
 
     private:
+        // 同一个编码包可能同时排在多个 Muxer 的队列里 (TeeFilter 分发)，因此不修改共享包，
+        // 换算后的时间戳单独保存，写出时再引用同一份数据缓冲
+        struct QueuedPacket
+        {
+            std::shared_ptr<AVPacketWrapper> packet;
+            int64_t pts;
+            int64_t dts;
+            bool audio;
+            bool keyframe;
+        };
+
+        static int interrupt_callback(void *opaque);
+        void armDeadline(std::chrono::milliseconds timeout);
+        // 创建格式上下文、输出流并写头；初始化与重连共用
+        bool openOutput();
+        void closeOutput();
+        bool isNetworkOutput() const;
+        bool reconnect();
+        void writerLoop();
+        // 返回 false 表示连接已断开
+        bool writePacket(const QueuedPacket &item);
+        // 输出不可恢复：记录错误、丢弃积压，之后 process() 不再入队
+        void markFailed(const std::string &error);
+        // 队列满时丢弃最旧的完整 GOP (连同其间的音频)，队列里没有第二个关键帧时清空并等待下一个关键帧
+        void dropOldestGop();
+        // 未指定 UdpPacer 速率时取 (视频 + 音频码率) 的 1.5 倍，码率未知时返回 0 (不限速)
+        int64_t autoPacingRate(int64_t videoBitRate) const;
+
         std::string m_url;
         AVFormatContext *m_formatCtx = nullptr;
         AVStream *m_outStream = nullptr;
+        AVPacket *m_writePacket = nullptr; // 写出线程专用，持有共享包数据的引用
+        std::unique_ptr<RecordingWriter> m_recordingWriter;
+        bool m_directIo = false;
+        std::unique_ptr<UdpPacer> m_udpPacer;
+        bool m_udpPacing = true;
+        int64_t m_pacingRate = 0;
+        int64_t m_pacedBitRate = 0; // 当前 UdpPacer 速率对应的视频码率 (受 m_queueMutex 保护)
+        AVCodecParameters *m_videoParams = nullptr;
         AVRational m_srcTimeBase = {1, 30};
+        AVStream *m_audioStream = nullptr;
+        bool m_hasAudio = false;
+        AVCodecParameters *m_audioParams = nullptr;
+        AVRational m_audioTimeBase = {0, 1};
+        // 有音频时两路都以第一个视频包为零点；之前到达的音频丢弃 (受 m_queueMutex 保护)
+        int64_t m_videoOrigin = AV_NOPTS_VALUE;
+        int64_t m_audioOrigin = AV_NOPTS_VALUE;
         bool m_headerWritten = false;
-        bool m_trailerWritten = false;
+        std::shared_ptr<RateController> m_rateController;
+        std::atomic<bool> m_aborting{false};
+        // stop() 置位：不再接收新包，写出线程排空队列后退出 (截止时间受 m_queueMutex 保护)
+        std::atomic<bool> m_draining{false};
+        std::chrono::steady_clock::time_point m_drainDeadline;
+        std::atomic<int64_t> m_deadline{0}; // steady_clock 纳秒，0 表示不限时
+
+        // 编码线程 (及音频的解复用线程) 只入队，写出在独立线程中进行，网络阻塞不会反压到编码
+        std::thread m_writerThread;
+        mutable std::mutex m_queueMutex;
+        std::condition_variable m_queueCv;
+        std::deque<QueuedPacket> m_queue;
+        size_t m_queueCapacity = 0;
+        size_t m_queuedFrames = 0;
+        bool m_waitKeyframe = false;
+
+        bool m_reconnect = true;
+        int m_maxReconnectAttempts = 0;
+        std::atomic<int> m_reconnects{0};
+        std::atomic<bool> m_connected{false};
+        std::atomic<bool> m_failed{false};
+        std::string m_error; // 受 m_queueMutex 保护，最近一次写出失败的描述
+
+        std::atomic<uint64_t> m_written{0};
+        std::atomic<uint64_t> m_dropped{0};
+        std::atomic<uint64_t> m_droppedGops{0};
+        double m_writeMs = 0.0;
+        double m_peakWriteMs = 0.0;
     };
 
 } // namespace pb
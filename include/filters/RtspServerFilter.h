@@ -8,10 +8,33 @@
 #include <atomic>
 #include <queue>
 #include <mutex>
-#include <condition_variable>
+#include <memory>
+#include <vector>
 
 namespace pb
 {
+    class RateController;
+    class PacketSource;
+
+    // 音视频共用的呈现时间锚点：两路都按 pts 换算到同一个 "pts -> 系统时间" 映射上，
+    // RTCP SR 给出的时间对应关系一致，客户端才能正确对齐 (视频经过解码 / 编码，比直通音频晚到)
+    struct PresentationAnchor
+    {
+        std::mutex mutex;
+        int64_t originUs = AV_NOPTS_VALUE; // 第一个送出的包的 pts (微秒)
+        struct timeval wall = {0, 0};      // 该包送出时的系统时间
+    };
+
+    // 一路 (视频或音频) 待发送的包：process() 入队后写唤醒 fd 打断事件循环的 select()，
+    // 由正在等待数据的 PacketSource 在事件循环线程中取走
+    struct PacketChannel
+    {
+        std::queue<DataPacket::Ptr> queue;
+        std::mutex mutex;
+        std::vector<PacketSource *> sources; // 当前存活的源，只在事件循环线程中访问
+        std::atomic<int> liveSources{0};     // 同上的计数，供 process() 跨线程判断是否有人在消费
+        PresentationAnchor *anchor = nullptr; // 仅音频直通时设置，纯视频使用系统时间
+    };
 
     class RtspServerFilter : public Filter
     {
@@ -25,8 +48,20 @@ namespace pb
         void process(DataPacket::Ptr packet) override;
         void stop() override;
 
+        // 直通的压缩音频流 (AAC / Opus / G.711)，作为第二个子会话提供，需在 initialize() 之前设置
+        void setAudioStream(const AVCodecParameters *params, AVRational timeBase);
+
+        // 需在 initialize() 之前设置，RTCP 接收报告与队列深度会反馈给它
+        void setRateController(std::shared_ptr<RateController> controller) { m_rateController = std::move(controller); }
+        const std::shared_ptr<RateController> &rateController() const { return m_rateController; }
+
     private:
         void serverLoop();
+        // 跨线程唤醒事件循环：多次调用在事件循环处理前只写一次
+        void wakeEventLoop();
+        // 唤醒 fd 可读时在事件循环线程中执行：清空计数并把新到的包交给等待中的源
+        static void onWakeup(void *clientData, int mask);
+        static void deliverPending(PacketChannel &channel);
 
         int m_port;
         std::string m_streamName;
@@ -37,13 +72,24 @@ namespace pb
         UsageEnvironment *m_env = nullptr;
         TaskScheduler *m_scheduler = nullptr;
         RTSPServer *m_rtspServer = nullptr;
+        // 调度器不设周期性节拍 (maxSchedulerGranularity = 0)，空闲时阻塞在 select() 上；
+        // 新包与停止请求都经这组 fd (eventfd / 自管道 / Windows 回环套接字) 唤醒它
+        int m_wakeReadFd = -1;
+        int m_wakeWriteFd = -1;
+        std::atomic<bool> m_wakePending{false};
 
-        // Queue for passing packets to live555
-        std::queue<DataPacket::Ptr> m_packetQueue;
-        std::mutex m_queueMutex;
-        std::condition_variable m_queueCv;
+        PresentationAnchor m_anchor;
+        PacketChannel m_video;
+        // 音频使用独立的队列，避免与视频互相挤占
+        PacketChannel m_audio;
+        AVCodecParameters *m_audioParams = nullptr;
+        AVRational m_audioTimeBase = {0, 1};
+        bool m_hasAudio = false;
+        std::atomic<bool> m_videoStarted{false};
 
-        AVCodecContext *m_encoderCtx = nullptr;
+        AVCodecID m_codecId = AV_CODEC_ID_H264;
+        AVRational m_videoTimeBase = {0, 1};
+        std::shared_ptr<RateController> m_rateController;
         EventLoopWatchVariable m_watchVariable{0};
     };
 
@@ -0,0 +1,160 @@
+#ifndef SEGMENTMUXER_H
+#define SEGMENTMUXER_H
+
+#include "core/Filter.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace pb
+{
+    // 分片录制 / HLS 输出：按关键帧切分 fMP4 (CMAF) 或 MPEG-TS 分片并维护 m3u8 播放列表。
+    // 设置分片部分 (part) 时长后按 LL-HLS 输出 EXT-X-PART，部分以字节范围引用分片文件本身。
+    // 封装与文件写入在独立线程中进行，编码线程只入队。
+    class SegmentMuxer : public Filter
+    {
+    public:
+        enum class Format
+        {
+            FragmentedMp4,
+            MpegTs
+        };
+
+        // playlistPath 为 .m3u8 文件路径，分片与初始化段写在同一目录下
+        SegmentMuxer(const std::string &playlistPath);
+        ~SegmentMuxer();
+
+        bool initialize(AVCodecContext *encoderCtx);
+        bool initialize() override { return false; } // Use the parameterized version
+
+        void process(DataPacket::Ptr packet) override;
+        void stop() override;
+        void requestStop() override;
+
+        // 以下设置需在 initialize() 之前调用；时长为 0 表示按延迟等级选择
+        void setFormat(Format format) { m_format = format; }
+        void setSegmentDuration(double seconds) { m_segmentDuration = seconds; }
+        // 大于 0 时启用 LL-HLS 部分分片；未设置时仅 UltraLow / Low 启用
+        void setPartDuration(double seconds) { m_partDuration = seconds; }
+        // 播放列表保留的分片数，更早的分片文件被删除；0 表示全部保留 (EVENT 播放列表，用于录制)
+        void setRetention(int segments) { m_retention = segments; }
+        // 与 Muxer::setAudioStream 相同，直通的压缩音频流
+        void setAudioStream(const AVCodecParameters *params, AVRational timeBase);
+
+        const std::string &url() const { return m_playlistPath; }
+
+        struct Stats
+        {
+            uint64_t segments = 0;   // 已完成的分片数
+            uint64_t parts = 0;      // 已写出的部分分片数
+            uint64_t bytes = 0;      // 已写入磁盘的字节数
+            uint64_t dropped = 0;    // 写出跟不上时丢弃的包数
+            size_t queued = 0;
+        };
+        Stats stats() const;
+
+    private:
+        struct QueuedPacket
+        {
+            std::shared_ptr<AVPacketWrapper> packet;
+            int64_t pts;
+            int64_t dts;
+            bool audio;
+            bool keyframe;
+        };
+
+        struct Part
+        {
+            double duration;
+            int64_t offset;
+            int64_t size;
+            bool independent;
+        };
+
+        struct Segment
+        {
+            uint64_t sequence;
+            std::string fileName;
+            double duration = 0.0;
+            std::vector<Part> parts;
+        };
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+        static int writeCallback(void *opaque, const uint8_t *buf, int bufSize);
+#else
+        static int writeCallback(void *opaque, uint8_t *buf, int bufSize);
+#endif
+        void writerLoop();
+        void writePacket(const QueuedPacket &item);
+        // 把封装器缓冲中的数据冲出为一个部分分片，追加到当前分片文件
+        void flushPart(double endTime);
+        void openSegment(double startTime);
+        void closeSegment(double endTime);
+        void writePlaylist(bool ended);
+        std::string segmentFileName(uint64_t sequence) const;
+        // fMP4 的 moov 延迟到第一个分片才写出 (编码器不输出全局头，需从首个关键帧生成 avcC/hvcC)，
+        // 第一次冲出的数据中 moof 之前的部分即初始化段
+        void writeInitSegment();
+
+        std::string m_playlistPath;
+        std::string m_directory;
+        std::string m_stem;
+        Format m_format = Format::FragmentedMp4;
+        double m_segmentDuration = 0.0;
+        double m_partDuration = -1.0;
+        int m_retention = 6;
+
+        AVFormatContext *m_formatCtx = nullptr;
+        AVStream *m_videoStream = nullptr;
+        AVStream *m_audioStream = nullptr;
+        AVPacket *m_writePacket = nullptr;
+        AVRational m_srcTimeBase = {1, 30};
+        AVCodecParameters *m_audioParams = nullptr;
+        AVRational m_audioTimeBase = {0, 1};
+        bool m_hasAudio = false;
+        int64_t m_videoOrigin = AV_NOPTS_VALUE;
+        int64_t m_audioOrigin = AV_NOPTS_VALUE;
+
+        // 封装器经自定义 AVIO 写入这里，在部分 / 分片边界统一落盘
+        std::vector<uint8_t> m_pending;
+        FILE *m_segmentFile = nullptr;
+        bool m_initWritten = false;
+        std::deque<Segment> m_segments; // 播放列表中保留的已完成分片
+        Segment m_current;
+        bool m_segmentOpen = false;
+        int64_t m_segmentBytes = 0;
+        uint64_t m_nextSequence = 0;
+        double m_segmentStart = 0.0;
+        double m_partStart = 0.0;
+        double m_lastVideoTime = 0.0;
+        double m_frameDuration = 0.0;
+        bool m_partIndependent = false;
+        bool m_partHasData = false;
+        // RFC 8216 要求 TARGETDURATION 不变：取配置分片时长向上取整，分片到此上限时即使不在关键帧也切开
+        int m_targetDuration = 0;
+        bool m_allIndependent = true; // 出现过非关键帧起始的分片后不再声明 INDEPENDENT-SEGMENTS
+
+        std::atomic<bool> m_aborting{false};
+        std::thread m_writerThread;
+        mutable std::mutex m_queueMutex;
+        std::condition_variable m_queueCv;
+        std::deque<QueuedPacket> m_queue;
+        size_t m_queueCapacity = 0;
+        size_t m_queuedFrames = 0;
+        bool m_waitKeyframe = true; // 第一个分片必须从关键帧开始
+
+        std::atomic<uint64_t> m_segmentCount{0};
+        std::atomic<uint64_t> m_partCount{0};
+        std::atomic<uint64_t> m_bytes{0};
+        std::atomic<uint64_t> m_dropped{0};
+    };
+
+} // namespace pb
+
+#endif // SEGMENTMUXER_H
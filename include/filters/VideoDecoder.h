@@ -2,6 +2,8 @@
 #define VIDEODECODER_H
 
 #include "core/Filter.h"
+#include <atomic>
+#include <chrono>
 
 namespace pb
 {
@@ -16,6 +18,45 @@ namespace pb
         void process(DataPacket::Ptr packet) override;
         void stop() override;
 
+        // 解码跟不上实时时逐级丢弃帧 (load shedding)，追上后恢复完整解码
+        enum class ShedLevel
+        {
+            None = 0,     // 完整解码
+            NonRef = 1,   // 跳过非参考帧及其环路滤波
+            Bidir = 2,    // 跳过所有 B 帧，关闭环路滤波
+            NonKey = 3    // 只解码关键帧
+        };
+
+        struct Stats
+        {
+            ShedLevel level = ShedLevel::None;
+            double lagMs = 0.0;           // 当前落后于实时的时间
+            uint64_t packets = 0;         // 送入解码器的包数
+            uint64_t frames = 0;          // 输出帧数
+            uint64_t skippedFrames = 0;   // 降级期间送入后没有产出帧的包数
+            uint64_t levelChanges = 0;
+        };
+
+        // 线程模型：帧线程会引入 (线程数 - 1) 帧的延迟，slice 线程没有额外延迟但只对多 slice 码流有效
+        enum class ThreadingProfile
+        {
+            Auto = 0,      // 根据延迟等级、分辨率、核数和首个关键帧的 slice 数选择
+            Single = 1,
+            Slice = 2,
+            Frame = 3,
+            FrameSlice = 4
+        };
+
+        // 需在 initialize() 之前调用；threadCount 为 0 时按核数自动选择
+        void setThreadingProfile(ThreadingProfile profile, int threadCount = 0);
+        ThreadingProfile threadingProfile() const { return m_threading.profile; }
+        int threadCount() const { return m_threading.threadCount; }
+
+        // 流的时间基，用于把包时间戳换算为媒体时间；未设置时尝试使用 AVPacket::time_base
+        void setTimeBase(AVRational timeBase) { m_timeBase = timeBase; }
+        void setLoadShedding(bool enabled) { m_loadShedding = enabled; }
+        Stats stats() const;
+
     private:
         static enum AVPixelFormat get_hw_format(AVCodecContext *ctx, const enum AVPixelFormat *pix_fmts);
         bool init_hw_decoder(AVHWDeviceType type);
@@ -27,6 +68,50 @@ namespace pb
         AVBufferRef *m_hwDeviceCtx = nullptr;
         AVHWDeviceType m_hwType = AV_HWDEVICE_TYPE_NONE;
         enum AVPixelFormat m_hwPixFmt = AV_PIX_FMT_NONE;
+        int m_passLog = 0;
+
+        struct ThreadingChoice
+        {
+            ThreadingProfile profile = ThreadingProfile::Single;
+            int threadType = FF_THREAD_SLICE;
+            int threadCount = 1;
+        };
+
+        bool openCodec(const ThreadingChoice &choice);
+        ThreadingChoice resolveThreading(int slicesPerFrame) const;
+        void updateThreading(const AVPacket *pkt);
+        int countSlices(const AVPacket *pkt) const;
+
+        ThreadingProfile m_threadingProfile = ThreadingProfile::Auto;
+        int m_threadCount = 0;
+        ThreadingChoice m_threading;
+        bool m_threadingProbed = false;
+        int m_slicesPerFrame = 0;
+
+        void updateLag(const AVPacket *pkt);
+        void applyShedLevel(ShedLevel level);
+
+        AVRational m_timeBase = {0, 1};
+        bool m_loadShedding = true;
+        ShedLevel m_shedLevel = ShedLevel::None;
+        bool m_clockValid = false;
+        int64_t m_firstTs = AV_NOPTS_VALUE;
+        int64_t m_lastTs = AV_NOPTS_VALUE;
+        std::chrono::steady_clock::time_point m_clockStart;
+        std::chrono::steady_clock::time_point m_lastLevelChange;
+        std::chrono::steady_clock::time_point m_belowSince;
+        double m_minOffset = 0.0; // 无积压时的 (墙钟 - 媒体时间) 基线：取最小值，并缓慢上浮以跟随时钟漂移
+        std::chrono::steady_clock::time_point m_lastLagUpdate;
+        int64_t m_decodeDelay = 0; // 完整解码时送入与输出之差 (解码器内部缓冲的包数)
+        double m_lagMs = 0.0;
+        double m_lagAtChange = 0.0;
+
+        std::atomic<uint64_t> m_packetsIn{0};
+        std::atomic<uint64_t> m_framesOut{0};
+        std::atomic<uint64_t> m_skipped{0};
+        std::atomic<uint64_t> m_levelChanges{0};
+        std::atomic<int> m_statLevel{0};
+        std::atomic<double> m_statLag{0.0};
     };
 
 } // namespace pb
@@ -2,6 +2,11 @@
 #define VIDEOENCODER_H
 
 #include "core/Filter.h"
+#include "core/ContentClassifier.h"
+#include "core/EncoderProfiler.h"
+#include <mutex>
+#include <memory>
+#include <vector>
 
 extern "C"
 {
@@ -24,17 +29,82 @@ namespace pb
         void stop() override;
 
         AVCodecContext *getCodecContext() const { return m_codecCtx; }
+        const std::string &codecName() const { return m_codecName; }
+
+        // 覆盖按延迟等级选择的预设 / 线程数，需在 initialize() 之前调用（空 / 0 表示默认）
+        void setPreset(const std::string &preset) { m_preset = preset; }
+        void setThreadCount(int threads) { m_threadCount = threads; }
+
+        // 运行时调整码率 / 帧率，线程安全，在下一帧编码前生效。
+        // bitRate 为 bps，fps 不能超过初始化时的输入帧率；传 0 表示保持不变。
+        void reconfigure(int64_t bitRate, int fps = 0);
+        int64_t bitRate() const { return m_bitRate; }
+        int outputFps() const { return m_outputFps; }
+
+        // 设置后按输入帧自身的时间戳 (该时间基下) 计算输出时间戳，而不是按帧序号；
+        // 与直通音频共用同一时间轴时需要。需在送入第一帧之前调用
+        void setSourceTimeBase(AVRational timeBase) { m_sourceTimeBase = timeBase; }
+        // 未设置 setSourceTimeBase 时时间戳仍按帧序号从零开始，但按输入帧时间戳的间隔推进：
+        // 解码器降级丢掉的帧留下时间空档，而不是让后续画面被压缩成快进
+        void setInputTimeBase(AVRational timeBase) { m_inputTimeBase = timeBase; }
+
+        // 内容自适应：分析输入帧，在 GOP 边界于“屏幕 / 自然画面”两套 x264 参数间切换。
+        // hint 为初始配置（例如屏幕采集源直接从 Screen 开始）。
+        void setContentAdaptive(bool enabled, ContentType hint = ContentType::Natural);
+        ContentType contentType() const { return m_contentType; }
+
+        // 送入结束标记并把编码器缓存的包 (lookahead / B 帧) 全部送往下游；之后不能再送帧
+        void flush();
+
+        // 逐帧延迟 / 大小 / 帧类型 / QP 统计
+        EncoderProfiler &profiler() { return m_profiler; }
 
     private:
         bool init_hw_encoder();
+        bool openCodec();
+        void applyPendingConfig();
+        bool swapEncoder();
+        void drainEncoder(AVCodecContext *ctx);
+        bool supportsLiveBitrate() const;
+        void analyzeContent(const AVFrame *frame);
+        std::shared_ptr<AVFrameWrapper> acquireConversionFrame(AVPixelFormat format, int width, int height);
+        bool convertFastPath(const AVFrame *src, AVFrame *dst);
 
         std::string m_codecName;
         std::string m_hwTypeName;
+        std::string m_preset;
+        int m_threadCount = 0;
         const AVCodec *m_codec = nullptr;
         AVCodecContext *m_codecCtx = nullptr;
         AVBufferRef *m_hwDeviceCtx = nullptr;
         AVBufferRef *m_hwFramesCtx = nullptr;
         int64_t m_pts = 0;
+        AVRational m_sourceTimeBase = {0, 1};
+        int64_t m_lastSourcePts = AV_NOPTS_VALUE;
+        AVRational m_inputTimeBase = {0, 1};
+        int64_t m_lastInputPts = AV_NOPTS_VALUE;
+
+        int m_width = 0;
+        int m_height = 0;
+        int m_fps = 30;        // 输入帧率，决定 time_base
+        int m_outputFps = 30;  // 实际编码帧率，低于输入帧率时按比例丢帧
+        int m_fpsAccumulator = 0;
+        int64_t m_bitRate = 0;
+        int m_framesSinceKeyframe = 0;
+
+        bool m_contentAdaptive = false;
+        ContentType m_contentType = ContentType::Natural;
+        ContentType m_pendingContent = ContentType::Natural; // 采样检测到、等待 GOP 边界生效的类型
+        ContentClassifier m_classifier;
+        int64_t m_analyzedFrames = 0;
+
+        EncoderProfiler m_profiler;
+
+        // 待应用的运行时配置，由 reconfigure() 写入、process() 线程读取
+        std::mutex m_configMutex;
+        bool m_configPending = false;
+        int64_t m_pendingBitRate = 0;
+        int m_pendingFps = 0;
 
         // SwsContext for internal format conversion if input doesn't match
         SwsContext *m_swsContext = nullptr;
@@ -42,6 +112,10 @@ namespace pb
         int m_swsHeight = 0;
         AVPixelFormat m_swsInFmt = AV_PIX_FMT_NONE;
         AVPixelFormat m_swsOutFmt = AV_PIX_FMT_NONE;
+
+        // 格式转换用的复用帧，避免每帧 av_frame_get_buffer
+        static constexpr size_t kConversionPoolSize = 4;
+        std::vector<std::shared_ptr<AVFrameWrapper>> m_conversionPool;
     };
 
 } // namespace pb
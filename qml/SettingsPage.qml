@@ -267,6 +267,69 @@ ScrollView {
                         Layout.columnSpan: 2
                         contentItem: Text { text: parent.text; color: window.colorText; font.pixelSize: 14; leftPadding: 35; verticalAlignment: Text.AlignVCenter }
                     }
+
+                    CheckBox {
+                        id: adaptiveEnable
+                        text: "自适应码率 (ABR)"
+                        checked: bridge.adaptiveBitrate
+                        Layout.columnSpan: 2
+                        onToggled: bridge.adaptiveBitrate = checked
+                        contentItem: Text { text: parent.text; color: window.colorText; font.pixelSize: 14; leftPadding: 35; verticalAlignment: Text.AlignVCenter }
+                    }
+
+                    CheckBox {
+                        id: loopEnable
+                        text: "文件循环播放"
+                        checked: bridge.loopInput
+                        Layout.columnSpan: 2
+                        onToggled: bridge.loopInput = checked
+                        contentItem: Text { text: parent.text; color: window.colorText; font.pixelSize: 14; leftPadding: 35; verticalAlignment: Text.AlignVCenter }
+                    }
+
+                    CheckBox {
+                        id: jitterEnable
+                        text: "网络输入抖动缓冲"
+                        checked: bridge.jitterBuffer
+                        Layout.columnSpan: 2
+                        onToggled: bridge.jitterBuffer = checked
+                        contentItem: Text { text: parent.text; color: window.colorText; font.pixelSize: 14; leftPadding: 35; verticalAlignment: Text.AlignVCenter }
+                    }
+
+                    CheckBox {
+                        id: audioEnable
+                        text: "音频直通 (不转码)"
+                        checked: bridge.audioPassthrough
+                        Layout.columnSpan: 2
+                        onToggled: bridge.audioPassthrough = checked
+                        contentItem: Text { text: parent.text; color: window.colorText; font.pixelSize: 14; leftPadding: 35; verticalAlignment: Text.AlignVCenter }
+                    }
+
+                    CheckBox {
+                        id: directIoEnable
+                        text: "录制绕过页缓存 (O_DIRECT)"
+                        checked: bridge.recordDirectIo
+                        Layout.columnSpan: 2
+                        onToggled: bridge.recordDirectIo = checked
+                        contentItem: Text { text: parent.text; color: window.colorText; font.pixelSize: 14; leftPadding: 35; verticalAlignment: Text.AlignVCenter }
+                    }
+
+                    CheckBox {
+                        id: udpPacingEnable
+                        text: "UDP/RTP 平滑发送 (摊开关键帧突发)"
+                        checked: bridge.udpPacing
+                        Layout.columnSpan: 2
+                        onToggled: bridge.udpPacing = checked
+                        contentItem: Text { text: parent.text; color: window.colorText; font.pixelSize: 14; leftPadding: 35; verticalAlignment: Text.AlignVCenter }
+                    }
+
+                    CheckBox {
+                        id: contentAdaptiveEnable
+                        text: "按画面内容 (屏幕 / 自然) 切换编码参数"
+                        checked: bridge.contentAdaptive
+                        Layout.columnSpan: 2
+                        onToggled: bridge.contentAdaptive = checked
+                        contentItem: Text { text: parent.text; color: window.colorText; font.pixelSize: 14; leftPadding: 35; verticalAlignment: Text.AlignVCenter }
+                    }
                 }
 
                 Rectangle { Layout.fillWidth: true; height: 1; color: "#333" }
@@ -395,6 +458,22 @@ ScrollView {
                             verticalAlignment: Qt.AlignVCenter
                         }
                     }
+
+                    // 附加输出：与主输出共用同一次编码
+                    Label { 
+                        text: "附加输出:"; color: window.colorSecondary; font.pixelSize: 14
+                        visible: protocolType.currentText !== "RTSP Server"
+                    }
+                    TextField {
+                        id: extraOutputs
+                        placeholderText: "以逗号分隔的 URL 或文件路径，如 rtmp://host/app/key, /tmp/record.ts, /srv/hls/live.m3u8"
+                        Layout.fillWidth: true
+                        Layout.columnSpan: 3
+                        Layout.preferredHeight: 45
+                        visible: protocolType.currentText !== "RTSP Server"
+                        color: window.colorText
+                        background: Rectangle { color: "#2a2a2a"; radius: 8; border.color: "#333" }
+                    }
                 }
 
                 RowLayout {
@@ -417,6 +496,10 @@ ScrollView {
                             let fps = serveFps.value
                             let lat = serveLatency.currentIndex
                             let echo = echoEnable.checked
+                            let push = function(url) {
+                                let outputs = [url].concat(extraOutputs.text.split(",").map(u => u.trim()).filter(u => u !== ""))
+                                bridge.startPushMulti(serveSource.text, outputs, serveEnc.currentText, hw, fps, lat, echo)
+                            }
                             if (protocolType.currentText === "RTSP Server") {
                                 bridge.startServe(serveSource.text, serverPort.value, serverStreamName.text, serveEnc.currentText, hw, fps, lat, echo, serverAddress.text)
                             } else if (protocolType.currentText === "UDP Push") {
@@ -425,16 +508,16 @@ ScrollView {
                                 if (localAddress.text !== "") opts.push("localaddr=" + localAddress.text)
                                 if (localPort.value !== 0) opts.push("localport=" + localPort.value)
                                 if (opts.length > 0) url += "?" + opts.join("&")
-                                bridge.startPush(serveSource.text, url, serveEnc.currentText, hw, fps, lat, echo)
+                                push(url)
                             } else if (protocolType.currentText === "RTP Push") {
                                 let url = "rtp://" + targetAddress.text + ":" + targetPort.value
                                 let opts = []
                                 if (localAddress.text !== "") opts.push("localaddr=" + localAddress.text)
                                 if (localPort.value !== 0) opts.push("localport=" + localPort.value)
                                 if (opts.length > 0) url += "?" + opts.join("&")
-                                bridge.startPush(serveSource.text, url, serveEnc.currentText, hw, fps, lat, echo)
+                                push(url)
                             } else if (protocolType.currentText === "RTSP Push") {
-                                bridge.startPush(serveSource.text, targetAddress.text, serveEnc.currentText, hw, fps, lat, echo)
+                                push(targetAddress.text)
                             }
                             if (echo) window.switchToDisplay()
                         }
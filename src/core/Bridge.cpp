@@ -1,12 +1,21 @@
 #include "core/Bridge.h"
 #include "filters/Demuxer.h"
+#include "filters/JitterBuffer.h"
 #include "filters/VideoDecoder.h"
 #include "filters/VideoEncoder.h"
 #include "filters/RtspServerFilter.h"
 #include "filters/Muxer.h"
+#include "filters/SegmentMuxer.h"
 #include "filters/ScreenCapture.h"
+#include "core/RateController.h"
+#include "core/EncoderTuner.h"
+#include <algorithm>
 #include <thread>
+#include <QPointer>
+#include <QScopeGuard>
+#include <QThread>
 #include <QUrl>
+#include <QUrlQuery>
 #include <spdlog/spdlog.h>
 extern "C"
 {
@@ -40,6 +49,77 @@ namespace pb
     };
 }
 
+// 创建并初始化编码器；encoder 为 "auto" 时使用校准结果，没有结果时先用默认配置启动并在后台校准。
+// contentAdaptive 关闭时只按来源类型选一次参数，不再随画面内容切换
+static std::shared_ptr<pb::VideoEncoder> createEncoder(const std::string &encoder, const std::string &hw, bool screenSource,
+                                                       bool contentAdaptive, pb::LatencyLevel level, int width, int height, int fps)
+{
+    std::string name = encoder;
+    pb::EncoderConfig tuned;
+    if (encoder == "auto")
+    {
+        auto &tuner = pb::EncoderTuner::instance();
+        if (!tuner.lookup(width, height, fps, hw, level, tuned))
+        {
+            // 校准要跑数十秒，不能阻塞启动路径
+            tuned = tuner.defaultConfig(hw, level);
+            if (tuned.encoder.empty())
+                return nullptr;
+            spdlog::info("No calibration for {}x{}@{}, starting with {} {} and calibrating in background",
+                         width, height, fps, tuned.encoder, tuned.preset);
+            tuner.calibrateInBackground(width, height, fps, hw, level);
+        }
+        name = tuned.encoder;
+    }
+
+    auto enc = std::make_shared<pb::VideoEncoder>(name, hw);
+    enc->setLatencyLevel(level);
+    enc->setPreset(tuned.preset);
+    enc->setThreadCount(tuned.threads);
+    enc->setContentAdaptive(contentAdaptive, screenSource ? pb::ContentType::Screen : pb::ContentType::Natural);
+    if (!enc->initialize(width, height, fps))
+        return nullptr;
+    return enc;
+}
+
+// 网络输入在解复用与解码之间插入抖动缓冲；本地文件或已关闭时返回空
+static std::shared_ptr<pb::JitterBuffer> createJitterBuffer(const pb::Demuxer &demuxer, bool enabled, pb::LatencyLevel level)
+{
+    if (!enabled || !demuxer.isNetworkInput())
+        return nullptr;
+    auto jitter = std::make_shared<pb::JitterBuffer>(demuxer.getVideoTimeBase());
+    jitter->setLatencyLevel(level);
+    if (!jitter->initialize())
+        return nullptr;
+    return jitter;
+}
+
+// 以 .m3u8 结尾的输出写成分片 + 播放列表，可带参数：
+// ?format=ts (默认 fmp4) &segment=秒 &part=秒 (0 关闭 LL-HLS) &keep=保留分片数 (0 全部保留)
+static std::shared_ptr<pb::SegmentMuxer> createSegmentMuxer(const std::string &output, pb::LatencyLevel level)
+{
+    size_t queryPos = output.find('?');
+    std::string path = output.substr(0, queryPos);
+    if (path.size() < 5 || path.compare(path.size() - 5, 5, ".m3u8") != 0)
+        return nullptr;
+
+    auto segmenter = std::make_shared<pb::SegmentMuxer>(path);
+    segmenter->setLatencyLevel(level);
+    if (queryPos != std::string::npos)
+    {
+        QUrlQuery query(QString::fromStdString(output.substr(queryPos + 1)));
+        if (query.queryItemValue("format") == "ts")
+            segmenter->setFormat(pb::SegmentMuxer::Format::MpegTs);
+        if (query.hasQueryItem("segment"))
+            segmenter->setSegmentDuration(query.queryItemValue("segment").toDouble());
+        if (query.hasQueryItem("part"))
+            segmenter->setPartDuration(query.queryItemValue("part").toDouble());
+        if (query.hasQueryItem("keep"))
+            segmenter->setRetention(query.queryItemValue("keep").toInt());
+    }
+    return segmenter;
+}
+
 Bridge::Bridge(QObject *parent) : QObject(parent)
 {
     m_qmlSink = new pb::QmlVideoSinkFilter();
@@ -48,6 +128,12 @@ Bridge::Bridge(QObject *parent) : QObject(parent)
 Bridge::~Bridge()
 {
     spdlog::info("Bridge destructor started");
+    if (m_calibrationThread)
+    {
+        // 校准在候选之间检查取消标记，最多再等一个候选测完
+        m_calibrationCancel = true;
+        m_calibrationThread->wait();
+    }
     stopAll();
     spdlog::info("Bridge chains stopped, deleting QML sink");
     delete m_qmlSink;
@@ -70,6 +156,79 @@ void Bridge::setVideoSink(QVideoSink *sink)
     }
 }
 
+void Bridge::setAdaptiveBitrate(bool enabled)
+{
+    if (m_adaptiveBitrate != enabled)
+    {
+        m_adaptiveBitrate = enabled;
+        emit adaptiveBitrateChanged();
+    }
+}
+
+void Bridge::setLoopInput(bool enabled)
+{
+    if (m_loopInput != enabled)
+    {
+        m_loopInput = enabled;
+        emit loopInputChanged();
+    }
+}
+
+void Bridge::setPacingMode(int mode)
+{
+    mode = std::clamp(mode, 0, 2);
+    if (m_pacingMode != mode)
+    {
+        m_pacingMode = mode;
+        emit pacingModeChanged();
+    }
+}
+
+void Bridge::setJitterBuffer(bool enabled)
+{
+    if (m_jitterBuffer != enabled)
+    {
+        m_jitterBuffer = enabled;
+        emit jitterBufferChanged();
+    }
+}
+
+void Bridge::setAudioPassthrough(bool enabled)
+{
+    if (m_audioPassthrough != enabled)
+    {
+        m_audioPassthrough = enabled;
+        emit audioPassthroughChanged();
+    }
+}
+
+void Bridge::setRecordDirectIo(bool enabled)
+{
+    if (m_recordDirectIo != enabled)
+    {
+        m_recordDirectIo = enabled;
+        emit recordDirectIoChanged();
+    }
+}
+
+void Bridge::setUdpPacing(bool enabled)
+{
+    if (m_udpPacing != enabled)
+    {
+        m_udpPacing = enabled;
+        emit udpPacingChanged();
+    }
+}
+
+void Bridge::setContentAdaptive(bool enabled)
+{
+    if (m_contentAdaptive != enabled)
+    {
+        m_contentAdaptive = enabled;
+        emit contentAdaptiveChanged();
+    }
+}
+
 QStringList Bridge::hwTypes() const
 {
     QStringList types;
@@ -134,6 +293,11 @@ QStringList Bridge::getEncoders(const QString &codecType, const QString &hwType)
         }
     }
     encoders.sort();
+    if (!encoders.isEmpty() && codecType == "H.264")
+    {
+        // 由 EncoderTuner 根据校准结果选择编码器 / 预设 / 线程数
+        encoders << "auto";
+    }
     if (hwType == "None")
     {
         if (codecType == "H.264" && encoders.contains("libx264"))
@@ -150,6 +314,251 @@ QStringList Bridge::getEncoders(const QString &codecType, const QString &hwType)
     return encoders;
 }
 
+static QVariantMap histogramToMap(const pb::EncoderProfiler::Histogram &hist)
+{
+    QVariantList bounds, counts;
+    for (double b : hist.bounds)
+        bounds << b;
+    for (uint64_t c : hist.counts)
+        counts << (qulonglong)c;
+    QVariantMap map;
+    map["bounds"] = bounds;
+    map["counts"] = counts;
+    return map;
+}
+
+QVariantMap Bridge::encoderStats()
+{
+    std::lock_guard<std::mutex> lock(m_chainMutex);
+    for (auto &chain : m_chains)
+    {
+        for (auto &filter : chain)
+        {
+            auto enc = std::dynamic_pointer_cast<pb::VideoEncoder>(filter);
+            if (!enc)
+                continue;
+
+            auto snap = enc->profiler().snapshot();
+            QVariantMap stats;
+            stats["encoder"] = QString::fromStdString(enc->codecName());
+            stats["frames"] = (qulonglong)snap.frames;
+            stats["keyframes"] = (qulonglong)snap.keyframes;
+            stats["stalls"] = (qulonglong)snap.stalls;
+            stats["avgLatencyMs"] = snap.avgLatencyMs;
+            stats["p50LatencyMs"] = snap.p50LatencyMs;
+            stats["p95LatencyMs"] = snap.p95LatencyMs;
+            stats["p99LatencyMs"] = snap.p99LatencyMs;
+            stats["maxLatencyMs"] = snap.maxLatencyMs;
+            stats["avgSize"] = snap.avgSize;
+            stats["avgQp"] = snap.avgQp;
+            stats["latencyHistogram"] = histogramToMap(snap.latency);
+            stats["sizeHistogram"] = histogramToMap(snap.size);
+
+            QVariantList timeline;
+            for (const auto &sec : snap.timeline)
+            {
+                QVariantMap entry;
+                entry["second"] = (qlonglong)sec.second;
+                entry["frames"] = sec.frames;
+                entry["keyframes"] = sec.keyframes;
+                entry["bytes"] = (qlonglong)sec.bytes;
+                entry["avgLatencyMs"] = sec.avgLatencyMs;
+                entry["maxLatencyMs"] = sec.maxLatencyMs;
+                entry["avgQp"] = sec.avgQp;
+                timeline << entry;
+            }
+            stats["timeline"] = timeline;
+            return stats;
+        }
+    }
+    return QVariantMap();
+}
+
+QVariantMap Bridge::decoderStats()
+{
+    std::lock_guard<std::mutex> lock(m_chainMutex);
+    for (auto &chain : m_chains)
+    {
+        for (auto &filter : chain)
+        {
+            auto dec = std::dynamic_pointer_cast<pb::VideoDecoder>(filter);
+            if (!dec)
+                continue;
+
+            auto snap = dec->stats();
+            QVariantMap stats;
+            stats["shedLevel"] = (int)snap.level;
+            stats["lagMs"] = snap.lagMs;
+            stats["packets"] = (qulonglong)snap.packets;
+            stats["frames"] = (qulonglong)snap.frames;
+            stats["skippedFrames"] = (qulonglong)snap.skippedFrames;
+            stats["levelChanges"] = (qulonglong)snap.levelChanges;
+            return stats;
+        }
+    }
+    return QVariantMap();
+}
+
+QVariantMap Bridge::jitterStats()
+{
+    std::lock_guard<std::mutex> lock(m_chainMutex);
+    for (auto &chain : m_chains)
+    {
+        for (auto &filter : chain)
+        {
+            auto jitter = std::dynamic_pointer_cast<pb::JitterBuffer>(filter);
+            if (!jitter)
+                continue;
+
+            auto snap = jitter->stats();
+            QVariantMap stats;
+            stats["jitterMs"] = snap.jitterMs;
+            stats["delayMs"] = snap.delayMs;
+            stats["depth"] = (qulonglong)snap.depth;
+            stats["received"] = (qulonglong)snap.received;
+            stats["released"] = (qulonglong)snap.released;
+            stats["reordered"] = (qulonglong)snap.reordered;
+            stats["late"] = (qulonglong)snap.late;
+            stats["lost"] = (qulonglong)snap.lost;
+            return stats;
+        }
+    }
+    return QVariantMap();
+}
+
+QVariantMap Bridge::muxerStats()
+{
+    std::lock_guard<std::mutex> lock(m_chainMutex);
+    QVariantMap stats;
+    QVariantList outputs;
+    for (auto &chain : m_chains)
+    {
+        for (auto &filter : chain)
+        {
+            if (auto segmenter = std::dynamic_pointer_cast<pb::SegmentMuxer>(filter))
+            {
+                auto snap = segmenter->stats();
+                QVariantMap output;
+                output["url"] = QString::fromStdString(segmenter->url());
+                output["segments"] = (qulonglong)snap.segments;
+                output["parts"] = (qulonglong)snap.parts;
+                output["bytes"] = (qulonglong)snap.bytes;
+                output["dropped"] = (qulonglong)snap.dropped;
+                output["queued"] = (qulonglong)snap.queued;
+                if (outputs.isEmpty())
+                    stats = output;
+                outputs.append(output);
+                continue;
+            }
+
+            auto muxer = std::dynamic_pointer_cast<pb::Muxer>(filter);
+            if (!muxer)
+                continue;
+
+            auto snap = muxer->stats();
+            QVariantMap output;
+            output["url"] = QString::fromStdString(muxer->url());
+            output["queuedFrames"] = (qulonglong)snap.queuedFrames;
+            output["capacity"] = (qulonglong)snap.capacity;
+            output["written"] = (qulonglong)snap.written;
+            output["dropped"] = (qulonglong)snap.dropped;
+            output["droppedGops"] = (qulonglong)snap.droppedGops;
+            output["writeMs"] = snap.writeMs;
+            output["peakWriteMs"] = snap.peakWriteMs;
+            output["connected"] = snap.connected;
+            output["failed"] = snap.failed;
+            if (snap.failed)
+                output["error"] = QString::fromStdString(snap.error);
+            output["reconnects"] = snap.reconnects;
+            output["pacerBacklogBytes"] = (qulonglong)snap.pacerBacklogBytes;
+            output["pacerDropped"] = (qulonglong)snap.pacerDropped;
+            // 顶层字段保持为第一个 (主) 输出的状态
+            if (outputs.isEmpty())
+                stats = output;
+            outputs.append(output);
+        }
+    }
+    if (!outputs.isEmpty())
+        stats["outputs"] = outputs;
+    return stats;
+}
+
+bool Bridge::setEncoderTrace(const QString &path)
+{
+    std::lock_guard<std::mutex> lock(m_chainMutex);
+    bool applied = false;
+    for (auto &chain : m_chains)
+    {
+        for (auto &filter : chain)
+        {
+            if (auto enc = std::dynamic_pointer_cast<pb::VideoEncoder>(filter))
+                applied = enc->profiler().setTraceFile(path.toStdString()) || applied;
+        }
+    }
+    return applied;
+}
+
+void Bridge::calibrateEncoders(int width, int height, int fps, const QString &hwType, int latencyLevel)
+{
+    if (m_calibrationThread && m_calibrationThread->isRunning())
+    {
+        spdlog::warn("calibrateEncoders(): a calibration is already running");
+        return;
+    }
+
+    std::string sHw = hwType.toStdString();
+    pb::LatencyLevel level = (pb::LatencyLevel)latencyLevel;
+    m_calibrationCancel = false;
+    m_calibrationThread.reset(QThread::create([this, width, height, fps, sHw, level]()
+                                              {
+        pb::EncoderConfig best;
+        bool ok = pb::EncoderTuner::instance().calibrate(width, height, fps, sHw, level, best, [this]()
+                                                         { return m_calibrationCancel.load(); });
+        if (m_calibrationCancel)
+            return;
+        // 结果回到 Bridge 所在线程再发信号
+        QPointer<Bridge> self(this);
+        QMetaObject::invokeMethod(this, [self, ok, best]()
+                                  {
+            if (!self)
+                return;
+            emit self->calibrationFinished(ok, QString::fromStdString(best.encoder), QString::fromStdString(best.preset),
+                                           best.threads, best.fps, best.psnr); }, Qt::QueuedConnection); }));
+    m_calibrationThread->start();
+}
+
+bool Bridge::updateEncoder(int bitrateKbps, int fps)
+{
+    std::lock_guard<std::mutex> lock(m_chainMutex);
+    bool applied = false;
+    for (auto &chain : m_chains)
+    {
+        for (auto &filter : chain)
+        {
+            if (auto enc = std::dynamic_pointer_cast<pb::VideoEncoder>(filter))
+            {
+                enc->reconfigure((int64_t)bitrateKbps * 1000, fps);
+                applied = true;
+            }
+
+            // 手动设定同时作为码率控制的新上限，否则下一次评估会把它改回去
+            std::shared_ptr<pb::RateController> controller;
+            if (auto muxer = std::dynamic_pointer_cast<pb::Muxer>(filter))
+                controller = muxer->rateController();
+            else if (auto server = std::dynamic_pointer_cast<pb::RtspServerFilter>(filter))
+                controller = server->rateController();
+            if (controller)
+                controller->reset((int64_t)bitrateKbps * 1000, fps);
+        }
+    }
+
+    if (applied)
+        spdlog::info("Live encoder update requested: {} kbps, {} fps", bitrateKbps, fps);
+    else
+        spdlog::warn("updateEncoder(): no running encoder");
+    return applied;
+}
+
 void Bridge::stopAll()
 {
     spdlog::info("stopAll() called, acquiring lock...");
@@ -159,6 +568,25 @@ void Bridge::stopAll()
     spdlog::info("stopAll() lock acquired, stopping {} chains", m_chains.size());
     spdlog::default_logger()->flush();
 
+    // 作废仍在后台初始化的链，并打断其阻塞中的打开操作
+    m_generation++;
+    for (auto &filter : m_pending)
+    {
+        filter->requestStop();
+    }
+    m_pending.clear();
+
+    // 先向数据源一侧发出停止信号，让阻塞中的读取同时开始退出，再逐个 join；
+    // 输出端不在此中止，其 stop() 会在限时内写完已排队的数据再写尾
+    for (auto &chain : m_chains)
+    {
+        if (chain.empty())
+            continue;
+        chain[0]->requestStop();
+        if (chain.size() > 1 && std::dynamic_pointer_cast<pb::JitterBuffer>(chain[1]))
+            chain[1]->requestStop();
+    }
+
     // Reverse order stop: Source filters first to stop data flow, then others
     for (size_t i = 0; i < m_chains.size(); ++i)
     {
@@ -169,6 +597,9 @@ void Bridge::stopAll()
             spdlog::default_logger()->flush();
             // Stop source first
             chain[0]->stop();
+            // 抖动缓冲有自己的输出线程，同样属于数据源一侧，需在下游停止前退出
+            if (chain.size() > 1 && std::dynamic_pointer_cast<pb::JitterBuffer>(chain[1]))
+                chain[1]->stop();
         }
     }
 
@@ -187,10 +618,80 @@ void Bridge::stopAll()
     }
 
     m_chains.clear();
+    updateTunerGate();
     spdlog::info("All pipeline chains stopped and cleared.");
     spdlog::default_logger()->flush();
 }
 
+void Bridge::trackPending(std::vector<std::shared_ptr<pb::Filter>> &tracked, const std::shared_ptr<pb::Filter> &filter)
+{
+    tracked.push_back(filter);
+    std::lock_guard<std::mutex> lock(m_chainMutex);
+    m_pending.push_back(filter);
+}
+
+void Bridge::releasePending(const std::vector<std::shared_ptr<pb::Filter>> &tracked)
+{
+    std::vector<std::shared_ptr<pb::Filter>> orphaned;
+    {
+        std::lock_guard<std::mutex> lock(m_chainMutex);
+        for (auto &filter : tracked)
+        {
+            auto it = std::find(m_pending.begin(), m_pending.end(), filter);
+            if (it == m_pending.end())
+                continue;
+            m_pending.erase(it);
+            orphaned.push_back(filter);
+        }
+    }
+    // 建链中途失败：已初始化的过滤器可能持有连接或线程，在锁外停止
+    for (auto it = orphaned.rbegin(); it != orphaned.rend(); ++it)
+        (*it)->stop();
+}
+
+void Bridge::beginBuild()
+{
+    std::lock_guard<std::mutex> lock(m_chainMutex);
+    m_building++;
+    updateTunerGate();
+}
+
+void Bridge::endBuild()
+{
+    std::lock_guard<std::mutex> lock(m_chainMutex);
+    m_building--;
+    updateTunerGate();
+}
+
+void Bridge::updateTunerGate()
+{
+    pb::EncoderTuner::instance().setPipelinesRunning(m_building > 0 || !m_chains.empty());
+}
+
+bool Bridge::commitChain(uint64_t generation, const std::vector<std::shared_ptr<pb::Filter>> &filters)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_chainMutex);
+        for (auto &filter : filters)
+        {
+            m_pending.erase(std::remove(m_pending.begin(), m_pending.end(), filter), m_pending.end());
+        }
+        if (generation == m_generation)
+        {
+            m_chains.push_back(filters);
+            updateTunerGate();
+            return true;
+        }
+    }
+
+    spdlog::info("Pipeline was stopped during initialization, discarding chain");
+    for (auto it = filters.rbegin(); it != filters.rend(); ++it)
+    {
+        (*it)->stop();
+    }
+    return false;
+}
+
 void Bridge::startPlay(const QString &url, const QString &hwType, int latencyLevel)
 {
     stopAll();
@@ -198,25 +699,44 @@ void Bridge::startPlay(const QString &url, const QString &hwType, int latencyLev
     std::string sHw = hwType.toStdString();
     pb::LatencyLevel level = (pb::LatencyLevel)latencyLevel;
 
-    std::thread([this, sUrl, sHw, level]()
+    uint64_t generation = m_generation;
+
+    std::thread([this, sUrl, sHw, level, generation]()
                 {
+        std::vector<std::shared_ptr<pb::Filter>> tracked;
+        beginBuild();
+        auto releaseTracked = qScopeGuard([this, &tracked]() {
+            releasePending(tracked);
+            endBuild();
+        });
         auto demuxer = std::make_shared<pb::Demuxer>(sUrl);
         demuxer->setLatencyLevel(level);
+        demuxer->setLoop(m_loopInput);
+        demuxer->setPacingMode(static_cast<pb::Demuxer::PacingMode>(m_pacingMode.load()));
+        trackPending(tracked, demuxer);
         if (!demuxer->initialize()) return;
 
         auto decoder = std::make_shared<pb::VideoDecoder>(demuxer->getVideoCodecParameters(), sHw);
         decoder->setLatencyLevel(level);
+        decoder->setTimeBase(demuxer->getVideoTimeBase());
         if (!decoder->initialize()) return;
         
-        demuxer->setNextFilter(decoder.get());
+        auto jitter = createJitterBuffer(*demuxer, m_jitterBuffer, level);
+        std::vector<std::shared_ptr<pb::Filter>> filters = {demuxer};
+        if (jitter) {
+            demuxer->setNextFilter(jitter.get());
+            jitter->setNextFilter(decoder.get());
+            filters.push_back(jitter);
+        } else {
+            demuxer->setNextFilter(decoder.get());
+        }
         decoder->setNextFilter(m_qmlSink);
+        filters.push_back(decoder);
         
-        {
-            std::lock_guard<std::mutex> lock(m_chainMutex);
-            m_chains.push_back({demuxer, decoder});
-        }
+        if (!commitChain(generation, filters)) return;
         
         spdlog::info("Starting playback (Level: {}) to QML: {}", (int)level, sUrl);
+        if (jitter) jitter->start();
         demuxer->start(); })
         .detach();
 }
@@ -231,10 +751,21 @@ void Bridge::startServe(const QString &source, int port, const QString &name, co
     std::string sAddr = address.toStdString();
     pb::LatencyLevel level = (pb::LatencyLevel)latencyLevel;
 
-    std::thread([this, sSource, port, sName, sEnc, sHw, fps, level, echo, sAddr]()
+    uint64_t generation = m_generation;
+
+    std::thread([this, sSource, port, sName, sEnc, sHw, fps, level, echo, sAddr, generation]()
                 {
+        std::vector<std::shared_ptr<pb::Filter>> tracked;
+        beginBuild();
+        auto releaseTracked = qScopeGuard([this, &tracked]() {
+            releasePending(tracked);
+            endBuild();
+        });
         std::shared_ptr<pb::Filter> src;
+        std::shared_ptr<pb::JitterBuffer> jitter;
+        pb::Demuxer *audioSource = nullptr;
         AVCodecParameters *params = nullptr;
+        AVRational timeBase = {0, 1};
         if (sSource.find("screen") == 0) {
             std::string display = (sSource.find(":") != std::string::npos) ? sSource.substr(sSource.find(":") + 1) : ":1";
             auto capture = std::make_shared<pb::ScreenCapture>(display, fps);
@@ -245,25 +776,52 @@ void Bridge::startServe(const QString &source, int port, const QString &name, co
         } else {
             auto demuxer = std::make_shared<pb::Demuxer>(sSource);
             demuxer->setLatencyLevel(level);
+            demuxer->setLoop(m_loopInput);
+            demuxer->setPacingMode(static_cast<pb::Demuxer::PacingMode>(m_pacingMode.load()));
+            trackPending(tracked, demuxer);
             if (!demuxer->initialize()) return;
             params = demuxer->getVideoCodecParameters();
+            timeBase = demuxer->getVideoTimeBase();
+            jitter = createJitterBuffer(*demuxer, m_jitterBuffer, level);
+            if (m_audioPassthrough && demuxer->getAudioCodecParameters())
+                audioSource = demuxer.get();
             src = demuxer;
         }
 
         auto decoder = std::make_shared<pb::VideoDecoder>(params, sHw);
         decoder->setLatencyLevel(level);
+        decoder->setTimeBase(timeBase);
         if (!decoder->initialize()) return;
 
-        auto enc = std::make_shared<pb::VideoEncoder>(sEnc, sHw);
-        enc->setLatencyLevel(level);
-        if (!enc->initialize(params->width, params->height, fps)) return;
+        auto enc = createEncoder(sEnc, sHw, sSource.find("screen") == 0, m_contentAdaptive, level, params->width, params->height, fps);
+        if (!enc) return;
+        if (timeBase.num > 0)
+            enc->setInputTimeBase(timeBase);
+
+        if (audioSource) {
+            // 视频时间戳跟随源时间轴，RTSP 才能把直通音频与视频映射到同一呈现时间
+            enc->setSourceTimeBase(timeBase);
+        }
 
         auto server = std::make_shared<pb::RtspServerFilter>(port, sName, sAddr);
         server->setLatencyLevel(level);
+        if (m_adaptiveBitrate)
+            server->setRateController(std::make_shared<pb::RateController>(enc, enc->bitRate(), fps));
+        if (audioSource)
+            server->setAudioStream(audioSource->getAudioCodecParameters(), audioSource->getAudioTimeBase());
         if (!server->initialize(enc->getCodecContext())) return;
+        if (audioSource)
+            audioSource->setAudioSink(server.get());
         
-        src->setNextFilter(decoder.get());
-        std::vector<std::shared_ptr<pb::Filter>> filters = {src, decoder, enc, server};
+        std::vector<std::shared_ptr<pb::Filter>> filters = {src};
+        if (jitter) {
+            src->setNextFilter(jitter.get());
+            jitter->setNextFilter(decoder.get());
+            filters.push_back(jitter);
+        } else {
+            src->setNextFilter(decoder.get());
+        }
+        filters.insert(filters.end(), {decoder, enc, server});
 
         if (echo) {
             auto tee = std::make_shared<pb::TeeFilter>();
@@ -276,29 +834,47 @@ void Bridge::startServe(const QString &source, int port, const QString &name, co
         }
         enc->setNextFilter(server.get());
         
-        {
-            std::lock_guard<std::mutex> lock(m_chainMutex);
-            m_chains.push_back(filters);
-        }
+        if (!commitChain(generation, filters)) return;
         
         spdlog::info("Starting RTSP server (Level: {}, Echo: {}): rtsp://{}:{}/{}", (int)level, echo, sAddr.empty() ? "localhost" : sAddr, port, sName);
+        if (jitter) jitter->start();
         src->start(); })
         .detach();
 }
 
 void Bridge::startPush(const QString &input, const QString &output, const QString &encoder, const QString &hw, int fps, int latencyLevel, bool echo)
+{
+    startPushMulti(input, QStringList{output}, encoder, hw, fps, latencyLevel, echo);
+}
+
+void Bridge::startPushMulti(const QString &input, const QStringList &outputs, const QString &encoder, const QString &hw, int fps, int latencyLevel, bool echo)
 {
     stopAll();
+    if (outputs.isEmpty())
+        return;
     std::string sInput = input.toStdString();
-    std::string sOutput = output.toStdString();
+    std::vector<std::string> sOutputs;
+    for (const auto &output : outputs)
+        sOutputs.push_back(output.toStdString());
     std::string sEnc = encoder.toStdString();
     std::string sHw = hw.toStdString();
     pb::LatencyLevel level = (pb::LatencyLevel)latencyLevel;
 
-    std::thread([this, sInput, sOutput, sEnc, sHw, fps, level, echo]()
+    uint64_t generation = m_generation;
+
+    std::thread([this, sInput, sOutputs, sEnc, sHw, fps, level, echo, generation]()
                 {
+        std::vector<std::shared_ptr<pb::Filter>> tracked;
+        beginBuild();
+        auto releaseTracked = qScopeGuard([this, &tracked]() {
+            releasePending(tracked);
+            endBuild();
+        });
         std::shared_ptr<pb::Filter> src;
+        std::shared_ptr<pb::JitterBuffer> jitter;
+        pb::Demuxer *audioSource = nullptr;
         AVCodecParameters *params = nullptr;
+        AVRational timeBase = {0, 1};
         if (sInput.find("screen") == 0) {
             std::string display = (sInput.find(":") != std::string::npos) ? sInput.substr(sInput.find(":") + 1) : ":1";
             auto capture = std::make_shared<pb::ScreenCapture>(display, fps);
@@ -309,25 +885,67 @@ void Bridge::startPush(const QString &input, const QString &output, const QStrin
         } else {
             auto demuxer = std::make_shared<pb::Demuxer>(sInput);
             demuxer->setLatencyLevel(level);
+            demuxer->setLoop(m_loopInput);
+            demuxer->setPacingMode(static_cast<pb::Demuxer::PacingMode>(m_pacingMode.load()));
+            trackPending(tracked, demuxer);
             if (!demuxer->initialize()) return;
             params = demuxer->getVideoCodecParameters();
+            timeBase = demuxer->getVideoTimeBase();
+            jitter = createJitterBuffer(*demuxer, m_jitterBuffer, level);
+            if (m_audioPassthrough && demuxer->getAudioCodecParameters())
+                audioSource = demuxer.get();
             src = demuxer;
         }
 
         auto decoder = std::make_shared<pb::VideoDecoder>(params, sHw);
         decoder->setLatencyLevel(level);
+        decoder->setTimeBase(timeBase);
         if (!decoder->initialize()) return;
 
-        auto enc = std::make_shared<pb::VideoEncoder>(sEnc, sHw);
-        enc->setLatencyLevel(level);
-        if (!enc->initialize(params->width, params->height, fps)) return;
+        auto enc = createEncoder(sEnc, sHw, sInput.find("screen") == 0, m_contentAdaptive, level, params->width, params->height, fps);
+        if (!enc) return;
+        if (timeBase.num > 0)
+            enc->setInputTimeBase(timeBase);
+        if (audioSource) {
+            // 视频时间戳改为跟随源时间轴，Muxer 才能把直通音频对齐到同一零点
+            enc->setSourceTimeBase(timeBase);
+        }
 
-        auto muxer = std::make_shared<pb::Muxer>(sOutput);
-        muxer->setLatencyLevel(level);
-        if (!muxer->initialize(enc->getCodecContext())) return;
-        
-        src->setNextFilter(decoder.get());
-        std::vector<std::shared_ptr<pb::Filter>> filters = {src, decoder, enc, muxer};
+        // 所有输出共用同一次编码：每个 Muxer 有自己的队列与写出线程，编码包按引用分发，
+        // 增加一个输出只增加它自己的 I/O 开销
+        std::vector<std::shared_ptr<pb::Filter>> muxers;
+        for (const auto &sOutput : sOutputs) {
+            if (auto segmenter = createSegmentMuxer(sOutput, level)) {
+                if (audioSource)
+                    segmenter->setAudioStream(audioSource->getAudioCodecParameters(), audioSource->getAudioTimeBase());
+                if (!segmenter->initialize(enc->getCodecContext())) return;
+                muxers.push_back(segmenter);
+                continue;
+            }
+            auto muxer = std::make_shared<pb::Muxer>(sOutput);
+            muxer->setLatencyLevel(level);
+            muxer->setDirectIo(m_recordDirectIo);
+            muxer->setUdpPacing(m_udpPacing);
+            // 码率控制只跟随第一个 (主) 输出，多个队列交替上报会互相干扰
+            if (m_adaptiveBitrate && muxers.empty())
+                muxer->setRateController(std::make_shared<pb::RateController>(enc, enc->bitRate(), fps));
+            if (audioSource)
+                muxer->setAudioStream(audioSource->getAudioCodecParameters(), audioSource->getAudioTimeBase());
+            trackPending(tracked, muxer);
+            if (!muxer->initialize(enc->getCodecContext())) return;
+            muxers.push_back(muxer);
+        }
+
+        std::vector<std::shared_ptr<pb::Filter>> filters = {src};
+        if (jitter) {
+            src->setNextFilter(jitter.get());
+            jitter->setNextFilter(decoder.get());
+            filters.push_back(jitter);
+        } else {
+            src->setNextFilter(decoder.get());
+        }
+        filters.insert(filters.end(), {decoder, enc});
+        filters.insert(filters.end(), muxers.begin(), muxers.end());
 
         if (echo) {
             auto tee = std::make_shared<pb::TeeFilter>();
@@ -338,14 +956,31 @@ void Bridge::startPush(const QString &input, const QString &output, const QStrin
         } else {
             decoder->setNextFilter(enc.get());
         }
-        enc->setNextFilter(muxer.get());
-        
-        {
-            std::lock_guard<std::mutex> lock(m_chainMutex);
-            m_chains.push_back(filters);
+
+        if (muxers.size() == 1) {
+            enc->setNextFilter(muxers[0].get());
+            if (audioSource)
+                audioSource->setAudioSink(muxers[0].get());
+        } else {
+            auto videoTee = std::make_shared<pb::TeeFilter>();
+            for (auto &muxer : muxers)
+                videoTee->addTarget(muxer.get());
+            enc->setNextFilter(videoTee.get());
+            filters.push_back(videoTee);
+            if (audioSource) {
+                auto audioTee = std::make_shared<pb::TeeFilter>();
+                for (auto &muxer : muxers)
+                    audioTee->addTarget(muxer.get());
+                audioSource->setAudioSink(audioTee.get());
+                filters.push_back(audioTee);
+            }
         }
         
-        spdlog::info("Starting push (Level: {}, Echo: {}): {} -> {}", (int)level, echo, sInput, sOutput);
+        if (!commitChain(generation, filters)) return;
+        
+        for (const auto &sOutput : sOutputs)
+            spdlog::info("Starting push (Level: {}, Echo: {}): {} -> {}", (int)level, echo, sInput, sOutput);
+        if (jitter) jitter->start();
         src->start(); })
         .detach();
 }
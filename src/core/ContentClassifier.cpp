@@ -0,0 +1,170 @@
+#include "core/ContentClassifier.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PB_CLASSIFIER_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PB_CLASSIFIER_NEON 1
+#endif
+
+namespace pb
+{
+    // 每 4 行采样一行，统计量对 1080p 只需处理约 50 万像素
+    static constexpr int kRowStep = 4;
+    // 连续多少次判定为另一类型才真正切换
+    static constexpr int kSwitchVotes = 5;
+
+    namespace
+    {
+        struct RowSums
+        {
+            uint64_t sad = 0;      // 与上一帧同一行的绝对差之和
+            uint64_t equal = 0;    // 与右侧像素相等的数量
+            uint64_t gradient = 0; // 与右侧像素的绝对差之和
+        };
+
+        // 处理一行：cur 与 prev (可为空) 比较运动，cur 与自身右移一像素比较平坦度 / 梯度
+        inline void scanRow(const uint8_t *cur, const uint8_t *prev, int width, RowSums &sums)
+        {
+            int x = 0;
+            // 右移比较需要读取 x + 16，因此向量部分处理到 width - 17
+#if defined(PB_CLASSIFIER_SSE2)
+            __m128i sadAcc = _mm_setzero_si128();
+            __m128i gradAcc = _mm_setzero_si128();
+            for (; x + 17 <= width; x += 16)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i *)(cur + x));
+                __m128i b = _mm_loadu_si128((const __m128i *)(cur + x + 1));
+                gradAcc = _mm_add_epi64(gradAcc, _mm_sad_epu8(a, b));
+                sums.equal += std::popcount((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+                if (prev)
+                {
+                    __m128i p = _mm_loadu_si128((const __m128i *)(prev + x));
+                    sadAcc = _mm_add_epi64(sadAcc, _mm_sad_epu8(a, p));
+                }
+            }
+            sums.gradient += (uint64_t)_mm_cvtsi128_si32(gradAcc) + (uint64_t)_mm_cvtsi128_si32(_mm_srli_si128(gradAcc, 8));
+            sums.sad += (uint64_t)_mm_cvtsi128_si32(sadAcc) + (uint64_t)_mm_cvtsi128_si32(_mm_srli_si128(sadAcc, 8));
+#elif defined(PB_CLASSIFIER_NEON)
+            for (; x + 17 <= width; x += 16)
+            {
+                uint8x16_t a = vld1q_u8(cur + x);
+                uint8x16_t b = vld1q_u8(cur + x + 1);
+                sums.gradient += vaddlvq_u8(vabdq_u8(a, b));
+                sums.equal += vaddvq_u8(vshrq_n_u8(vceqq_u8(a, b), 7));
+                if (prev)
+                {
+                    sums.sad += vaddlvq_u8(vabdq_u8(a, vld1q_u8(prev + x)));
+                }
+            }
+#endif
+            for (; x + 1 < width; ++x)
+            {
+                int d = std::abs((int)cur[x] - (int)cur[x + 1]);
+                sums.gradient += d;
+                sums.equal += (d == 0);
+                if (prev)
+                    sums.sad += std::abs((int)cur[x] - (int)prev[x]);
+            }
+        }
+    } // namespace
+
+    ContentClassifier::ContentClassifier(ContentType initial) : m_current(initial) {}
+
+    void ContentClassifier::reset(ContentType initial)
+    {
+        m_current = initial;
+        m_votes = 0;
+        m_prevRows.clear();
+        m_prevWidth = 0;
+        m_prevHeight = 0;
+    }
+
+    ContentClassifier::Stats ContentClassifier::computeStats(const uint8_t *luma, int linesize, int width, int height)
+    {
+        Stats stats;
+        int rows = (height + kRowStep - 1) / kRowStep;
+        bool hasPrev = (m_prevWidth == width && m_prevHeight == height && !m_prevRows.empty());
+        if (!hasPrev)
+        {
+            m_prevRows.assign((size_t)rows * width, 0);
+            m_prevWidth = width;
+            m_prevHeight = height;
+        }
+
+        RowSums sums;
+        std::array<uint32_t, 256> histogram{};
+        for (int r = 0; r < rows; ++r)
+        {
+            const uint8_t *row = luma + (size_t)r * kRowStep * linesize;
+            uint8_t *prev = m_prevRows.data() + (size_t)r * width;
+            scanRow(row, hasPrev ? prev : nullptr, width, sums);
+
+            // 颜色分布：直方图只在稀疏采样点上统计
+            for (int x = 0; x < width; x += 4)
+                histogram[row[x]]++;
+
+            std::memcpy(prev, row, width);
+        }
+
+        uint64_t pixels = (uint64_t)rows * width;
+        uint64_t pairs = (uint64_t)rows * (width - 1);
+        if (pixels == 0 || pairs == 0)
+            return stats;
+
+        stats.motion = hasPrev ? (double)sums.sad / pixels : 0.0;
+        stats.flat = (double)sums.equal / pairs;
+        uint64_t nonFlat = pairs - sums.equal;
+        stats.edge = nonFlat > 0 ? (double)sums.gradient / nonFlat : 0.0;
+
+        std::partial_sort(histogram.begin(), histogram.begin() + 8, histogram.end(), std::greater<uint32_t>());
+        uint64_t samples = 0, top = 0;
+        for (int i = 0; i < 256; ++i)
+        {
+            samples += histogram[i];
+            if (i < 8)
+                top += histogram[i];
+        }
+        stats.topMass = samples > 0 ? (double)top / samples : 0.0;
+        return stats;
+    }
+
+    ContentType ContentClassifier::analyze(const uint8_t *luma, int linesize, int width, int height)
+    {
+        if (!luma || width < 32 || height < kRowStep)
+            return m_current;
+
+        m_lastStats = computeStats(luma, linesize, width, height);
+        const Stats &s = m_lastStats;
+
+        // 屏幕内容：大面积完全平坦 + 颜色集中 + 边缘锐利，且运动较少
+        bool looksScreen = s.flat >= 0.5 && s.topMass >= 0.35 && s.edge >= 12.0 && s.motion < 8.0;
+        // 自然画面：几乎没有完全相等的相邻像素，或者整体运动剧烈
+        bool looksNatural = s.flat < 0.3 || s.motion > 16.0;
+
+        ContentType candidate = m_current;
+        if (looksScreen && !looksNatural)
+            candidate = ContentType::Screen;
+        else if (looksNatural)
+            candidate = ContentType::Natural;
+
+        if (candidate == m_current)
+        {
+            m_votes = 0;
+        }
+        else if (++m_votes >= kSwitchVotes)
+        {
+            m_current = candidate;
+            m_votes = 0;
+        }
+        return m_current;
+    }
+
+} // namespace pb
@@ -0,0 +1,221 @@
+#include "core/EncoderProfiler.h"
+#include <algorithm>
+#include <limits>
+#include <spdlog/spdlog.h>
+
+extern "C"
+{
+#include <libavutil/avutil.h>
+#include <libavutil/intreadwrite.h>
+}
+
+namespace pb
+{
+    static constexpr size_t kRecentSamples = 1024;
+    static constexpr size_t kTimelineSeconds = 120;
+    // 等待匹配的已送入帧上限，防止编码器异常时无限增长
+    static constexpr size_t kMaxPending = 512;
+
+    static void addSample(EncoderProfiler::Histogram &hist, double value)
+    {
+        size_t i = std::upper_bound(hist.bounds.begin(), hist.bounds.end(), value) - hist.bounds.begin();
+        hist.counts[i]++;
+    }
+
+    EncoderProfiler::EncoderProfiler()
+    {
+        m_latencyHist.bounds = {1, 2, 4, 8, 16, 33, 66, 133, 266, 533};
+        m_sizeHist.bounds = {1024, 4096, 16384, 65536, 262144, 1048576};
+        reset();
+    }
+
+    EncoderProfiler::~EncoderProfiler() = default;
+
+    void EncoderProfiler::setFrameInterval(double ms)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stallThresholdMs = std::max(200.0, ms * 5.0);
+    }
+
+    void EncoderProfiler::reset()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_start = std::chrono::steady_clock::now();
+        m_pending.clear();
+        m_frames = m_keyframes = m_stalls = 0;
+        m_latencySum = m_maxLatency = m_sizeSum = m_qpSum = 0.0;
+        m_qpSamples = 0;
+        m_latencyHist.counts.assign(m_latencyHist.bounds.size() + 1, 0);
+        m_sizeHist.counts.assign(m_sizeHist.bounds.size() + 1, 0);
+        m_recentLatency.clear();
+        m_recentPos = 0;
+        m_current = Accumulator();
+        m_timeline.clear();
+    }
+
+    bool EncoderProfiler::setTraceFile(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_trace.is_open())
+            m_trace.close();
+        if (path.empty())
+            return true;
+
+        m_trace.open(path, std::ios::out | std::ios::trunc);
+        if (!m_trace.is_open())
+        {
+            spdlog::error("[EncoderProfiler] Could not open trace file {}", path);
+            return false;
+        }
+        m_traceJson = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        if (!m_traceJson)
+            m_trace << "time_ms,pts,latency_ms,size,type,qp\n";
+        spdlog::info("[EncoderProfiler] Writing {} trace to {}", m_traceJson ? "JSON" : "CSV", path);
+        return true;
+    }
+
+    void EncoderProfiler::onFrameSent(int64_t pts)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pending.size() >= kMaxPending)
+            m_pending.pop_front();
+        m_pending.emplace_back(pts, std::chrono::steady_clock::now());
+    }
+
+    void EncoderProfiler::pushSecond(int64_t second)
+    {
+        if (m_current.stats.frames > 0)
+        {
+            SecondStats done = m_current.stats;
+            done.avgLatencyMs = m_current.latencySum / done.frames;
+            done.avgQp = m_current.qpSamples > 0 ? m_current.qpSum / m_current.qpSamples : 0.0;
+            m_timeline.push_back(done);
+            while (m_timeline.size() > kTimelineSeconds)
+                m_timeline.pop_front();
+        }
+        m_current = Accumulator();
+        m_current.stats.second = second;
+    }
+
+    void EncoderProfiler::onPacket(const AVPacket *pkt)
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        // 帧类型与 QP 来自编码器附带的 AV_PKT_DATA_QUALITY_STATS
+        int qp = -1;
+        char type = (pkt->flags & AV_PKT_FLAG_KEY) ? 'I' : '?';
+        size_t sdSize = 0;
+        const uint8_t *sd = av_packet_get_side_data(pkt, AV_PKT_DATA_QUALITY_STATS, &sdSize);
+        if (sd && sdSize >= 5)
+        {
+            qp = (int)(AV_RL32(sd) / FF_QP2LAMBDA);
+            type = av_get_picture_type_char((AVPictureType)sd[4]);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // 没有 B 帧，输出顺序与输入一致：丢弃早于该包的未匹配项
+        double latencyMs = -1.0;
+        while (!m_pending.empty() && m_pending.front().first < pkt->pts)
+            m_pending.pop_front();
+        if (!m_pending.empty() && m_pending.front().first == pkt->pts)
+        {
+            latencyMs = std::chrono::duration<double, std::milli>(now - m_pending.front().second).count();
+            m_pending.pop_front();
+        }
+
+        int64_t second = std::chrono::duration_cast<std::chrono::seconds>(now - m_start).count();
+        if (second != m_current.stats.second)
+            pushSecond(second);
+
+        m_frames++;
+        m_sizeSum += pkt->size;
+        addSample(m_sizeHist, pkt->size);
+        m_current.stats.frames++;
+        m_current.stats.bytes += pkt->size;
+        if (pkt->flags & AV_PKT_FLAG_KEY)
+        {
+            m_keyframes++;
+            m_current.stats.keyframes++;
+        }
+        if (qp >= 0)
+        {
+            m_qpSum += qp;
+            m_qpSamples++;
+            m_current.qpSum += qp;
+            m_current.qpSamples++;
+        }
+
+        if (latencyMs >= 0.0)
+        {
+            m_latencySum += latencyMs;
+            m_maxLatency = std::max(m_maxLatency, latencyMs);
+            addSample(m_latencyHist, latencyMs);
+            m_current.latencySum += latencyMs;
+            m_current.stats.maxLatencyMs = std::max(m_current.stats.maxLatencyMs, latencyMs);
+
+            if (m_recentLatency.size() < kRecentSamples)
+                m_recentLatency.push_back(latencyMs);
+            else
+                m_recentLatency[m_recentPos] = latencyMs;
+            m_recentPos = (m_recentPos + 1) % kRecentSamples;
+
+            if (latencyMs > m_stallThresholdMs)
+            {
+                // 卡顿计数每次都加，日志只在首次和之后每 50 次输出一次
+                if (m_stalls++ % 50 == 0)
+                {
+                    spdlog::warn("[EncoderProfiler] Encoder stall: pts={} took {:.1f} ms (threshold {:.1f} ms)",
+                                 pkt->pts, latencyMs, m_stallThresholdMs);
+                }
+            }
+        }
+
+        if (m_trace.is_open())
+        {
+            double t = std::chrono::duration<double, std::milli>(now - m_start).count();
+            if (m_traceJson)
+            {
+                m_trace << "{\"time_ms\":" << t << ",\"pts\":" << pkt->pts << ",\"latency_ms\":" << latencyMs
+                        << ",\"size\":" << pkt->size << ",\"type\":\"" << type << "\",\"qp\":" << qp << "}\n";
+            }
+            else
+            {
+                m_trace << t << ',' << pkt->pts << ',' << latencyMs << ',' << pkt->size << ',' << type << ',' << qp << '\n';
+            }
+        }
+    }
+
+    EncoderProfiler::Snapshot EncoderProfiler::snapshot() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Snapshot snap;
+        snap.frames = m_frames;
+        snap.keyframes = m_keyframes;
+        snap.stalls = m_stalls;
+        snap.maxLatencyMs = m_maxLatency;
+        snap.avgSize = m_frames > 0 ? m_sizeSum / m_frames : 0.0;
+        snap.avgQp = m_qpSamples > 0 ? m_qpSum / m_qpSamples : 0.0;
+        snap.latency = m_latencyHist;
+        snap.size = m_sizeHist;
+        snap.timeline.assign(m_timeline.begin(), m_timeline.end());
+
+        uint64_t latencySamples = 0;
+        for (auto c : m_latencyHist.counts)
+            latencySamples += c;
+        snap.avgLatencyMs = latencySamples > 0 ? m_latencySum / latencySamples : 0.0;
+
+        if (!m_recentLatency.empty())
+        {
+            std::vector<double> sorted = m_recentLatency;
+            std::sort(sorted.begin(), sorted.end());
+            auto pct = [&](double p)
+            { return sorted[std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5))]; };
+            snap.p50LatencyMs = pct(0.50);
+            snap.p95LatencyMs = pct(0.95);
+            snap.p99LatencyMs = pct(0.99);
+        }
+        return snap;
+    }
+
+} // namespace pb
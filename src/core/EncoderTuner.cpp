@@ -0,0 +1,482 @@
+#include "core/EncoderTuner.h"
+#include "filters/VideoEncoder.h"
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <spdlog/spdlog.h>
+
+namespace pb
+{
+    // 每个候选配置编码的合成帧数
+    static constexpr int kCalibrationFrames = 60;
+    // 满足“画质达标”的亮度 PSNR 下限
+    static constexpr double kTargetPsnr = 35.0;
+
+    namespace
+    {
+        // 生成确定性的合成画面：渐变背景 + 移动的纹理块 + 类似文字的细条纹 + 少量噪声，
+        // 同时覆盖自然画面与屏幕内容的特点。帧内容只由 index 决定，计算 PSNR 时可重新生成。
+        void fillSyntheticFrame(AVFrame *frame, int index)
+        {
+            int w = frame->width;
+            int h = frame->height;
+            int boxSize = std::max(16, h / 5);
+            int boxX = (index * 7) % std::max(1, w - boxSize);
+            int boxY = (index * 3) % std::max(1, h - boxSize);
+
+            for (int y = 0; y < h; ++y)
+            {
+                uint8_t *row = frame->data[0] + (size_t)y * frame->linesize[0];
+                for (int x = 0; x < w; ++x)
+                {
+                    int v = 64 + ((x + y + index * 3) & 0x7f);
+                    if (x >= boxX && x < boxX + boxSize && y >= boxY && y < boxY + boxSize)
+                        v = 128 + (((x - boxX) ^ (y - boxY)) & 0x7f);
+                    else if (y < h / 4 && x < w / 2 && (y % 12) < 8)
+                        v = (((x / 3) * 7 + (y / 12) * 13) % 5 == 0) ? 16 : 235;
+                    uint32_t n = (uint32_t)(x * 73856093u ^ y * 19349663u ^ index * 83492791u);
+                    v += (int)(n >> 29) - 4;
+                    row[x] = (uint8_t)std::clamp(v, 0, 255);
+                }
+            }
+            for (int plane = 1; plane < 3; ++plane)
+            {
+                for (int y = 0; y < h / 2; ++y)
+                {
+                    uint8_t *row = frame->data[plane] + (size_t)y * frame->linesize[plane];
+                    for (int x = 0; x < w / 2; ++x)
+                        row[x] = (uint8_t)(96 + ((x * plane + y + index) & 0x3f));
+                }
+            }
+        }
+
+        // 收集编码输出并记录到达时间，解码和 PSNR 计算放在计时之外
+        class PacketCollector : public Filter
+        {
+        public:
+            PacketCollector() : Filter("PacketCollector") {}
+            bool initialize() override { return true; }
+            void stop() override {}
+
+            void process(DataPacket::Ptr packet) override
+            {
+                if (packet->type() != PacketType::AV_PACKET)
+                    return;
+                packets.push_back(std::static_pointer_cast<AVPacketWrapper>(packet));
+                arrivals.push_back(std::chrono::steady_clock::now());
+                sentAtArrival.push_back(framesSent);
+            }
+
+            std::vector<std::shared_ptr<AVPacketWrapper>> packets;
+            std::vector<std::chrono::steady_clock::time_point> arrivals;
+            std::vector<int> sentAtArrival;
+            int framesSent = 0;
+        };
+    } // namespace
+
+    EncoderTuner::EncoderTuner()
+    {
+        QString dir = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation);
+        QDir().mkpath(dir);
+        m_path = (dir + "/encoder_tuning.json").toStdString();
+        load();
+    }
+
+    EncoderTuner::~EncoderTuner()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_shutdown = true;
+        }
+        m_cv.notify_all();
+        // 正在测量的候选测完即退出，最多等一个候选的时间
+        if (m_worker.joinable())
+            m_worker.join();
+    }
+
+    std::string EncoderTuner::key(int width, int height, int fps, const std::string &hwType, LatencyLevel level)
+    {
+        return std::to_string(width) + "x" + std::to_string(height) + "@" + std::to_string(fps) + "/" +
+               (hwType.empty() ? "none" : hwType) + "/" + std::to_string((int)level);
+    }
+
+    void EncoderTuner::load()
+    {
+        QFile file(QString::fromStdString(m_path));
+        if (!file.open(QIODevice::ReadOnly))
+            return;
+
+        QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+        for (auto it = root.begin(); it != root.end(); ++it)
+        {
+            QJsonObject obj = it.value().toObject();
+            EncoderConfig cfg;
+            cfg.encoder = obj["encoder"].toString().toStdString();
+            cfg.preset = obj["preset"].toString().toStdString();
+            cfg.threads = obj["threads"].toInt();
+            cfg.fps = obj["fps"].toDouble();
+            cfg.latencyMs = obj["latencyMs"].toDouble();
+            cfg.psnr = obj["psnr"].toDouble();
+            if (!cfg.encoder.empty())
+                m_table[it.key().toStdString()] = cfg;
+        }
+        spdlog::info("[EncoderTuner] Loaded {} calibration entries from {}", m_table.size(), m_path);
+    }
+
+    void EncoderTuner::save()
+    {
+        QJsonObject root;
+        for (const auto &[k, cfg] : m_table)
+        {
+            QJsonObject obj;
+            obj["encoder"] = QString::fromStdString(cfg.encoder);
+            obj["preset"] = QString::fromStdString(cfg.preset);
+            obj["threads"] = cfg.threads;
+            obj["fps"] = cfg.fps;
+            obj["latencyMs"] = cfg.latencyMs;
+            obj["psnr"] = cfg.psnr;
+            root[QString::fromStdString(k)] = obj;
+        }
+
+        QFile file(QString::fromStdString(m_path));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            spdlog::error("[EncoderTuner] Could not write {}", m_path);
+            return;
+        }
+        file.write(QJsonDocument(root).toJson());
+    }
+
+    bool EncoderTuner::lookup(int width, int height, int fps, const std::string &hwType, LatencyLevel level, EncoderConfig &out)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_table.find(key(width, height, fps, hwType, level));
+        if (it == m_table.end())
+            return false;
+        out = it->second;
+        return true;
+    }
+
+    EncoderConfig EncoderTuner::defaultConfig(const std::string &hwType, LatencyLevel level) const
+    {
+        // 候选列表的第一项是该硬件 / 等级下最快的预设；软件编码的线程数交给 x264 自动决定
+        auto list = candidates(hwType, level);
+        if (list.empty())
+            return {};
+        EncoderConfig cfg = list.front();
+        cfg.threads = 0;
+        return cfg;
+    }
+
+    void EncoderTuner::calibrateInBackground(int width, int height, int fps, const std::string &hwType, LatencyLevel level)
+    {
+        std::string k = key(width, height, fps, hwType, level);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_shutdown || !m_inFlight.insert(k).second)
+                return;
+            m_jobs.push_back({width, height, fps, hwType, level});
+            if (!m_worker.joinable())
+                m_worker = std::thread(&EncoderTuner::workerLoop, this);
+        }
+        m_cv.notify_all();
+    }
+
+    void EncoderTuner::setPipelinesRunning(bool running)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pipelinesRunning = running;
+        }
+        m_cv.notify_all();
+    }
+
+    void EncoderTuner::workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_cv.wait(lock, [this]
+                      { return m_shutdown || (!m_jobs.empty() && !m_pipelinesRunning); });
+            if (m_shutdown)
+                break;
+            Job job = m_jobs.front();
+            m_jobs.pop_front();
+            lock.unlock();
+
+            spdlog::info("[EncoderTuner] No pipeline running, calibrating {}x{}@{} in background", job.width, job.height, job.fps);
+            EncoderConfig best;
+            bool interrupted = false;
+            calibrate(job.width, job.height, job.fps, job.hwType, job.level, best, [this, &interrupted]()
+                      { return interrupted = m_shutdown || m_pipelinesRunning; });
+
+            lock.lock();
+            if (interrupted && !m_shutdown)
+            {
+                // 有管线启动：结果会被实时编码拖低，放回队列等下次空闲
+                spdlog::info("[EncoderTuner] Background calibration of {}x{}@{} interrupted by a running pipeline", job.width, job.height, job.fps);
+                m_jobs.push_back(job);
+                continue;
+            }
+            m_inFlight.erase(key(job.width, job.height, job.fps, job.hwType, job.level));
+        }
+    }
+
+    std::vector<EncoderConfig> EncoderTuner::candidates(const std::string &hwType, LatencyLevel level) const
+    {
+        std::vector<EncoderConfig> list;
+        if (hwType.empty())
+        {
+            if (!avcodec_find_encoder_by_name("libx264"))
+                return list;
+
+            std::vector<std::string> presets;
+            if (level == LatencyLevel::UltraLow)
+                presets = {"ultrafast", "superfast"};
+            else if (level == LatencyLevel::Low)
+                presets = {"ultrafast", "superfast", "veryfast"};
+            else
+                presets = {"superfast", "veryfast", "faster", "medium"};
+
+            int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+            std::vector<int> threads = {1};
+            if (cores >= 2)
+                threads.push_back(std::min(cores, 2));
+            if (cores >= 4)
+                threads.push_back(std::min(cores, 4));
+            threads.push_back(0);
+
+            for (const auto &preset : presets)
+                for (int t : threads)
+                    list.push_back({"libx264", preset, t});
+            return list;
+        }
+
+        // 硬件编码器：与 Bridge::getEncoders 相同的匹配规则，线程数由驱动决定
+        const AVCodec *codec = nullptr;
+        void *opaque = nullptr;
+        while ((codec = av_codec_iterate(&opaque)))
+        {
+            if (!av_codec_is_encoder(codec) || codec->id != AV_CODEC_ID_H264)
+                continue;
+            std::string name = codec->name;
+            bool match = (hwType == "cuda") ? name.find("nvenc") != std::string::npos
+                                            : name.find(hwType) != std::string::npos;
+            if (!match)
+                continue;
+
+            if (name.find("nvenc") != std::string::npos)
+            {
+                for (const char *preset : {"p1", "p2", "p4"})
+                    list.push_back({name, preset, 0});
+            }
+            else
+            {
+                list.push_back({name, "", 0});
+            }
+        }
+        return list;
+    }
+
+    bool EncoderTuner::measure(EncoderConfig &cfg, int width, int height, int fps, const std::string &hwType, LatencyLevel level)
+    {
+        auto enc = std::make_shared<VideoEncoder>(cfg.encoder, hwType);
+        enc->setLatencyLevel(level);
+        enc->setPreset(cfg.preset);
+        enc->setThreadCount(cfg.threads);
+        if (!enc->initialize(width, height, fps))
+            return false;
+
+        PacketCollector collector;
+        enc->setNextFilter(&collector);
+
+        std::vector<std::chrono::steady_clock::time_point> sendTimes(kCalibrationFrames);
+        double busySec = 0.0;
+        for (int i = 0; i < kCalibrationFrames; ++i)
+        {
+            auto frameWrapper = std::make_shared<AVFrameWrapper>();
+            AVFrame *frame = frameWrapper->get();
+            frame->format = AV_PIX_FMT_YUV420P;
+            frame->width = width;
+            frame->height = height;
+            if (av_frame_get_buffer(frame, 32) < 0)
+                return false;
+            fillSyntheticFrame(frame, i);
+
+            collector.framesSent = i + 1;
+            sendTimes[i] = std::chrono::steady_clock::now();
+            enc->process(frameWrapper);
+            busySec += std::chrono::duration<double>(std::chrono::steady_clock::now() - sendTimes[i]).count();
+        }
+
+        // 取出 lookahead / B 帧缓存的输出，否则这类配置会因包数不足被误判，延迟和 PSNR 也漏算了这些帧
+        auto flushStart = std::chrono::steady_clock::now();
+        enc->flush();
+        busySec += std::chrono::duration<double>(std::chrono::steady_clock::now() - flushStart).count();
+
+        if (collector.packets.size() < (size_t)kCalibrationFrames * 8 / 10 || busySec <= 0.0)
+        {
+            spdlog::warn("[EncoderTuner] {} {} produced only {} packets", cfg.encoder, cfg.preset, collector.packets.size());
+            return false;
+        }
+
+        // 延迟：被编码器缓存的帧按“实时输入”折算，即延迟帧数 * 帧间隔 + 最后一次调用的处理时间
+        double frameMs = 1000.0 / fps;
+        double totalLatency = 0.0;
+        for (size_t i = 0; i < collector.packets.size(); ++i)
+        {
+            int64_t pts = collector.packets[i]->get()->pts;
+            if (pts < 0 || pts >= kCalibrationFrames)
+                continue;
+            int lastSent = collector.sentAtArrival[i] - 1;
+            int delayFrames = std::max<int>(0, lastSent - (int)pts);
+            double processMs = std::chrono::duration<double, std::milli>(collector.arrivals[i] - sendTimes[lastSent]).count();
+            totalLatency += delayFrames * frameMs + processMs;
+        }
+        cfg.latencyMs = totalLatency / collector.packets.size();
+        cfg.fps = kCalibrationFrames / busySec;
+
+        // PSNR：解码输出与重新生成的源帧比较亮度平面
+        AVCodecContext *encCtx = enc->getCodecContext();
+        const AVCodec *decoder = avcodec_find_decoder(encCtx->codec_id);
+        AVCodecContext *decCtx = decoder ? avcodec_alloc_context3(decoder) : nullptr;
+        if (!decCtx || avcodec_open2(decCtx, decoder, nullptr) < 0)
+        {
+            if (decCtx)
+                avcodec_free_context(&decCtx);
+            cfg.psnr = 0.0;
+            return true;
+        }
+
+        AVFrame *decoded = av_frame_alloc();
+        AVFrame *reference = av_frame_alloc();
+        reference->format = AV_PIX_FMT_YUV420P;
+        reference->width = width;
+        reference->height = height;
+        av_frame_get_buffer(reference, 32);
+
+        double mseSum = 0.0;
+        int compared = 0;
+        auto compare = [&]()
+        {
+            while (avcodec_receive_frame(decCtx, decoded) >= 0)
+            {
+                int64_t idx = decoded->best_effort_timestamp;
+                if (idx >= 0 && idx < kCalibrationFrames && decoded->width == width && decoded->height == height)
+                {
+                    fillSyntheticFrame(reference, (int)idx);
+                    double sq = 0.0;
+                    for (int y = 0; y < height; ++y)
+                    {
+                        const uint8_t *a = decoded->data[0] + (size_t)y * decoded->linesize[0];
+                        const uint8_t *b = reference->data[0] + (size_t)y * reference->linesize[0];
+                        for (int x = 0; x < width; ++x)
+                        {
+                            int d = (int)a[x] - (int)b[x];
+                            sq += d * d;
+                        }
+                    }
+                    mseSum += sq / ((double)width * height);
+                    compared++;
+                }
+                av_frame_unref(decoded);
+            }
+        };
+        for (auto &pkt : collector.packets)
+        {
+            if (avcodec_send_packet(decCtx, pkt->get()) >= 0)
+                compare();
+        }
+        avcodec_send_packet(decCtx, nullptr);
+        compare();
+
+        double mse = compared > 0 ? mseSum / compared : 0.0;
+        cfg.psnr = (compared == 0) ? 0.0 : (mse <= 1e-10 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse));
+
+        av_frame_free(&reference);
+        av_frame_free(&decoded);
+        avcodec_free_context(&decCtx);
+        return true;
+    }
+
+    bool EncoderTuner::calibrate(int width, int height, int fps, const std::string &hwType, LatencyLevel level, EncoderConfig &best,
+                                 const std::function<bool()> &cancelled)
+    {
+        if (width <= 0 || height <= 0 || fps <= 0)
+            return false;
+
+        auto list = candidates(hwType, level);
+        if (list.empty())
+        {
+            spdlog::error("[EncoderTuner] No candidate encoders for hw type '{}'", hwType);
+            return false;
+        }
+
+        spdlog::info("[EncoderTuner] Calibrating {} candidates at {}x{}@{} (level {})", list.size(), width, height, fps, (int)level);
+
+        // 目标：吞吐量留 20% 余量，平均延迟不超过等级对应的帧数，亮度 PSNR 达标
+        double frameMs = 1000.0 / fps;
+        double latencyBudget = (level == LatencyLevel::UltraLow) ? frameMs
+                               : (level == LatencyLevel::Low)    ? 2.0 * frameMs
+                                                                 : std::numeric_limits<double>::infinity();
+
+        const EncoderConfig *chosen = nullptr;
+        const EncoderConfig *fallback = nullptr;
+        std::vector<EncoderConfig> results;
+        results.reserve(list.size());
+        for (auto &cfg : list)
+        {
+            if (cancelled && cancelled())
+            {
+                spdlog::info("[EncoderTuner] Calibration cancelled");
+                return false;
+            }
+            if (!measure(cfg, width, height, fps, hwType, level))
+                continue;
+            spdlog::info("[EncoderTuner] {} preset={} threads={}: {:.1f} fps, {:.2f} ms, {:.2f} dB",
+                         cfg.encoder, cfg.preset.empty() ? "default" : cfg.preset, cfg.threads, cfg.fps, cfg.latencyMs, cfg.psnr);
+            results.push_back(cfg);
+        }
+        if (cancelled && cancelled())
+        {
+            spdlog::info("[EncoderTuner] Calibration cancelled");
+            return false;
+        }
+
+        for (const auto &cfg : results)
+        {
+            bool realtime = cfg.fps >= fps * 1.2 && cfg.latencyMs <= latencyBudget;
+            if (realtime && cfg.psnr >= kTargetPsnr && (!chosen || cfg.fps > chosen->fps))
+                chosen = &cfg;
+            // 没有配置满足画质目标时，退而求其次选能实时且画质最好的；都不实时则选最快的
+            if (!fallback ||
+                (realtime && (fallback->fps < fps * 1.2 || cfg.psnr > fallback->psnr)) ||
+                (!realtime && fallback->fps < fps * 1.2 && cfg.fps > fallback->fps))
+                fallback = &cfg;
+        }
+        if (!chosen)
+            chosen = fallback;
+        if (!chosen)
+        {
+            spdlog::error("[EncoderTuner] Calibration failed: no candidate could be measured");
+            return false;
+        }
+
+        best = *chosen;
+        spdlog::info("[EncoderTuner] Selected {} preset={} threads={} ({:.1f} fps, {:.2f} ms, {:.2f} dB)",
+                     best.encoder, best.preset.empty() ? "default" : best.preset, best.threads, best.fps, best.latencyMs, best.psnr);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_table[key(width, height, fps, hwType, level)] = best;
+        save();
+        return true;
+    }
+
+} // namespace pb
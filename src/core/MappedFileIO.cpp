@@ -0,0 +1,256 @@
+#include "core/MappedFileIO.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <spdlog/spdlog.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+extern "C"
+{
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+namespace pb
+{
+    struct MappedRegion
+    {
+        const uint8_t *data = nullptr;
+        int64_t size = 0;
+        int64_t mtime = 0;
+        int fd = -1; // 保留用于检测文件变化，以及变化后的 pread 回退
+
+        ~MappedRegion()
+        {
+#ifndef _WIN32
+            if (data)
+                munmap(const_cast<uint8_t *>(data), (size_t)size);
+            if (fd >= 0)
+                ::close(fd);
+#endif
+        }
+    };
+
+    namespace
+    {
+        constexpr int kAvioBufferSize = 256 * 1024;
+        // 预读窗口按大页 (2MB) 对齐，读到窗口一半时再推进
+        constexpr int64_t kReadAheadAlign = 2 * 1024 * 1024;
+        constexpr int64_t kReadAheadWindow = 8 * 1024 * 1024;
+
+        // 以 设备/inode/大小/修改时间 为键共享映射，文件被替换后会重新映射
+        std::mutex g_registryMutex;
+        std::map<std::string, std::weak_ptr<MappedRegion>> g_registry;
+
+#ifndef _WIN32
+        std::shared_ptr<MappedRegion> mapFile(const std::string &path)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return nullptr;
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+            {
+                ::close(fd);
+                return nullptr;
+            }
+
+            std::string key = std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino) + ":" +
+                              std::to_string(st.st_size) + ":" + std::to_string(st.st_mtime);
+
+            std::lock_guard<std::mutex> lock(g_registryMutex);
+            if (auto existing = g_registry[key].lock())
+            {
+                ::close(fd);
+                return existing;
+            }
+
+            void *addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED)
+            {
+                spdlog::warn("[MappedFileIO] mmap failed for {}: {}", path, strerror(errno));
+                ::close(fd);
+                return nullptr;
+            }
+
+            madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+            // 只有启用了文件 THP 的内核才会生效，失败无妨
+            madvise(addr, (size_t)st.st_size, MADV_HUGEPAGE);
+#endif
+
+            auto region = std::make_shared<MappedRegion>();
+            region->data = static_cast<const uint8_t *>(addr);
+            region->size = st.st_size;
+            region->mtime = st.st_mtime;
+            region->fd = fd;
+
+            // 顺便清理已失效的条目
+            for (auto it = g_registry.begin(); it != g_registry.end();)
+                it = it->second.expired() ? g_registry.erase(it) : std::next(it);
+            g_registry[key] = region;
+            return region;
+        }
+#endif
+    } // namespace
+
+    std::unique_ptr<MappedFileIO> MappedFileIO::open(const std::string &path)
+    {
+#ifdef _WIN32
+        (void)path;
+        return nullptr;
+#else
+        std::string file = path.rfind("file:", 0) == 0 ? path.substr(5) : path;
+        auto region = mapFile(file);
+        if (!region)
+            return nullptr;
+
+        std::unique_ptr<MappedFileIO> io(new MappedFileIO());
+        io->m_region = std::move(region);
+
+        auto *buffer = static_cast<unsigned char *>(av_malloc(kAvioBufferSize));
+        if (!buffer)
+            return nullptr;
+        io->m_avio = avio_alloc_context(buffer, kAvioBufferSize, 0, io.get(), &MappedFileIO::readPacket, nullptr, &MappedFileIO::seek);
+        if (!io->m_avio)
+        {
+            av_free(buffer);
+            return nullptr;
+        }
+        io->m_avio->seekable = AVIO_SEEKABLE_NORMAL;
+        io->adviseAhead();
+        spdlog::info("[MappedFileIO] Mapped {} ({} MB)", file, io->m_region->size / (1024 * 1024));
+        return io;
+#endif
+    }
+
+    MappedFileIO::~MappedFileIO()
+    {
+        if (m_avio)
+        {
+            av_freep(&m_avio->buffer);
+            avio_context_free(&m_avio);
+        }
+    }
+
+    int64_t MappedFileIO::size() const
+    {
+        return m_region ? currentSize() : 0;
+    }
+
+    int64_t MappedFileIO::currentSize() const
+    {
+#ifndef _WIN32
+        struct stat st;
+        if (m_unmapped && fstat(m_region->fd, &st) == 0)
+            return st.st_size;
+#endif
+        return m_region->size;
+    }
+
+    bool MappedFileIO::checkMapping()
+    {
+#ifndef _WIN32
+        if (m_unmapped)
+            return false;
+        // 录制中或被原地改写的文件：截断后访问映射的尾部会触发 SIGBUS，发现变化后不再碰映射
+        struct stat st{};
+        if (fstat(m_region->fd, &st) == 0 && st.st_size == m_region->size && st.st_mtime == m_region->mtime)
+            return true;
+        spdlog::warn("[MappedFileIO] File changed during playback ({} -> {} bytes), switching to pread",
+                     m_region->size, (int64_t)st.st_size);
+        m_unmapped = true;
+        return false;
+#else
+        return true;
+#endif
+    }
+
+    int MappedFileIO::readPacket(void *opaque, uint8_t *buf, int bufSize)
+    {
+        auto *self = static_cast<MappedFileIO *>(opaque);
+#ifndef _WIN32
+        if (!self->checkMapping())
+        {
+            ssize_t n;
+            do
+            {
+                n = pread(self->m_region->fd, buf, (size_t)bufSize, self->m_pos);
+            } while (n < 0 && errno == EINTR);
+            if (n < 0)
+                return AVERROR(errno);
+            if (n == 0)
+                return AVERROR_EOF;
+            self->m_pos += n;
+            return (int)n;
+        }
+#endif
+        int64_t remaining = self->m_region->size - self->m_pos;
+        if (remaining <= 0)
+            return AVERROR_EOF;
+
+        // AVIO 的读接口要求拷贝进它的缓冲区，这里是唯一的一次拷贝 (没有 read() 系统调用)
+        int n = (int)std::min<int64_t>(remaining, bufSize);
+        memcpy(buf, self->m_region->data + self->m_pos, n);
+        self->m_pos += n;
+        self->adviseAhead();
+        return n;
+    }
+
+    int64_t MappedFileIO::seek(void *opaque, int64_t offset, int whence)
+    {
+        auto *self = static_cast<MappedFileIO *>(opaque);
+        int64_t size = self->currentSize();
+        int64_t pos;
+        switch (whence & ~AVSEEK_FORCE)
+        {
+        case AVSEEK_SIZE:
+            return size;
+        case SEEK_SET:
+            pos = offset;
+            break;
+        case SEEK_CUR:
+            pos = self->m_pos + offset;
+            break;
+        case SEEK_END:
+            pos = size + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+        }
+        if (pos < 0 || pos > size)
+            return AVERROR(EINVAL);
+
+        // 随机跳转后重新从新位置开始预读
+        if (pos < self->m_pos || pos > self->m_advisedUntil)
+            self->m_advisedUntil = pos;
+        self->m_pos = pos;
+        self->adviseAhead();
+        return pos;
+    }
+
+    void MappedFileIO::adviseAhead()
+    {
+#ifndef _WIN32
+        if (m_unmapped || m_advisedUntil - m_pos > kReadAheadWindow / 2 || m_advisedUntil >= m_region->size)
+            return;
+
+        int64_t start = std::max(m_pos, m_advisedUntil) & ~(kReadAheadAlign - 1);
+        int64_t end = std::min(m_region->size, ((m_pos + kReadAheadWindow) + kReadAheadAlign - 1) & ~(kReadAheadAlign - 1));
+        if (end <= start)
+            return;
+        madvise(const_cast<uint8_t *>(m_region->data) + start, (size_t)(end - start), MADV_WILLNEED);
+        m_advisedUntil = end;
+#endif
+    }
+
+} // namespace pb
@@ -0,0 +1,37 @@
+#include "core/PreciseClock.h"
+#include <thread>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <ctime>
+#endif
+
+namespace pb
+{
+
+    void preciseSleepUntil(std::chrono::steady_clock::time_point deadline, std::chrono::microseconds spinMargin)
+    {
+        auto coarse = deadline - spinMargin;
+        if (std::chrono::steady_clock::now() < coarse)
+        {
+#if defined(__linux__)
+            // libstdc++ / libc++ 在 Linux 上的 steady_clock 即 CLOCK_MONOTONIC，纪元相同
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(coarse.time_since_epoch()).count();
+            timespec ts;
+            ts.tv_sec = (time_t)(ns / 1000000000);
+            ts.tv_nsec = (long)(ns % 1000000000);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+            {
+            }
+#else
+            std::this_thread::sleep_until(coarse);
+#endif
+        }
+
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+} // namespace pb
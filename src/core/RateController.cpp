@@ -0,0 +1,151 @@
+#include "core/RateController.h"
+#include "filters/VideoEncoder.h"
+#include <algorithm>
+#include <cstdlib>
+#include <spdlog/spdlog.h>
+
+namespace pb
+{
+    // 评估间隔：避免每个 RR / 每个包都触发编码器重配置
+    static constexpr auto kEvaluateInterval = std::chrono::milliseconds(1000);
+    // 降码率后至少保持这么久再尝试回升，避免振荡
+    static constexpr auto kHoldAfterDecrease = std::chrono::milliseconds(3000);
+    // 加性回升：每个评估间隔增加上限码率的 5%，从下限回到上限约需 20s
+    static constexpr int64_t kIncreaseDivisor = 20;
+
+    RateController::RateController(std::weak_ptr<VideoEncoder> encoder, int64_t maxBitRate, int maxFps)
+        : m_encoder(std::move(encoder)),
+          m_maxBitRate(maxBitRate),
+          m_minBitRate(std::max<int64_t>(maxBitRate / 8, 300000)),
+          m_increaseStep(std::max<int64_t>(maxBitRate / kIncreaseDivisor, 1)),
+          m_maxFps(maxFps > 0 ? maxFps : 30),
+          m_targetBitRate(maxBitRate),
+          m_targetFps(m_maxFps),
+          m_appliedBitRate(maxBitRate),
+          m_appliedFps(m_maxFps)
+    {
+        m_lastEvaluate = std::chrono::steady_clock::now();
+        m_lastDecrease = m_lastEvaluate - kHoldAfterDecrease;
+    }
+
+    void RateController::onReceiverReport(double fractionLost, double jitterMs)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // RR 本身已是区间统计，这里只做轻度平滑
+            m_loss = m_hasReport ? (0.5 * m_loss + 0.5 * fractionLost) : fractionLost;
+            m_jitterMs = m_hasReport ? (0.7 * m_jitterMs + 0.3 * jitterMs) : jitterMs;
+            m_hasReport = true;
+        }
+        evaluate();
+    }
+
+    void RateController::onQueueDepth(size_t depth, size_t capacity)
+    {
+        if (capacity == 0)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            double ratio = std::min(1.0, (double)depth / (double)capacity);
+            m_queueRatio = 0.8 * m_queueRatio + 0.2 * ratio;
+        }
+        evaluate();
+    }
+
+    int64_t RateController::targetBitRate() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_targetBitRate;
+    }
+
+    int RateController::targetFps() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_targetFps;
+    }
+
+    void RateController::reset(int64_t bitRate, int fps)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (bitRate > 0)
+        {
+            m_maxBitRate = bitRate;
+            m_minBitRate = std::min(bitRate, std::max<int64_t>(bitRate / 8, 300000));
+            m_increaseStep = std::max<int64_t>(bitRate / kIncreaseDivisor, 1);
+        }
+        if (fps > 0)
+            m_maxFps = fps;
+        m_targetBitRate = m_maxBitRate;
+        m_targetFps = m_maxFps;
+        m_appliedBitRate = m_targetBitRate;
+        m_appliedFps = m_targetFps;
+        // 新设定至少保持一个回升等待期，旧的平滑统计不应立即把它降下去
+        auto now = std::chrono::steady_clock::now();
+        m_lastEvaluate = now;
+        m_lastDecrease = now;
+        m_queueRatio = 0.0;
+        spdlog::info("[RateController] Reset to {} kbps @ {} fps", m_maxBitRate / 1000, m_maxFps);
+    }
+
+    int RateController::fpsForBitRate(int64_t bitRate) const
+    {
+        // 码率降到一半以下时同时降低帧率，把有限的码率留给单帧质量
+        double ratio = (double)bitRate / (double)m_maxBitRate;
+        if (ratio >= 0.5)
+            return m_maxFps;
+        if (ratio >= 0.3)
+            return std::max(1, m_maxFps * 2 / 3);
+        return std::max(1, m_maxFps / 2);
+    }
+
+    void RateController::evaluate()
+    {
+        int64_t newBitRate = 0;
+        int newFps = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto now = std::chrono::steady_clock::now();
+            if (now - m_lastEvaluate < kEvaluateInterval)
+                return;
+            m_lastEvaluate = now;
+
+            int64_t target = m_targetBitRate;
+            if (m_loss > 0.10 || m_queueRatio > 0.5)
+            {
+                // 拥塞：按丢包率乘性下降，队列堆积时固定降 15%
+                double factor = (m_loss > 0.10) ? std::max(0.5, 1.0 - 0.5 * m_loss) : 0.85;
+                target = (int64_t)(target * factor);
+                m_lastDecrease = now;
+            }
+            else if (m_loss < 0.02 && m_queueRatio < 0.2 && m_jitterMs < 50.0 && now - m_lastDecrease >= kHoldAfterDecrease)
+            {
+                // 网络空闲：缓慢加性回升
+                target += m_increaseStep;
+            }
+            // 2% ~ 10% 丢包或抖动偏大：保持当前码率
+
+            target = std::clamp(target, m_minBitRate, m_maxBitRate);
+            m_targetBitRate = target;
+            m_targetFps = fpsForBitRate(target);
+
+            // 变化小于 5% 不重配置编码器 (对 libx264 而言意味着一次 GOP 边界切换)
+            bool bitRateChanged = std::llabs(target - m_appliedBitRate) * 20 > m_appliedBitRate;
+            if (!bitRateChanged && m_targetFps == m_appliedFps)
+                return;
+
+            m_appliedBitRate = target;
+            m_appliedFps = m_targetFps;
+            newBitRate = target;
+            newFps = m_targetFps;
+
+            spdlog::info("[RateController] loss={:.1f}% jitter={:.1f}ms queue={:.0f}% -> {} kbps @ {} fps",
+                         m_loss * 100.0, m_jitterMs, m_queueRatio * 100.0, newBitRate / 1000, newFps);
+        }
+
+        if (auto enc = m_encoder.lock())
+        {
+            enc->reconfigure(newBitRate, newFps);
+        }
+    }
+
+} // namespace pb
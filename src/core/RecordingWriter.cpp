@@ -0,0 +1,412 @@
+#include "core/RecordingWriter.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef PIXELBRIDGE_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+extern "C"
+{
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+namespace pb
+{
+    struct RecordingRing
+    {
+#ifdef PIXELBRIDGE_HAVE_LIBURING
+        struct io_uring ring;
+#endif
+    };
+
+    namespace
+    {
+        constexpr int kAvioBufferSize = 64 * 1024;
+        // O_DIRECT 要求缓冲区地址、长度与文件偏移按逻辑块对齐，4KB 覆盖常见设备
+        constexpr size_t kAlign = 4096;
+
+        size_t alignUp(size_t value)
+        {
+            return (value + kAlign - 1) & ~(kAlign - 1);
+        }
+    }
+
+    std::unique_ptr<RecordingWriter> RecordingWriter::open(const std::string &path, const Options &options)
+    {
+#ifdef _WIN32
+        (void)path;
+        (void)options;
+        return nullptr;
+#else
+        std::string file = path.rfind("file:", 0) == 0 ? path.substr(5) : path;
+        std::unique_ptr<RecordingWriter> writer(new RecordingWriter());
+        writer->m_path = file;
+
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#ifdef O_DIRECT
+        if (options.directIo)
+        {
+            writer->m_fd = ::open(file.c_str(), flags | O_DIRECT, 0644);
+            if (writer->m_fd >= 0)
+                writer->m_direct = true;
+            else if (errno == EINVAL)
+                spdlog::warn("[RecordingWriter] {} does not support O_DIRECT, using buffered writes", file);
+        }
+#endif
+        if (writer->m_fd < 0)
+            writer->m_fd = ::open(file.c_str(), flags, 0644);
+        if (writer->m_fd < 0)
+        {
+            spdlog::error("[RecordingWriter] Could not open {}: {}", file, strerror(errno));
+            return nullptr;
+        }
+
+        writer->m_blockSize = alignUp(std::max<size_t>(options.bufferSize, kAlign));
+        writer->m_blocks.resize(std::max(2, options.queueDepth));
+        for (auto &block : writer->m_blocks)
+        {
+            void *data = nullptr;
+            if (posix_memalign(&data, kAlign, writer->m_blockSize) != 0)
+                return nullptr;
+            block.data = static_cast<uint8_t *>(data);
+        }
+        writer->m_preallocChunk = options.preallocateChunk;
+
+#ifdef PIXELBRIDGE_HAVE_LIBURING
+        auto *ring = new RecordingRing();
+        int ret = io_uring_queue_init((unsigned)writer->m_blocks.size(), &ring->ring, 0);
+        if (ret == 0)
+        {
+            writer->m_ring = ring;
+        }
+        else
+        {
+            // 内核不支持或被 seccomp 禁用时退回同步 pwrite
+            spdlog::warn("[RecordingWriter] io_uring unavailable ({}), using pwrite", strerror(-ret));
+            delete ring;
+        }
+#endif
+
+        auto *buffer = static_cast<unsigned char *>(av_malloc(kAvioBufferSize));
+        if (!buffer)
+            return nullptr;
+        writer->m_avio = avio_alloc_context(buffer, kAvioBufferSize, 1, writer.get(), nullptr, &RecordingWriter::writePacket, &RecordingWriter::seek);
+        if (!writer->m_avio)
+        {
+            av_free(buffer);
+            return nullptr;
+        }
+        writer->m_avio->seekable = AVIO_SEEKABLE_NORMAL;
+
+        spdlog::info("[RecordingWriter] Recording to {} ({}{}, {} x {} KB blocks)", file,
+                     writer->m_ring ? "io_uring" : "pwrite", writer->m_direct ? ", O_DIRECT" : "",
+                     writer->m_blocks.size(), writer->m_blockSize / 1024);
+        return writer;
+#endif
+    }
+
+    RecordingWriter::~RecordingWriter()
+    {
+        close();
+        if (m_avio)
+        {
+            av_freep(&m_avio->buffer);
+            avio_context_free(&m_avio);
+        }
+        for (auto &block : m_blocks)
+            free(block.data);
+#ifdef PIXELBRIDGE_HAVE_LIBURING
+        if (m_ring)
+            io_uring_queue_exit(&m_ring->ring);
+#endif
+        delete m_ring;
+    }
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+    int RecordingWriter::writePacket(void *opaque, const uint8_t *buf, int bufSize)
+#else
+    int RecordingWriter::writePacket(void *opaque, uint8_t *buf, int bufSize)
+#endif
+    {
+        auto *self = static_cast<RecordingWriter *>(opaque);
+        if (self->m_sequential && self->m_pos == self->m_appendOffset + (int64_t)self->m_blocks[self->m_current].used)
+        {
+            self->append(buf, (size_t)bufSize);
+        }
+        else
+        {
+            if (self->m_sequential)
+                self->enterRandomMode();
+            self->writeSync(self->bufferedFd(), buf, (size_t)bufSize, self->m_pos);
+        }
+        self->m_pos += bufSize;
+        self->m_size = std::max(self->m_size, self->m_pos);
+        return self->m_failed ? AVERROR(EIO) : bufSize;
+    }
+
+    int64_t RecordingWriter::seek(void *opaque, int64_t offset, int whence)
+    {
+        auto *self = static_cast<RecordingWriter *>(opaque);
+        int64_t pos;
+        switch (whence & ~AVSEEK_FORCE)
+        {
+        case AVSEEK_SIZE:
+            return self->m_size;
+        case SEEK_SET:
+            pos = offset;
+            break;
+        case SEEK_CUR:
+            pos = self->m_pos + offset;
+            break;
+        case SEEK_END:
+            pos = self->m_size + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        // 只移动位置；真正的非顺序写入发生时才切换写法，seek 回原处继续追加不受影响
+        self->m_pos = pos;
+        return pos;
+    }
+
+    void RecordingWriter::append(const uint8_t *buf, size_t size)
+    {
+        while (size > 0)
+        {
+            Block &block = m_blocks[m_current];
+            size_t n = std::min(size, m_blockSize - block.used);
+            memcpy(block.data + block.used, buf, n);
+            block.used += n;
+            buf += n;
+            size -= n;
+            if (block.used == m_blockSize && !submit(m_blockSize))
+                return;
+        }
+    }
+
+    bool RecordingWriter::submit(size_t length)
+    {
+        Block &block = m_blocks[m_current];
+        preallocate(m_appendOffset + (int64_t)length);
+        block.offset = m_appendOffset;
+        block.length = length;
+        bool ok = true;
+
+#ifdef PIXELBRIDGE_HAVE_LIBURING
+        if (m_ring)
+        {
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&m_ring->ring);
+            if (!sqe)
+            {
+                drain();
+                sqe = io_uring_get_sqe(&m_ring->ring);
+            }
+            if (sqe)
+            {
+                io_uring_prep_write(sqe, m_fd, block.data, (unsigned)length, (uint64_t)block.offset);
+                io_uring_sqe_set_data(sqe, &block);
+                if (io_uring_submit(&m_ring->ring) >= 0)
+                {
+                    block.inFlight = true;
+                    m_inFlight++;
+                }
+                else
+                {
+                    ok = writeSync(m_fd, block.data, length, block.offset);
+                }
+            }
+            else
+            {
+                ok = writeSync(m_fd, block.data, length, block.offset);
+            }
+        }
+        else
+#endif
+        {
+            ok = writeSync(m_fd, block.data, length, block.offset);
+        }
+
+        m_appendOffset += (int64_t)length;
+        block.used = 0;
+        m_current = (m_current + 1) % m_blocks.size();
+        // 所有块都在途时等最早的一个完成，封装线程才会被磁盘反压
+        while (m_blocks[m_current].inFlight)
+        {
+            if (!reapOne())
+                break;
+        }
+        return ok && !m_failed;
+    }
+
+    bool RecordingWriter::reapOne()
+    {
+#ifdef PIXELBRIDGE_HAVE_LIBURING
+        if (!m_ring || m_inFlight == 0)
+            return false;
+        struct io_uring_cqe *cqe = nullptr;
+        int ret = io_uring_wait_cqe(&m_ring->ring, &cqe);
+        if (ret < 0)
+        {
+            spdlog::error("[RecordingWriter] io_uring_wait_cqe failed for {}: {}", m_path, strerror(-ret));
+            m_failed = true;
+            return false;
+        }
+        auto *block = static_cast<Block *>(io_uring_cqe_get_data(cqe));
+        int res = cqe->res;
+        io_uring_cqe_seen(&m_ring->ring, cqe);
+        m_inFlight--;
+        block->inFlight = false;
+
+        if (res < 0)
+        {
+            spdlog::error("[RecordingWriter] Write to {} failed: {}", m_path, strerror(-res));
+            m_failed = true;
+        }
+        else if ((size_t)res < block->length)
+        {
+            // 短写的剩余部分不一定满足 O_DIRECT 对齐，用普通缓冲写补齐
+            writeSync(bufferedFd(), block->data + res, block->length - res, block->offset + res);
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool RecordingWriter::drain()
+    {
+        while (m_inFlight > 0)
+        {
+            if (!reapOne())
+                return false;
+        }
+        return !m_failed;
+    }
+
+    bool RecordingWriter::writeSync(int fd, const uint8_t *data, size_t length, int64_t offset)
+    {
+#ifndef _WIN32
+        while (length > 0)
+        {
+            ssize_t n = pwrite(fd, data, length, (off_t)offset);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                spdlog::error("[RecordingWriter] Write to {} failed: {}", m_path, strerror(errno));
+                m_failed = true;
+                return false;
+            }
+            data += n;
+            length -= (size_t)n;
+            offset += n;
+        }
+        return true;
+#else
+        (void)fd;
+        (void)data;
+        (void)length;
+        (void)offset;
+        return false;
+#endif
+    }
+
+    void RecordingWriter::preallocate(int64_t end)
+    {
+#if defined(__linux__)
+        while (m_preallocChunk > 0 && end > m_allocated)
+        {
+            // KEEP_SIZE 只分配块不改变文件长度，录制中的文件仍可被其他进程边写边读
+            if (fallocate(m_fd, FALLOC_FL_KEEP_SIZE, m_allocated, m_preallocChunk) != 0)
+            {
+                spdlog::warn("[RecordingWriter] fallocate not supported for {}: {}", m_path, strerror(errno));
+                m_preallocChunk = 0;
+                return;
+            }
+            m_allocated += m_preallocChunk;
+        }
+#else
+        (void)end;
+#endif
+    }
+
+    void RecordingWriter::enterRandomMode()
+    {
+        drain();
+        Block &block = m_blocks[m_current];
+        if (block.used > 0)
+        {
+            writeSync(bufferedFd(), block.data, block.used, m_appendOffset);
+            m_appendOffset += (int64_t)block.used;
+            block.used = 0;
+        }
+        m_sequential = false;
+    }
+
+    int RecordingWriter::bufferedFd()
+    {
+#ifndef _WIN32
+        if (!m_direct)
+            return m_fd;
+        if (m_bufferedFd < 0)
+            m_bufferedFd = ::open(m_path.c_str(), O_WRONLY | O_CLOEXEC);
+        return m_bufferedFd;
+#else
+        return -1;
+#endif
+    }
+
+    bool RecordingWriter::close()
+    {
+        if (m_closed)
+            return !m_failed;
+        m_closed = true;
+        if (m_avio)
+            avio_flush(m_avio);
+
+        if (m_sequential)
+        {
+            Block &block = m_blocks[m_current];
+            if (block.used > 0)
+            {
+                // O_DIRECT 的最后一块补零到对齐长度，随后截断回实际长度
+                size_t length = m_direct ? alignUp(block.used) : block.used;
+                memset(block.data + block.used, 0, length - block.used);
+                submit(length);
+            }
+        }
+        drain();
+
+#ifndef _WIN32
+        if (m_fd >= 0)
+        {
+            // 同时去掉 O_DIRECT 的补齐部分和多余的预分配
+            if (ftruncate(m_fd, (off_t)m_size) != 0)
+                spdlog::warn("[RecordingWriter] ftruncate failed for {}: {}", m_path, strerror(errno));
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        if (m_bufferedFd >= 0)
+        {
+            ::close(m_bufferedFd);
+            m_bufferedFd = -1;
+        }
+#endif
+        spdlog::info("[RecordingWriter] Closed {} ({} MB{})", m_path, m_size / (1024 * 1024), m_failed ? ", with write errors" : "");
+        return !m_failed;
+    }
+
+} // namespace pb
@@ -0,0 +1,155 @@
+#include "core/StreamInfoCache.h"
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+
+namespace pb
+{
+
+    StreamInfoCache::StreamInfoCache()
+    {
+        QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        QDir().mkpath(dir);
+        m_path = (dir + "/stream_info.json").toStdString();
+        load();
+    }
+
+    std::string StreamInfoCache::key(const std::string &url)
+    {
+        // URL 中可能带有用户名密码，只保存哈希
+        QByteArray hash = QCryptographicHash::hash(QByteArray::fromStdString(url), QCryptographicHash::Sha1);
+        return hash.toHex().toStdString();
+    }
+
+    void StreamInfoCache::load()
+    {
+        QFile file(QString::fromStdString(m_path));
+        if (!file.open(QIODevice::ReadOnly))
+            return;
+
+        QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+        for (auto it = root.begin(); it != root.end(); ++it)
+        {
+            QJsonObject obj = it.value().toObject();
+            const AVCodecDescriptor *desc = avcodec_descriptor_get_by_name(obj["codec"].toString().toUtf8().constData());
+            if (!desc)
+                continue;
+
+            StreamInfo info;
+            info.codecId = desc->id;
+            info.width = obj["width"].toInt();
+            info.height = obj["height"].toInt();
+            info.pixFmt = obj["pixFmt"].toInt(-1);
+            info.profile = obj["profile"].toInt(-1);
+            info.level = obj["level"].toInt(-1);
+            info.frameRate = {obj["frameRateNum"].toInt(), std::max(1, obj["frameRateDen"].toInt(1))};
+            QByteArray extradata = QByteArray::fromBase64(obj["extradata"].toString().toLatin1());
+            info.extradata.assign(extradata.begin(), extradata.end());
+            m_table[it.key().toStdString()] = info;
+        }
+        spdlog::info("[StreamInfoCache] Loaded {} entries from {}", m_table.size(), m_path);
+    }
+
+    void StreamInfoCache::save()
+    {
+        QJsonObject root;
+        for (const auto &[k, info] : m_table)
+        {
+            QJsonObject obj;
+            obj["codec"] = QString::fromUtf8(avcodec_get_name(info.codecId));
+            obj["width"] = info.width;
+            obj["height"] = info.height;
+            obj["pixFmt"] = info.pixFmt;
+            obj["profile"] = info.profile;
+            obj["level"] = info.level;
+            obj["frameRateNum"] = info.frameRate.num;
+            obj["frameRateDen"] = info.frameRate.den;
+            obj["extradata"] = QString::fromLatin1(
+                QByteArray(reinterpret_cast<const char *>(info.extradata.data()), (qsizetype)info.extradata.size()).toBase64());
+            root[QString::fromStdString(k)] = obj;
+        }
+
+        QFile file(QString::fromStdString(m_path));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            spdlog::error("[StreamInfoCache] Could not write {}", m_path);
+            return;
+        }
+        file.write(QJsonDocument(root).toJson());
+    }
+
+    bool StreamInfoCache::lookup(const std::string &url, StreamInfo &out)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_table.find(key(url));
+        if (it == m_table.end())
+            return false;
+        out = it->second;
+        return true;
+    }
+
+    void StreamInfoCache::store(const std::string &url, const StreamInfo &info)
+    {
+        if (info.codecId == AV_CODEC_ID_NONE || info.width <= 0 || info.height <= 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_table[key(url)] = info;
+        save();
+    }
+
+    void StreamInfoCache::invalidate(const std::string &url)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_table.erase(key(url)) > 0)
+            save();
+    }
+
+    StreamInfo StreamInfoCache::fromParameters(const AVCodecParameters *par, AVRational frameRate)
+    {
+        StreamInfo info;
+        info.codecId = par->codec_id;
+        info.width = par->width;
+        info.height = par->height;
+        info.pixFmt = par->format;
+        info.profile = par->profile;
+        info.level = par->level;
+        info.frameRate = frameRate;
+        if (par->extradata && par->extradata_size > 0)
+            info.extradata.assign(par->extradata, par->extradata + par->extradata_size);
+        return info;
+    }
+
+    void StreamInfoCache::applyTo(const StreamInfo &info, AVCodecParameters *par)
+    {
+        if (par->width <= 0 || par->height <= 0)
+        {
+            par->width = info.width;
+            par->height = info.height;
+        }
+        if (par->format < 0)
+            par->format = info.pixFmt;
+        if (par->profile < 0 && info.profile >= 0)
+            par->profile = info.profile;
+        if (par->level < 0 && info.level >= 0)
+            par->level = info.level;
+
+        if ((!par->extradata || par->extradata_size == 0) && !info.extradata.empty())
+        {
+            par->extradata = (uint8_t *)av_mallocz(info.extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (par->extradata)
+            {
+                memcpy(par->extradata, info.extradata.data(), info.extradata.size());
+                par->extradata_size = (int)info.extradata.size();
+            }
+        }
+    }
+
+} // namespace pb
@@ -0,0 +1,383 @@
+#include "core/UdpPacer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <spdlog/spdlog.h>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavutil/mem.h>
+#include <libavutil/parseutils.h>
+}
+
+namespace pb
+{
+    struct UdpTarget
+    {
+        int fd = -1;
+#ifndef _WIN32
+        sockaddr_storage addr{};
+        socklen_t addrLen = 0;
+#endif
+
+        ~UdpTarget()
+        {
+#ifndef _WIN32
+            if (fd >= 0)
+                ::close(fd);
+#endif
+        }
+    };
+
+    namespace
+    {
+        // 单次 sendmmsg 最多发送的数据报数
+        constexpr size_t kMaxBatch = 32;
+        // 令牌桶深度：空闲后最多允许约 1ms 的突发，且不少于 4 个数据报
+        constexpr double kBurstWindow = 0.001;
+        constexpr double kMinBurstBytes = 4 * 1472;
+        // 队列上限，发送端长时间受阻时丢弃新数据报而不是无限堆积
+        constexpr size_t kMaxBacklogBytes = 8 * 1024 * 1024;
+        constexpr int kDefaultTtl = 16;
+        // close() 时队列里剩余数据报的最长发送时间，超时的直接丢弃
+        constexpr std::chrono::milliseconds kDrainTimeout(200);
+
+#ifndef _WIN32
+        std::unique_ptr<UdpTarget> openTarget(const char *host, int port, const char *localAddr, int localPort, int ttl)
+        {
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_DGRAM;
+            addrinfo *res = nullptr;
+            std::string service = std::to_string(port);
+            int ret = getaddrinfo(host, service.c_str(), &hints, &res);
+            if (ret != 0 || !res)
+            {
+                spdlog::error("[UdpPacer] Could not resolve {}:{}: {}", host, port, gai_strerror(ret));
+                return nullptr;
+            }
+
+            auto target = std::make_unique<UdpTarget>();
+            target->fd = socket(res->ai_family, SOCK_DGRAM, 0);
+            memcpy(&target->addr, res->ai_addr, res->ai_addrlen);
+            target->addrLen = res->ai_addrlen;
+            int family = res->ai_family;
+            freeaddrinfo(res);
+            if (target->fd < 0)
+            {
+                spdlog::error("[UdpPacer] socket() failed: {}", strerror(errno));
+                return nullptr;
+            }
+
+            if (localAddr[0] || localPort > 0)
+            {
+                addrinfo localHints{};
+                localHints.ai_family = family;
+                localHints.ai_socktype = SOCK_DGRAM;
+                localHints.ai_flags = AI_PASSIVE;
+                addrinfo *local = nullptr;
+                std::string localService = std::to_string(std::max(localPort, 0));
+                if (getaddrinfo(localAddr[0] ? localAddr : nullptr, localService.c_str(), &localHints, &local) == 0 && local)
+                {
+                    int reuse = 1;
+                    setsockopt(target->fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+                    if (bind(target->fd, local->ai_addr, local->ai_addrlen) != 0)
+                        spdlog::warn("[UdpPacer] bind to {}:{} failed: {}", localAddr, localPort, strerror(errno));
+                    freeaddrinfo(local);
+                }
+            }
+
+            // 组播目的地址需要设置 TTL / 跳数，指定了本地地址时也从该接口发出
+            if (family == AF_INET)
+            {
+                auto *sin = reinterpret_cast<sockaddr_in *>(&target->addr);
+                if (IN_MULTICAST(ntohl(sin->sin_addr.s_addr)))
+                {
+                    unsigned char mttl = (unsigned char)ttl;
+                    setsockopt(target->fd, IPPROTO_IP, IP_MULTICAST_TTL, &mttl, sizeof(mttl));
+                    in_addr iface{};
+                    if (localAddr[0] && inet_pton(AF_INET, localAddr, &iface) == 1)
+                        setsockopt(target->fd, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface));
+                }
+            }
+            else if (family == AF_INET6)
+            {
+                auto *sin6 = reinterpret_cast<sockaddr_in6 *>(&target->addr);
+                if (IN6_IS_ADDR_MULTICAST(&sin6->sin6_addr))
+                    setsockopt(target->fd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &ttl, sizeof(ttl));
+            }
+
+            int sndbuf = 1024 * 1024;
+            setsockopt(target->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+            return target;
+        }
+#endif
+    } // namespace
+
+    std::unique_ptr<UdpPacer> UdpPacer::open(const std::string &url, const Options &options)
+    {
+#ifdef _WIN32
+        (void)url;
+        (void)options;
+        return nullptr;
+#else
+        char proto[16], host[256], path[1024], value[256];
+        int port = -1;
+        av_url_split(proto, sizeof(proto), nullptr, 0, host, sizeof(host), &port, path, sizeof(path), url.c_str());
+        bool rtp = strcmp(proto, "rtp") == 0;
+        if ((!rtp && strcmp(proto, "udp") != 0) || !host[0] || port <= 0)
+            return nullptr;
+
+        const char *query = strchr(path, '?');
+        std::string localAddr;
+        int localPort = -1;
+        int ttl = kDefaultTtl;
+        // 与 FFmpeg udp 协议默认一致：MPEG-TS 每个数据报 7 个 TS 包，RTP 按 1472 字节 MTU
+        int pktSize = rtp ? 1472 : 1316;
+        if (query)
+        {
+            if (av_find_info_tag(value, sizeof(value), "localaddr", query))
+                localAddr = value;
+            if (av_find_info_tag(value, sizeof(value), "localport", query))
+                localPort = atoi(value);
+            if (av_find_info_tag(value, sizeof(value), "ttl", query))
+                ttl = atoi(value);
+            if (av_find_info_tag(value, sizeof(value), "pkt_size", query))
+                pktSize = std::clamp(atoi(value), 188, 65507);
+        }
+
+        std::unique_ptr<UdpPacer> pacer(new UdpPacer());
+        pacer->m_url = url;
+        auto target = openTarget(host, port, localAddr.c_str(), localPort, ttl);
+        if (!target)
+            return nullptr;
+        pacer->m_target = target.release();
+        if (rtp)
+        {
+            // RTCP 使用相邻端口，与 FFmpeg rtp 协议的约定一致
+            auto rtcp = openTarget(host, port + 1, localAddr.c_str(), localPort > 0 ? localPort + 1 : -1, ttl);
+            if (rtcp)
+                pacer->m_rtcpTarget = rtcp.release();
+        }
+
+        // AVIO 缓冲大小即数据报大小：缓冲写满或封装器 flush 时回调一次，正好是一个数据报
+        auto *buffer = static_cast<unsigned char *>(av_malloc(pktSize));
+        if (!buffer)
+            return nullptr;
+        pacer->m_avio = avio_alloc_context(buffer, pktSize, 1, pacer.get(), nullptr, &UdpPacer::writePacket, nullptr);
+        if (!pacer->m_avio)
+        {
+            av_free(buffer);
+            return nullptr;
+        }
+        pacer->m_avio->max_packet_size = pktSize;
+
+        pacer->m_rateBps = options.rateBps;
+        pacer->m_frameInterval = options.frameInterval > 0.0 ? options.frameInterval : 1.0 / 30;
+        pacer->m_lastRefill = std::chrono::steady_clock::now();
+        pacer->m_thread = std::thread(&UdpPacer::senderLoop, pacer.get());
+
+        spdlog::info("[UdpPacer] Pacing {} at {} kbps, {} byte datagrams", url, options.rateBps / 1000, pktSize);
+        return pacer;
+#endif
+    }
+
+    UdpPacer::~UdpPacer()
+    {
+        close();
+        if (m_avio)
+        {
+            av_freep(&m_avio->buffer);
+            avio_context_free(&m_avio);
+        }
+        delete m_target;
+        delete m_rtcpTarget;
+    }
+
+    void UdpPacer::setRate(int64_t rateBps)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_rateBps = rateBps;
+    }
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+    int UdpPacer::writePacket(void *opaque, const uint8_t *buf, int bufSize)
+#else
+    int UdpPacer::writePacket(void *opaque, uint8_t *buf, int bufSize)
+#endif
+    {
+        auto *self = static_cast<UdpPacer *>(opaque);
+#ifndef _WIN32
+        // RTCP (PT 200~204) 体积很小，直接发往 RTCP 端口
+        if (self->m_rtcpTarget && bufSize >= 2 && buf[1] >= 200 && buf[1] <= 204)
+        {
+            sendto(self->m_rtcpTarget->fd, buf, bufSize, 0,
+                   reinterpret_cast<const sockaddr *>(&self->m_rtcpTarget->addr), self->m_rtcpTarget->addrLen);
+            return bufSize;
+        }
+#endif
+        {
+            std::lock_guard<std::mutex> lock(self->m_mutex);
+            if (self->m_queuedBytes + bufSize > kMaxBacklogBytes)
+            {
+                self->m_dropped++;
+                return bufSize;
+            }
+            self->m_queue.emplace_back(buf, buf + bufSize);
+            self->m_queuedBytes += bufSize;
+            // 新到的突发 (如关键帧) 要在一个帧间隔内发完
+            self->m_drainDeadline = std::chrono::steady_clock::now() +
+                                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(self->m_frameInterval));
+        }
+        self->m_cv.notify_one();
+        return bufSize;
+    }
+
+    void UdpPacer::senderLoop()
+    {
+        std::vector<std::vector<uint8_t>> batch;
+        batch.reserve(kMaxBatch);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_cv.wait(lock, [this]
+                      { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty())
+                break;
+
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - m_lastRefill).count();
+            m_lastRefill = now;
+
+            if (m_stopping && now > m_stopDeadline)
+            {
+                m_dropped += m_queue.size();
+                m_queue.clear();
+                m_queuedBytes = 0;
+                break;
+            }
+
+            // 每次补充令牌时按当前积压与剩余时间重新计算，积压发完后自然回落到配置速率
+            double remaining = std::max(std::chrono::duration<double>(m_drainDeadline - now).count(), 1e-3);
+            double drainRate = m_queuedBytes / remaining;
+
+            // 停止时与未配置速率时不限速，只保留批量发送
+            bool unlimited = m_stopping || m_rateBps <= 0;
+            double rate = std::max(m_rateBps / 8.0, drainRate);
+            if (!unlimited)
+                m_tokens = std::min(m_tokens + rate * elapsed, std::max(kMinBurstBytes, rate * kBurstWindow));
+
+            while (!m_queue.empty() && batch.size() < kMaxBatch && (unlimited || m_tokens > 0.0))
+            {
+                size_t size = m_queue.front().size();
+                if (!unlimited)
+                    m_tokens -= (double)size;
+                m_queuedBytes -= size;
+                batch.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+
+            if (batch.empty())
+            {
+                // 令牌不足：睡到补足透支部分为止，期间有新包或停止请求也会被唤醒
+                auto wait = std::chrono::duration<double>((1.0 - m_tokens) / rate);
+                m_cv.wait_until(lock, now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(wait));
+                continue;
+            }
+
+            lock.unlock();
+            sendBatch(batch);
+            batch.clear();
+            lock.lock();
+        }
+    }
+
+    void UdpPacer::sendBatch(std::vector<std::vector<uint8_t>> &batch)
+    {
+#ifndef _WIN32
+        size_t sent = 0;
+#if defined(__linux__)
+        mmsghdr msgs[kMaxBatch];
+        iovec iov[kMaxBatch];
+        memset(msgs, 0, sizeof(msgs));
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            iov[i].iov_base = batch[i].data();
+            iov[i].iov_len = batch[i].size();
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &m_target->addr;
+            msgs[i].msg_hdr.msg_namelen = m_target->addrLen;
+        }
+        m_batches++;
+        while (sent < batch.size())
+        {
+            int n = sendmmsg(m_target->fd, msgs + sent, (unsigned)(batch.size() - sent), 0);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            sent += (size_t)n;
+        }
+#else
+        m_batches++;
+        for (; sent < batch.size(); sent++)
+        {
+            if (sendto(m_target->fd, batch[sent].data(), batch[sent].size(), 0,
+                       reinterpret_cast<const sockaddr *>(&m_target->addr), m_target->addrLen) < 0)
+                break;
+        }
+#endif
+        m_datagrams += sent;
+        if (sent < batch.size())
+        {
+            // 失败的数据报直接丢弃：重发会让后续包整体迟到，对实时流得不偿失
+            m_dropped += batch.size() - sent;
+            if (m_sendErrors++ % 100 == 0)
+                spdlog::warn("[UdpPacer] Send to {} failed: {}", m_url, strerror(errno));
+        }
+#else
+        (void)batch;
+#endif
+    }
+
+    void UdpPacer::close()
+    {
+        if (m_avio)
+            avio_flush(m_avio);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            m_stopDeadline = std::chrono::steady_clock::now() + kDrainTimeout;
+        }
+        m_cv.notify_all();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    UdpPacer::Stats UdpPacer::stats() const
+    {
+        Stats s;
+        s.datagrams = m_datagrams;
+        s.batches = m_batches;
+        s.dropped = m_dropped;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        s.backlogBytes = m_queuedBytes;
+        return s;
+    }
+
+} // namespace pb
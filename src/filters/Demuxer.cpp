@@ -1,10 +1,30 @@
 #include "filters/Demuxer.h"
+#include "core/MappedFileIO.h"
+#include "core/PreciseClock.h"
+#include "core/StreamInfoCache.h"
 #include <iostream>
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <spdlog/spdlog.h>
 
 namespace pb
 {
+    namespace
+    {
+        // 打开 + 探测、以及单次读包的最长阻塞时间
+        constexpr std::chrono::milliseconds kOpenTimeout{10000};
+        constexpr std::chrono::milliseconds kReadTimeout{5000};
+        // 校验流参数缓存时最多预读的包数，超过仍没有关键帧就信任缓存
+        constexpr int kMaxPrefetchPackets = 500;
+        // 重连退避：从 500ms 开始翻倍，最长 30s
+        constexpr std::chrono::milliseconds kReconnectMinDelay{500};
+        constexpr std::chrono::milliseconds kReconnectMaxDelay{30000};
+        // 实时节拍时单次睡眠的最长时间
+        constexpr std::chrono::milliseconds kPacingSlice{50};
+        // 循环缓存按 4MB 分块分配
+        constexpr size_t kLoopChunkSize = 4 * 1024 * 1024;
+    }
 
     Demuxer::Demuxer(const std::string &url) : Filter("Demuxer"), m_url(url) {}
 
@@ -13,6 +33,14 @@ namespace pb
         spdlog::info("[Demuxer] Destructor started");
         spdlog::default_logger()->flush();
         stop();
+        if (m_videoParams)
+        {
+            avcodec_parameters_free(&m_videoParams);
+        }
+        if (m_audioParams)
+        {
+            avcodec_parameters_free(&m_audioParams);
+        }
         if (m_formatCtx)
         {
             spdlog::info("[Demuxer] Closing format context...");
@@ -21,11 +49,70 @@ namespace pb
             spdlog::info("[Demuxer] Format context closed.");
             spdlog::default_logger()->flush();
         }
+        clearLoopCache();
+        // 自定义 IO 不由 avformat_close_input 释放，须在格式上下文关闭之后释放
+        m_mappedIO.reset();
         spdlog::info("[Demuxer] Destructor finished");
         spdlog::default_logger()->flush();
     }
 
     bool Demuxer::initialize()
+    {
+        m_startTime = std::chrono::steady_clock::now();
+        if (!openValidatedInput())
+            return false;
+
+        // 保存一份独立的参数副本：重连时 m_formatCtx 会被重建，下游仍持有这里的指针
+        m_videoParams = avcodec_parameters_alloc();
+        avcodec_parameters_copy(m_videoParams, m_formatCtx->streams[m_videoStreamIndex]->codecpar);
+        AVStream *stream = m_formatCtx->streams[m_videoStreamIndex];
+        m_timeBase = stream->time_base;
+        AVRational fr = stream->avg_frame_rate.num > 0 ? stream->avg_frame_rate : stream->r_frame_rate;
+        if (fr.num <= 0 || fr.den <= 0)
+            fr = {25, 1};
+        m_frameDuration = std::max<int64_t>(1, av_rescale_q(1, av_inv_q(fr), m_timeBase));
+
+        if (m_audioStreamIndex >= 0)
+        {
+            AVStream *audio = m_formatCtx->streams[m_audioStreamIndex];
+            if (audio->codecpar->codec_id == AV_CODEC_ID_NONE || audio->codecpar->sample_rate <= 0)
+            {
+                // 探测不完整 (例如流参数缓存命中时探测时间很短) 的音频无法写入容器头，按无音频处理
+                spdlog::warn("[Demuxer] Audio stream of {} is not fully probed, ignoring it", m_url);
+                m_audioStreamIndex = -1;
+            }
+            else
+            {
+                m_audioParams = avcodec_parameters_alloc();
+                avcodec_parameters_copy(m_audioParams, audio->codecpar);
+                m_audioTimeBase = audio->time_base;
+                spdlog::info("[Demuxer] Audio stream: {} {} Hz, {} channels", avcodec_get_name(m_audioParams->codec_id),
+                             m_audioParams->sample_rate, m_audioParams->ch_layout.nb_channels);
+            }
+        }
+
+        spdlog::info("Demuxer initialized for URL: {}", m_url);
+        if (m_formatCtx->iformat)
+        {
+            spdlog::info("Input format: {}", m_formatCtx->iformat->long_name);
+        }
+        return true;
+    }
+
+    bool Demuxer::openValidatedInput()
+    {
+        if (!openInput())
+            return false;
+        if (!m_timings.cacheHit || prefetchAndValidate())
+            return true;
+
+        // 缓存已过期 (例如源改了分辨率)：放弃这次打开，缓存作废后完整探测一次，下游按正确的参数初始化
+        m_prefetched.clear();
+        avformat_close_input(&m_formatCtx);
+        return openInput();
+    }
+
+    bool Demuxer::openInput()
     {
         AVDictionary *options = nullptr;
 
@@ -65,10 +152,53 @@ namespace pb
             // 使用 UDP 传输以获得最小延迟
             av_dict_set(&options, "rtsp_transport", "udp", 0);
             av_dict_set(&options, "stimeout", "5000000", 0);
+            // RTP 包序号级别的重排：nobuffer 下 FFmpeg 默认不等待乱序包，按延迟等级给出队列长度与最长等待
+            if (m_latencyLevel == LatencyLevel::UltraLow)
+            {
+                av_dict_set(&options, "reorder_queue_size", "32", 0);
+                av_dict_set(&options, "max_delay", "30000", 0);
+            }
+            else if (m_latencyLevel == LatencyLevel::Low)
+            {
+                av_dict_set(&options, "reorder_queue_size", "128", 0);
+                av_dict_set(&options, "max_delay", "100000", 0);
+            }
+            else
+            {
+                av_dict_set(&options, "reorder_queue_size", "500", 0);
+                av_dict_set(&options, "max_delay", "500000", 0);
+            }
         }
 
+        // 预先分配上下文以便在打开阶段就安装中断回调
+        m_formatCtx = avformat_alloc_context();
+        if (!m_formatCtx)
+        {
+            if (options)
+                av_dict_free(&options);
+            return false;
+        }
+        m_formatCtx->interrupt_callback.callback = interrupt_callback;
+        m_formatCtx->interrupt_callback.opaque = this;
+
+        // 本地文件走 mmap，多个管线打开同一文件时共享映射；失败时回退到 FFmpeg 的 file 协议
+        if (m_useMmap && !isNetworkInput())
+        {
+            if (!m_mappedIO)
+                m_mappedIO = MappedFileIO::open(m_url);
+            if (m_mappedIO)
+            {
+                avio_seek(m_mappedIO->context(), 0, SEEK_SET);
+                m_formatCtx->pb = m_mappedIO->context();
+                m_formatCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+            }
+        }
+
+        auto openStart = std::chrono::steady_clock::now();
+        armDeadline(kOpenTimeout);
         if (avformat_open_input(&m_formatCtx, m_url.c_str(), nullptr, &options) != 0)
         {
+            // 失败时 avformat_open_input 会释放上下文并置空指针
             spdlog::error("Could not open input: {}", m_url);
             if (options)
                 av_dict_free(&options);
@@ -78,12 +208,19 @@ namespace pb
         if (options)
             av_dict_free(&options);
 
+        auto probeStart = std::chrono::steady_clock::now();
+        m_timings.openMs = std::chrono::duration<double, std::milli>(probeStart - openStart).count();
+        m_timings.cacheHit = m_useStreamCache && isNetworkInput() && applyCachedStreamInfo();
+
         if (avformat_find_stream_info(m_formatCtx, nullptr) < 0)
         {
             spdlog::error("Could not find stream information");
             return false;
         }
+        armDeadline(std::chrono::milliseconds(0));
+        m_timings.probeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - probeStart).count();
 
+        m_videoStreamIndex = -1;
         for (unsigned int i = 0; i < m_formatCtx->nb_streams; i++)
         {
             if (m_formatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
@@ -98,11 +235,108 @@ namespace pb
             spdlog::error("Could not find video stream");
             return false;
         }
+        m_audioStreamIndex = av_find_best_stream(m_formatCtx, AVMEDIA_TYPE_AUDIO, -1, m_videoStreamIndex, nullptr, 0);
+        if (m_audioStreamIndex < 0)
+            m_audioStreamIndex = -1;
 
-        spdlog::info("Demuxer initialized for URL: {}", m_url);
-        if (m_formatCtx->iformat)
+        AVStream *stream = m_formatCtx->streams[m_videoStreamIndex];
+        if (!m_timings.cacheHit && m_useStreamCache && isNetworkInput())
         {
-            spdlog::info("Input format: {}", m_formatCtx->iformat->long_name);
+            StreamInfoCache::instance().store(m_url, StreamInfoCache::fromParameters(stream->codecpar, stream->avg_frame_rate));
+        }
+
+        spdlog::info("[Demuxer] Startup for {}: open {:.0f} ms, probe {:.0f} ms (stream info cache {})",
+                     m_url, m_timings.openMs, m_timings.probeMs, m_timings.cacheHit ? "hit" : "miss");
+        return true;
+    }
+
+    bool Demuxer::applyCachedStreamInfo()
+    {
+        StreamInfo cached;
+        if (!StreamInfoCache::instance().lookup(m_url, cached))
+            return false;
+
+        // 只有 SDP / 容器头里已经声明了相同编码格式时才信任缓存
+        bool applied = false;
+        for (unsigned int i = 0; i < m_formatCtx->nb_streams; i++)
+        {
+            AVStream *stream = m_formatCtx->streams[i];
+            if (stream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO)
+                continue;
+            if (stream->codecpar->codec_id != cached.codecId)
+            {
+                spdlog::warn("[Demuxer] Cached stream info for {} no longer matches ({} vs {}), probing fully",
+                             m_url, avcodec_get_name(stream->codecpar->codec_id), avcodec_get_name(cached.codecId));
+                StreamInfoCache::instance().invalidate(m_url);
+                return false;
+            }
+            StreamInfoCache::applyTo(cached, stream->codecpar);
+            if (stream->avg_frame_rate.num <= 0 && cached.frameRate.num > 0)
+                stream->avg_frame_rate = cached.frameRate;
+            applied = true;
+            break;
+        }
+        if (!applied)
+            return false;
+
+        // 参数已齐全，find_stream_info 只需读到少量数据即可返回
+        m_formatCtx->probesize = 32 * 1024;
+        m_formatCtx->max_analyze_duration = 100000;
+        m_formatCtx->fps_probe_size = 0;
+        return true;
+    }
+
+    bool Demuxer::prefetchAndValidate()
+    {
+        for (int i = 0; i < kMaxPrefetchPackets && !m_aborting; i++)
+        {
+            auto pktWrapper = std::make_shared<AVPacketWrapper>();
+            armDeadline(kReadTimeout);
+            int ret = av_read_frame(m_formatCtx, pktWrapper->get());
+            armDeadline(std::chrono::milliseconds(0));
+            // 读失败交给 run() 的重连逻辑处理
+            if (ret < 0)
+                return true;
+            m_prefetched.push_back(pktWrapper);
+            AVPacket *pkt = pktWrapper->get();
+            if (pkt->stream_index == m_videoStreamIndex && (pkt->flags & AV_PKT_FLAG_KEY))
+                return validateCachedStreamInfo(pkt);
+        }
+        return true;
+    }
+
+    bool Demuxer::validateCachedStreamInfo(const AVPacket *pkt)
+    {
+        const AVCodecParameters *params = m_formatCtx->streams[m_videoStreamIndex]->codecpar;
+        AVCodecParserContext *parser = av_parser_init(params->codec_id);
+        AVCodecContext *ctx = avcodec_alloc_context3(nullptr);
+        if (!parser || !ctx || avcodec_parameters_to_context(ctx, params) < 0)
+        {
+            if (parser)
+                av_parser_close(parser);
+            avcodec_free_context(&ctx);
+            return true;
+        }
+
+        uint8_t *out = nullptr;
+        int outSize = 0;
+        av_parser_parse2(parser, ctx, &out, &outSize, pkt->data, pkt->size, pkt->pts, pkt->dts, pkt->pos);
+        av_parser_parse2(parser, ctx, &out, &outSize, nullptr, 0, AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
+        int width = parser->width;
+        int height = parser->height;
+        av_parser_close(parser);
+        avcodec_free_context(&ctx);
+
+        // 关键帧不带带内参数集时无法比对，保留缓存
+        if (width <= 0 || height <= 0)
+            return true;
+
+        if (width != params->width || height != params->height)
+        {
+            spdlog::warn("[Demuxer] Stream info cache for {} is stale ({}x{} cached, {}x{} in stream), reprobing",
+                         m_url, params->width, params->height, width, height);
+            StreamInfoCache::instance().invalidate(m_url);
+            return false;
         }
         return true;
     }
@@ -114,28 +348,125 @@ namespace pb
 
     void Demuxer::start()
     {
+        if (m_audioSink && m_loopCaching)
+        {
+            // 循环缓存只保存视频包，需要音频时改为 seek 回文件头重放
+            m_loopCaching = false;
+        }
         m_running = true;
         m_thread = std::thread(&Demuxer::run, this);
     }
 
     AVCodecParameters *Demuxer::getVideoCodecParameters() const
     {
-        if (m_videoStreamIndex == -1)
-            return nullptr;
-        return m_formatCtx->streams[m_videoStreamIndex]->codecpar;
+        return m_videoParams;
     }
 
-    void Demuxer::stop()
+    AVRational Demuxer::getVideoTimeBase() const
     {
-        spdlog::info("[Demuxer] stop() called for {}", m_url);
+        return m_timeBase;
+    }
+
+    AVCodecParameters *Demuxer::getAudioCodecParameters() const
+    {
+        return m_audioParams;
+    }
+
+    AVRational Demuxer::getAudioTimeBase() const
+    {
+        return m_audioTimeBase;
+    }
+
+    void Demuxer::setAudioSink(Filter *sink)
+    {
+        m_audioSink = sink;
+    }
+
+    void Demuxer::setLoop(bool enabled, size_t maxCacheBytes)
+    {
+        m_loop = enabled;
+        m_loopCaching = enabled && maxCacheBytes > 0;
+        m_loopMaxBytes = maxCacheBytes;
+    }
+
+    void Demuxer::setPacingMode(PacingMode mode)
+    {
+        m_pacingMode = mode;
+    }
+
+    void Demuxer::seek(double seconds)
+    {
+        m_seekRequest = std::max(0.0, seconds);
+    }
+
+    void Demuxer::setReconnect(bool enabled, int maxAttempts)
+    {
+        m_reconnect = enabled;
+        m_maxReconnectAttempts = maxAttempts;
+    }
+
+    bool Demuxer::isNetworkInput() const
+    {
+        static const char *schemes[] = {"rtsp://", "rtsps://", "rtmp://", "udp://", "rtp://", "srt://", "http://", "https://", "tcp://"};
+        for (const char *scheme : schemes)
+        {
+            if (m_url.find(scheme) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool Demuxer::isLiveInput() const
+    {
+        static const char *schemes[] = {"rtsp://", "rtsps://", "udp://", "rtp://", "srt://"};
+        for (const char *scheme : schemes)
+        {
+            if (m_url.find(scheme) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    int Demuxer::interrupt_callback(void *opaque)
+    {
+        auto *self = static_cast<Demuxer *>(opaque);
+        if (self->m_aborting)
+            return 1;
+        int64_t deadline = self->m_deadline;
+        if (deadline != 0 && std::chrono::steady_clock::now().time_since_epoch().count() > deadline)
+        {
+            spdlog::warn("[Demuxer] I/O deadline exceeded for {}", self->m_url);
+            return 1;
+        }
+        return 0;
+    }
+
+    void Demuxer::armDeadline(std::chrono::milliseconds timeout)
+    {
+        if (timeout.count() == 0)
+        {
+            m_deadline = 0;
+            return;
+        }
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        m_deadline = std::chrono::duration_cast<std::chrono::steady_clock::duration>(deadline.time_since_epoch()).count();
+    }
+
+    void Demuxer::requestStop()
+    {
+        // 通过中断回调打断 open / find_stream_info / av_read_frame 中的阻塞
+        m_aborting = true;
         m_running = false;
-        // Break FFmpeg blocking call
-        if (m_formatCtx)
         {
-            // Note: avformat_close_input will handle it, but for real-time streams
-            // we occasionally need a callback or interrupt.
-            // Simplified: we rely on m_running check after av_read_frame.
+            std::lock_guard<std::mutex> lock(m_waitMutex);
         }
+        m_waitCv.notify_all();
+    }
+
+    void Demuxer::stop()
+    {
+        spdlog::info("[Demuxer] stop() called for {}", m_url);
+        requestStop();
 
         if (m_thread.joinable())
         {
@@ -147,73 +478,430 @@ namespace pb
 
     void Demuxer::run()
     {
-        auto startTime = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point startTime;
         int64_t firstTimestamp = AV_NOPTS_VALUE;
-        AVRational timeBase = {1, 1000};
-        if (m_videoStreamIndex >= 0 && m_videoStreamIndex < (int)m_formatCtx->nb_streams)
-        {
-            timeBase = m_formatCtx->streams[m_videoStreamIndex]->time_base;
-        }
 
-        // Determine if we should pace.
-        // Generally, if it's a network stream, we don't pace because it's already real-time.
-        // If it's a local file, we must pace.
-        bool shouldPace = true;
-        if (m_url.find("rtsp://") == 0 || m_url.find("udp://") == 0 || m_url.find("rtp://") == 0)
-        {
-            shouldPace = false;
-        }
+        // Auto: 文件和 http / rtmp 点播按时间戳实时回放，否则会以网络允许的最快速度读完；
+        // 直播协议本身就是实时到达的，不需要节拍
+        bool shouldPace = m_pacingMode == PacingMode::Realtime ||
+                          (m_pacingMode == PacingMode::Auto && !isLiveInput());
 
         while (m_running)
         {
+            double seekTarget = m_seekRequest.exchange(-1.0);
+            if (seekTarget >= 0.0)
+            {
+                seekTo(seekTarget);
+            }
+
             auto pktWrapper = std::make_shared<AVPacketWrapper>();
-            if (av_read_frame(m_formatCtx, pktWrapper->get()) >= 0)
+            int ret = readNext(pktWrapper->get());
+            if (ret < 0)
             {
-                if (pktWrapper->get()->stream_index == m_videoStreamIndex)
+                // 循环模式下文件 EOF 后从头重放 (优先使用内存缓存)
+                if (m_running && m_loop && !isNetworkInput() && rewind())
                 {
-                    if (shouldPace)
-                    {
-                        int64_t ts = pktWrapper->get()->dts;
-                        if (ts == AV_NOPTS_VALUE)
-                            ts = pktWrapper->get()->pts;
+                    continue;
+                }
+                // 网络输入断开时重连，下游链路保持不动；点播的正常 EOF 是播放结束，只有直播流的 EOF 视为断流
+                bool lost = isNetworkInput() && (ret != AVERROR_EOF || isLiveInput());
+                if (m_running && m_reconnect && lost && reconnect())
+                {
+                    continue;
+                }
+                m_running = false;
+                break;
+            }
 
-                        if (ts != AV_NOPTS_VALUE)
-                        {
-                            if (firstTimestamp == AV_NOPTS_VALUE)
-                            {
-                                firstTimestamp = ts;
-                                startTime = std::chrono::steady_clock::now();
-                            }
-                            else
-                            {
-                                auto now = std::chrono::steady_clock::now();
-                                double elapsed = std::chrono::duration<double>(now - startTime).count();
-                                double target = (ts - firstTimestamp) * av_q2d(timeBase);
-
-                                if (target > elapsed)
-                                {
-                                    std::this_thread::sleep_for(std::chrono::duration<double>(target - elapsed));
-                                }
-                            }
-                        }
-                    }
+            if (pktWrapper->get()->stream_index == m_audioStreamIndex && m_audioSink)
+            {
+                // 音频不经过解码 / 编码，换算到与视频一致的时间轴后直接交给封装端
+                if (normalizeAudioTimestamps(pktWrapper->get()))
+                {
+                    pktWrapper->setMediaType(AVMEDIA_TYPE_AUDIO);
+                    m_audioSink->process(pktWrapper);
+                }
+                continue;
+            }
+            if (pktWrapper->get()->stream_index != m_videoStreamIndex)
+                continue;
 
-                    if (m_next)
+            normalizeTimestamps(pktWrapper->get());
+
+            if (pktWrapper->get()->flags & AV_PKT_FLAG_KEY)
+            {
+                if (m_timings.firstKeyframeMs < 0)
+                {
+                    m_timings.firstKeyframeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_startTime).count();
+                    spdlog::info("[Demuxer] First keyframe from {} after {:.0f} ms", m_url, m_timings.firstKeyframeMs);
+                }
+            }
+
+            if (shouldPace)
+            {
+                int64_t ts = pktWrapper->get()->dts;
+                if (ts == AV_NOPTS_VALUE)
+                    ts = pktWrapper->get()->pts;
+
+                if (ts != AV_NOPTS_VALUE)
+                {
+                    if (firstTimestamp == AV_NOPTS_VALUE)
                     {
-                        static int demuxLog = 0;
-                        if (++demuxLog % 60 == 0)
+                        firstTimestamp = ts;
+                        startTime = std::chrono::steady_clock::now();
+                    }
+                    else
+                    {
+                        // 截止时间由整数时间戳换算到纳秒后加到固定起点上，不会累积误差
+                        auto deadline = startTime + std::chrono::nanoseconds(av_rescale_q(ts - firstTimestamp, m_timeBase, {1, 1000000000}));
+                        // 落后时不睡眠直接追赶 (解码器据此判断是否需要降级)；
+                        // 分段睡眠，时间戳跳变时 stop() 也能及时生效
+                        while (m_running && deadline - std::chrono::steady_clock::now() > kPacingSlice)
                         {
-                            spdlog::info("[Demuxer] Read packet pts={} from {}", pktWrapper->get()->pts, m_url);
+                            preciseSleepUntil(std::chrono::steady_clock::now() + kPacingSlice, std::chrono::microseconds(0));
+                        }
+                        if (m_running)
+                        {
+                            preciseSleepUntil(deadline);
                         }
-                        m_next->process(pktWrapper);
                     }
                 }
             }
-            else
+
+            if (m_next)
             {
-                // EOF or error
-                m_running = false;
+                if (++m_demuxLog % 60 == 0)
+                {
+                    spdlog::info("[Demuxer] Read packet pts={} from {}", pktWrapper->get()->pts, m_url);
+                }
+                m_next->process(pktWrapper);
+            }
+        }
+    }
+
+    int Demuxer::readNext(AVPacket *pkt)
+    {
+        if (!m_prefetched.empty())
+        {
+            av_packet_move_ref(pkt, m_prefetched.front()->get());
+            m_prefetched.pop_front();
+            return 0;
+        }
+        if (m_loopReplaying)
+        {
+            if (m_loopPos >= m_loopPackets.size())
+                return AVERROR_EOF;
+
+            const LoopPacket &entry = m_loopPackets[m_loopPos++];
+            pkt->buf = av_buffer_ref(m_loopChunks[entry.chunk]);
+            if (!pkt->buf)
+                return AVERROR(ENOMEM);
+            pkt->data = pkt->buf->data + entry.offset;
+            pkt->size = (int)entry.size;
+            pkt->pts = entry.pts;
+            pkt->dts = entry.dts;
+            pkt->duration = entry.duration;
+            pkt->flags = entry.flags;
+            pkt->stream_index = m_videoStreamIndex;
+            return 0;
+        }
+
+        armDeadline(kReadTimeout);
+        int ret = av_read_frame(m_formatCtx, pkt);
+        armDeadline(std::chrono::milliseconds(0));
+
+        if (ret >= 0 && m_loop && m_loopCaching && pkt->stream_index == m_videoStreamIndex)
+        {
+            appendToLoopCache(pkt);
+        }
+        return ret;
+    }
+
+    void Demuxer::appendToLoopCache(const AVPacket *pkt)
+    {
+        size_t needed = (size_t)pkt->size + AV_INPUT_BUFFER_PADDING_SIZE;
+        if (m_loopBytes + needed > m_loopMaxBytes)
+        {
+            // 超出内存上限：放弃缓存，之后循环改为 seek 回文件头
+            spdlog::warn("[Demuxer] Loop cache for {} exceeds {} MB, falling back to seeking", m_url, m_loopMaxBytes / (1024 * 1024));
+            clearLoopCache();
+            m_loopCaching = false;
+            return;
+        }
+
+        // 包数据紧凑地追加到大块缓冲中，重放时以引用计数共享，不再拷贝
+        if (m_loopChunks.empty() || m_loopChunkUsed + needed > (size_t)m_loopChunks.back()->size)
+        {
+            AVBufferRef *chunk = av_buffer_alloc((int)std::max(kLoopChunkSize, needed));
+            if (!chunk)
+            {
+                clearLoopCache();
+                m_loopCaching = false;
+                return;
+            }
+            m_loopChunks.push_back(chunk);
+            m_loopChunkUsed = 0;
+            m_loopBytes += chunk->size;
+        }
+
+        AVBufferRef *chunk = m_loopChunks.back();
+        memcpy(chunk->data + m_loopChunkUsed, pkt->data, pkt->size);
+        memset(chunk->data + m_loopChunkUsed + pkt->size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+        LoopPacket entry;
+        entry.chunk = (uint32_t)(m_loopChunks.size() - 1);
+        entry.offset = (uint32_t)m_loopChunkUsed;
+        entry.size = (uint32_t)pkt->size;
+        entry.pts = pkt->pts;
+        entry.dts = pkt->dts;
+        entry.duration = pkt->duration;
+        entry.flags = pkt->flags;
+        if (pkt->flags & AV_PKT_FLAG_KEY)
+        {
+            int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            m_loopKeyframes.push_back({ts, (uint32_t)m_loopPackets.size()});
+        }
+        m_loopPackets.push_back(entry);
+        m_loopChunkUsed += (needed + 63) & ~(size_t)63;
+    }
+
+    void Demuxer::clearLoopCache()
+    {
+        for (auto *chunk : m_loopChunks)
+            av_buffer_unref(&chunk);
+        m_loopChunks.clear();
+        m_loopPackets.clear();
+        m_loopKeyframes.clear();
+        m_loopChunkUsed = 0;
+        m_loopBytes = 0;
+        m_loopReplaying = false;
+        m_loopPos = 0;
+    }
+
+    bool Demuxer::rewind()
+    {
+        m_loopCount++;
+        m_resync = true;
+
+        if (m_loopCaching && !m_loopKeyframes.empty())
+        {
+            if (!m_loopReplaying)
+            {
+                spdlog::info("[Demuxer] Loop cache for {} complete: {} packets, {} keyframes, {:.1f} MB",
+                             m_url, m_loopPackets.size(), m_loopKeyframes.size(), m_loopBytes / (1024.0 * 1024.0));
+                m_loopReplaying = true;
+            }
+            // 从第一个关键帧开始重放，跳过文件开头可能存在的无参考帧
+            m_loopPos = m_loopKeyframes.front().index;
+            return true;
+        }
+
+        // 没有可用的缓存 (超限或无关键帧)，停止缓存并 seek 回文件头
+        if (m_loopCaching)
+        {
+            clearLoopCache();
+            m_loopCaching = false;
+        }
+
+        AVStream *stream = m_formatCtx->streams[m_videoStreamIndex];
+        int64_t start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+        if (av_seek_frame(m_formatCtx, m_videoStreamIndex, start, AVSEEK_FLAG_BACKWARD) < 0 &&
+            avformat_seek_file(m_formatCtx, -1, INT64_MIN, 0, INT64_MAX, 0) < 0)
+        {
+            spdlog::error("[Demuxer] Could not rewind {}", m_url);
+            return false;
+        }
+        return true;
+    }
+
+    void Demuxer::seekTo(double seconds)
+    {
+        AVStream *stream = m_formatCtx->streams[m_videoStreamIndex];
+        int64_t start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+        int64_t target = start + av_rescale_q((int64_t)(seconds * AV_TIME_BASE), AV_TIME_BASE_Q, stream->time_base);
+        m_resync = true;
+
+        if (m_loopReplaying)
+        {
+            // 在关键帧索引中找到不晚于目标的最后一个关键帧
+            auto it = std::upper_bound(m_loopKeyframes.begin(), m_loopKeyframes.end(), target,
+                                       [](int64_t ts, const LoopKeyframe &kf)
+                                       { return ts < kf.ts; });
+            m_loopPos = it == m_loopKeyframes.begin() ? m_loopKeyframes.front().index : std::prev(it)->index;
+            return;
+        }
+
+        // 缓存未完成时跳转会让缓存不连续，直接放弃缓存
+        if (m_loopCaching)
+        {
+            clearLoopCache();
+            m_loopCaching = false;
+        }
+        if (av_seek_frame(m_formatCtx, m_videoStreamIndex, target, AVSEEK_FLAG_BACKWARD) < 0)
+        {
+            spdlog::warn("[Demuxer] Seek to {:.2f}s failed for {}", seconds, m_url);
+        }
+    }
+
+    void Demuxer::normalizeTimestamps(AVPacket *pkt)
+    {
+        // 重连后流的时间基可能变化，统一换算到初始化时公布给下游的时间基
+        AVRational tb = m_formatCtx->streams[m_videoStreamIndex]->time_base;
+        if (av_cmp_q(tb, m_timeBase) != 0)
+        {
+            av_packet_rescale_ts(pkt, tb, m_timeBase);
+        }
+
+        int64_t ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+        if (m_resync && ts != AV_NOPTS_VALUE)
+        {
+            // 新连接的第一个包紧接在断开前 (含补帧) 的最后一个时间戳之后
+            m_tsOffset = m_lastTs == AV_NOPTS_VALUE ? 0 : m_lastTs + m_frameDuration - ts;
+            m_resync = false;
+            spdlog::info("[Demuxer] Timestamps re-synced for {} (offset {})", m_url, m_tsOffset);
+        }
+
+        if (pkt->pts != AV_NOPTS_VALUE)
+            pkt->pts += m_tsOffset;
+        if (pkt->dts != AV_NOPTS_VALUE)
+            pkt->dts += m_tsOffset;
+
+        ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+        if (ts != AV_NOPTS_VALUE)
+        {
+            if (m_lastTs != AV_NOPTS_VALUE && ts > m_lastTs && ts - m_lastTs < m_frameDuration * 4)
+            {
+                m_frameDuration = ts - m_lastTs;
+            }
+            if (m_lastTs == AV_NOPTS_VALUE || ts > m_lastTs)
+            {
+                m_lastTs = ts;
+            }
+        }
+
+        if (pkt->flags & AV_PKT_FLAG_KEY)
+        {
+            auto keyframe = std::make_shared<AVPacketWrapper>();
+            if (av_packet_ref(keyframe->get(), pkt) == 0)
+            {
+                m_lastKeyframe = keyframe;
+            }
+        }
+    }
+
+    bool Demuxer::normalizeAudioTimestamps(AVPacket *pkt)
+    {
+        // 断线重连 / 循环后的偏移由视频包确定，在此之前到达的音频无法对齐，直接丢弃
+        if (m_resync || !m_audioParams)
+            return false;
+
+        AVRational tb = m_formatCtx->streams[m_audioStreamIndex]->time_base;
+        if (av_cmp_q(tb, m_audioTimeBase) != 0)
+        {
+            av_packet_rescale_ts(pkt, tb, m_audioTimeBase);
+        }
+
+        int64_t offset = av_rescale_q(m_tsOffset, m_timeBase, m_audioTimeBase);
+        if (pkt->pts != AV_NOPTS_VALUE)
+            pkt->pts += offset;
+        if (pkt->dts != AV_NOPTS_VALUE)
+            pkt->dts += offset;
+        return pkt->pts != AV_NOPTS_VALUE || pkt->dts != AV_NOPTS_VALUE;
+    }
+
+    bool Demuxer::reconnect()
+    {
+        spdlog::warn("[Demuxer] Input {} lost, reconnecting", m_url);
+        m_resync = true;
+
+        // 断线期间由补帧线程按帧率重复最后一个关键帧，下游编码器和 RTSP 会话保持活跃
+        m_holding = true;
+        std::thread holdThread(&Demuxer::holdLoop, this);
+
+        bool reconnected = false;
+        auto delay = kReconnectMinDelay;
+        for (int attempt = 1; m_running; attempt++)
+        {
+            if (m_formatCtx)
+            {
+                avformat_close_input(&m_formatCtx);
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(m_waitMutex);
+                m_waitCv.wait_for(lock, delay, [this]
+                                  { return !m_running; });
+            }
+            if (!m_running)
+                break;
+
+            spdlog::info("[Demuxer] Reconnect attempt {} to {}", attempt, m_url);
+            if (openValidatedInput())
+            {
+                AVCodecParameters *par = m_formatCtx->streams[m_videoStreamIndex]->codecpar;
+                if (par->codec_id != m_videoParams->codec_id || par->width != m_videoParams->width || par->height != m_videoParams->height)
+                {
+                    // 编码格式或分辨率变化时下游解码器无法继续，只能结束本条链路
+                    spdlog::error("[Demuxer] Stream format changed after reconnect ({} {}x{} -> {} {}x{}), giving up",
+                                  avcodec_get_name(m_videoParams->codec_id), m_videoParams->width, m_videoParams->height,
+                                  avcodec_get_name(par->codec_id), par->width, par->height);
+                    break;
+                }
+                spdlog::info("[Demuxer] Reconnected to {} after {} attempt(s)", m_url, attempt);
+                m_reconnects++;
+                reconnected = true;
+                break;
+            }
+
+            if (m_maxReconnectAttempts > 0 && attempt >= m_maxReconnectAttempts)
+            {
+                spdlog::error("[Demuxer] Giving up on {} after {} attempts", m_url, attempt);
+                break;
             }
+            delay = std::min(delay * 2, kReconnectMaxDelay);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_waitMutex);
+            m_holding = false;
+        }
+        m_waitCv.notify_all();
+        holdThread.join();
+        return reconnected && m_running;
+    }
+
+    void Demuxer::holdLoop()
+    {
+        auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(m_frameDuration * av_q2d(m_timeBase)));
+        auto next = std::chrono::steady_clock::now();
+        int repeated = 0;
+
+        while (true)
+        {
+            next += interval;
+            {
+                std::unique_lock<std::mutex> lock(m_waitMutex);
+                if (m_waitCv.wait_until(lock, next, [this]
+                                        { return !m_holding || !m_running; }))
+                    break;
+            }
+
+            if (!m_lastKeyframe || !m_next)
+                continue;
+
+            auto copy = std::make_shared<AVPacketWrapper>();
+            if (av_packet_ref(copy->get(), m_lastKeyframe->get()) < 0)
+                continue;
+            m_lastTs += m_frameDuration;
+            copy->get()->pts = copy->get()->dts = m_lastTs;
+            m_next->process(copy);
+            repeated++;
+        }
+
+        if (repeated > 0)
+        {
+            spdlog::info("[Demuxer] Repeated last keyframe {} times while {} was unavailable", repeated, m_url);
         }
     }
 
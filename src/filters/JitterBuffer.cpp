@@ -0,0 +1,293 @@
+#include "filters/JitterBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <spdlog/spdlog.h>
+
+namespace pb
+{
+    namespace
+    {
+        // 目标深度为平滑抖动的倍数
+        constexpr double kJitterFactor = 3.0;
+        // 深度上调立即生效，下调按每包 1/128 的速度回落，避免在抖动边缘反复振荡
+        constexpr double kDelayDecay = 1.0 / 128.0;
+        // 最小传输时延缓慢上浮，以跟随路径变化与两端时钟漂移
+        constexpr double kTransitDrift = 1.0 / 1024.0;
+        // 排队包数上限，超出时强制送出最早的包
+        constexpr size_t kMaxQueuedPackets = 1024;
+    }
+
+    JitterBuffer::JitterBuffer(AVRational timeBase)
+        : Filter("JitterBuffer"), m_timeBase(timeBase)
+    {
+    }
+
+    JitterBuffer::~JitterBuffer()
+    {
+        stop();
+    }
+
+    void JitterBuffer::setDelayRange(std::chrono::milliseconds minDelay, std::chrono::milliseconds maxDelay)
+    {
+        m_minDelay = minDelay;
+        m_maxDelay = std::max(minDelay, maxDelay);
+    }
+
+    bool JitterBuffer::initialize()
+    {
+        if (m_timeBase.num <= 0 || m_timeBase.den <= 0)
+        {
+            spdlog::error("[JitterBuffer] Invalid time base");
+            return false;
+        }
+
+        if (m_minDelay.count() < 0)
+        {
+            // UltraLow 只在出现乱序/抖动时才缓冲；Standard 优先保证顺序与平滑
+            switch (m_latencyLevel)
+            {
+            case LatencyLevel::UltraLow:
+                setDelayRange(std::chrono::milliseconds(0), std::chrono::milliseconds(60));
+                break;
+            case LatencyLevel::Low:
+                setDelayRange(std::chrono::milliseconds(20), std::chrono::milliseconds(200));
+                break;
+            case LatencyLevel::Standard:
+                setDelayRange(std::chrono::milliseconds(60), std::chrono::milliseconds(500));
+                break;
+            }
+        }
+        m_delay = std::chrono::duration<double>(m_minDelay).count();
+
+        spdlog::info("[JitterBuffer] Initialized, delay range {}-{} ms", m_minDelay.count(), m_maxDelay.count());
+        return true;
+    }
+
+    void JitterBuffer::start()
+    {
+        if (m_running)
+            return;
+        m_running = true;
+        m_thread = std::thread(&JitterBuffer::run, this);
+    }
+
+    void JitterBuffer::requestStop()
+    {
+        m_running = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+        }
+        m_cv.notify_all();
+    }
+
+    void JitterBuffer::stop()
+    {
+        requestStop();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.clear();
+    }
+
+    void JitterBuffer::reset(double transit)
+    {
+        m_generation++;
+        m_minTransit = transit;
+        m_lastTransit = transit;
+        m_lastIn = AV_NOPTS_VALUE;
+        m_highestIn = AV_NOPTS_VALUE;
+        m_lastOut = AV_NOPTS_VALUE;
+        m_synced = true;
+
+        // 上一代尚未送出的包立即按序送出
+        auto now = std::chrono::steady_clock::now();
+        for (auto &item : m_queue)
+        {
+            item.second.due = std::min(item.second.due, now);
+        }
+    }
+
+    void JitterBuffer::updateDelay(double excess)
+    {
+        double minDelay = std::chrono::duration<double>(m_minDelay).count();
+        double maxDelay = std::chrono::duration<double>(m_maxDelay).count();
+
+        double target = std::clamp(kJitterFactor * m_jitter, minDelay, maxDelay);
+        // 乱序或迟到的包说明当前深度不够，直接扩到能容纳它的深度
+        if (excess > 0.0)
+            target = std::max(target, std::min(excess, maxDelay));
+
+        if (target > m_delay)
+            m_delay = target;
+        else
+            m_delay += (target - m_delay) * kDelayDecay;
+    }
+
+    std::chrono::steady_clock::time_point JitterBuffer::dueTime(int64_t ts) const
+    {
+        double media = ts * av_q2d(m_timeBase);
+        return m_epoch + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                             std::chrono::duration<double>(media + m_minTransit + m_delay));
+    }
+
+    void JitterBuffer::countLoss(int64_t ts)
+    {
+        if (m_lastOut == AV_NOPTS_VALUE || m_frameDuration <= 0 || ts <= m_lastOut)
+            return;
+        int64_t missing = (ts - m_lastOut + m_frameDuration / 2) / m_frameDuration - 1;
+        // 过大的间隔多半是源端暂停而不是丢包
+        if (missing > 0 && missing < 1000)
+            m_lost += missing;
+    }
+
+    void JitterBuffer::process(DataPacket::Ptr packet)
+    {
+        if (!m_running)
+            return;
+
+        if (packet->type() != PacketType::AV_PACKET)
+        {
+            if (m_next)
+                m_next->process(packet);
+            return;
+        }
+
+        auto pktWrapper = std::static_pointer_cast<AVPacketWrapper>(packet);
+        AVPacket *pkt = pktWrapper->get();
+        int64_t ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+        m_received++;
+        if (pkt->flags & AV_PKT_FLAG_CORRUPT)
+            m_lost++;
+
+        auto now = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (ts == AV_NOPTS_VALUE)
+            {
+                // 没有时间戳无法排序，跟在已排队的包后面立即送出
+                int64_t key = m_highestIn != AV_NOPTS_VALUE ? m_highestIn : 0;
+                m_queue.emplace(std::make_pair(m_generation, key), Entry{pktWrapper, now, false});
+                m_cv.notify_one();
+                return;
+            }
+
+            if (!m_synced)
+                m_epoch = now;
+            double arrival = std::chrono::duration<double>(now - m_epoch).count();
+            double transit = arrival - ts * av_q2d(m_timeBase);
+
+            // 时间戳回退或大幅跳变 (源端重启、循环播放) 时开始新的一代
+            bool discontinuity = !m_synced;
+            if (m_lastIn != AV_NOPTS_VALUE)
+            {
+                double step = (ts - m_lastIn) * av_q2d(m_timeBase);
+                discontinuity = discontinuity || step < -1.0 || step > 10.0;
+            }
+            if (discontinuity)
+                reset(transit);
+
+            if (m_lastOut != AV_NOPTS_VALUE && ts <= m_lastOut)
+            {
+                // 后续的包已经送给解码器，再送只会造成花屏
+                m_late++;
+                updateDelay(transit - m_minTransit);
+                return;
+            }
+
+            double excess = 0.0;
+            if (m_highestIn != AV_NOPTS_VALUE && ts < m_highestIn)
+            {
+                m_reordered++;
+                excess = transit - m_minTransit;
+            }
+            else
+            {
+                if (pkt->duration > 0)
+                    m_frameDuration = pkt->duration;
+                else if (m_highestIn != AV_NOPTS_VALUE && ts > m_highestIn && (m_frameDuration <= 0 || ts - m_highestIn < m_frameDuration))
+                    m_frameDuration = ts - m_highestIn;
+
+                // RFC 3550 的到达抖动估计，只用按序到达的包
+                if (m_lastIn != AV_NOPTS_VALUE && ts > m_lastIn)
+                    m_jitter += (std::fabs(transit - m_lastTransit) - m_jitter) / 16.0;
+                m_highestIn = ts;
+            }
+            m_lastIn = ts;
+            m_lastTransit = transit;
+
+            if (transit < m_minTransit)
+                m_minTransit = transit;
+            else
+                m_minTransit += (transit - m_minTransit) * kTransitDrift;
+
+            updateDelay(excess);
+
+            m_queue.emplace(std::make_pair(m_generation, ts), Entry{pktWrapper, dueTime(ts), true});
+            if (m_queue.size() > kMaxQueuedPackets)
+                m_queue.begin()->second.due = now;
+        }
+        m_cv.notify_one();
+
+        if (++m_jitterLog % 300 == 0)
+        {
+            auto s = stats();
+            spdlog::info("[JitterBuffer] jitter {:.1f} ms, delay {:.1f} ms, depth {}, reordered {}, late {}, lost {}",
+                         s.jitterMs, s.delayMs, s.depth, s.reordered, s.late, s.lost);
+        }
+    }
+
+    void JitterBuffer::run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running)
+        {
+            if (m_queue.empty())
+            {
+                m_cv.wait(lock, [this]
+                          { return !m_running || !m_queue.empty(); });
+                continue;
+            }
+
+            auto it = m_queue.begin();
+            if (std::chrono::steady_clock::now() < it->second.due)
+            {
+                // 期间到达更早的包或停止时会被唤醒，重新检查队首
+                m_cv.wait_until(lock, it->second.due);
+                continue;
+            }
+
+            auto packet = it->second.packet;
+            if (it->second.timed && it->first.first == m_generation)
+            {
+                countLoss(it->first.second);
+                m_lastOut = std::max(m_lastOut, it->first.second);
+            }
+            m_queue.erase(it);
+
+            lock.unlock();
+            if (m_next)
+                m_next->process(packet);
+            m_released++;
+            lock.lock();
+        }
+    }
+
+    JitterBuffer::Stats JitterBuffer::stats() const
+    {
+        Stats s;
+        s.received = m_received;
+        s.released = m_released;
+        s.reordered = m_reordered;
+        s.late = m_late;
+        s.lost = m_lost;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        s.jitterMs = m_jitter * 1000.0;
+        s.delayMs = m_delay * 1000.0;
+        s.depth = m_queue.size();
+        return s;
+    }
+
+} // namespace pb
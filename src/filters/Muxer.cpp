@@ -1,8 +1,23 @@
 #include "filters/Muxer.h"
+#include "core/RateController.h"
+#include "core/RecordingWriter.h"
+#include "core/UdpPacer.h"
+#include <algorithm>
+#include <chrono>
 #include <spdlog/spdlog.h>
 
 namespace pb
 {
+    namespace
+    {
+        // 连接 + 写头、单次写包，以及停止时写尾的最长阻塞时间
+        constexpr std::chrono::milliseconds kOpenTimeout{10000};
+        constexpr std::chrono::milliseconds kWriteTimeout{5000};
+        constexpr std::chrono::milliseconds kStopGrace{1000};
+        // 重连退避：从 500ms 开始翻倍，最长 30s
+        constexpr std::chrono::milliseconds kReconnectMinDelay{500};
+        constexpr std::chrono::milliseconds kReconnectMaxDelay{30000};
+    }
 
     Muxer::Muxer(const std::string &url) : Filter("Muxer"), m_url(url) {}
 
@@ -10,24 +25,50 @@ namespace pb
     {
         spdlog::info("[Muxer] Destructor started");
         spdlog::default_logger()->flush();
+        // 析构时不再等待积压写完
+        requestStop();
         stop();
-        if (m_formatCtx)
-        {
-            if (!(m_formatCtx->oformat->flags & AVFMT_NOFILE))
-            {
-                spdlog::info("[Muxer] Closing IO");
-                spdlog::default_logger()->flush();
-                avio_closep(&m_formatCtx->pb);
-            }
-            spdlog::info("[Muxer] Freeing format context");
-            spdlog::default_logger()->flush();
-            avformat_free_context(m_formatCtx);
-        }
+        closeOutput();
+        if (m_writePacket)
+            av_packet_free(&m_writePacket);
+        if (m_videoParams)
+            avcodec_parameters_free(&m_videoParams);
+        if (m_audioParams)
+            avcodec_parameters_free(&m_audioParams);
         spdlog::info("[Muxer] Destructor finished");
         spdlog::default_logger()->flush();
     }
 
     bool Muxer::initialize(AVCodecContext *encoderCtx)
+    {
+        // 保存一份参数副本，重连时重建输出流不再依赖编码器上下文
+        m_videoParams = avcodec_parameters_alloc();
+        if (!m_videoParams || avcodec_parameters_from_context(m_videoParams, encoderCtx) < 0)
+        {
+            spdlog::error("Could not copy codec parameters to muxer");
+            return false;
+        }
+        m_srcTimeBase = encoderCtx->time_base;
+        m_writePacket = av_packet_alloc();
+
+        if (!openOutput())
+            return false;
+        m_hasAudio = m_audioStream != nullptr;
+        m_connected = true;
+
+        if (m_queueCapacity == 0)
+        {
+            // 按延迟等级允许约 0.5s / 1s / 3s 的积压，超出后整 GOP 丢弃
+            double fps = m_srcTimeBase.num > 0 ? 1.0 / av_q2d(m_srcTimeBase) : 30.0;
+            double seconds = m_latencyLevel == LatencyLevel::UltraLow ? 0.5 : (m_latencyLevel == LatencyLevel::Low ? 1.0 : 3.0);
+            m_queueCapacity = std::max<size_t>(4, (size_t)(fps * seconds));
+        }
+        m_writerThread = std::thread(&Muxer::writerLoop, this);
+        spdlog::info("Muxer initialized for URL: {}", m_url);
+        return true;
+    }
+
+    bool Muxer::openOutput()
     {
         const char *formatName = nullptr;
         if (m_url.find("rtmp://") == 0)
@@ -50,6 +91,10 @@ namespace pb
             return false;
         }
 
+        m_formatCtx->interrupt_callback.callback = interrupt_callback;
+        m_formatCtx->interrupt_callback.opaque = this;
+        armDeadline(kOpenTimeout);
+
         // RTSP 特定配置
         AVDictionary *options = nullptr;
         if (m_url.find("rtsp://") == 0)
@@ -86,22 +131,79 @@ namespace pb
         if (!m_outStream)
         {
             spdlog::error("Could not create new stream");
+            av_dict_free(&options);
             return false;
         }
 
-        if (avcodec_parameters_from_context(m_outStream->codecpar, encoderCtx) < 0)
+        if (avcodec_parameters_copy(m_outStream->codecpar, m_videoParams) < 0)
         {
             spdlog::error("Could not copy codec parameters to muxer");
+            av_dict_free(&options);
             return false;
         }
 
-        m_srcTimeBase = encoderCtx->time_base;
+        m_audioStream = nullptr;
+        if (m_audioParams)
+        {
+            // avformat_query_codec 返回负值表示容器未声明支持列表，此时交给 write_header 判断
+            if (avformat_query_codec(m_formatCtx->oformat, m_audioParams->codec_id, FF_COMPLIANCE_NORMAL) == 0)
+            {
+                spdlog::warn("[Muxer] {} cannot carry {} audio, writing video only",
+                             m_formatCtx->oformat->name, avcodec_get_name(m_audioParams->codec_id));
+            }
+            else if ((m_audioStream = avformat_new_stream(m_formatCtx, nullptr)) != nullptr)
+            {
+                avcodec_parameters_copy(m_audioStream->codecpar, m_audioParams);
+                m_audioStream->codecpar->codec_tag = 0;
+                m_audioStream->time_base = m_audioTimeBase;
+                spdlog::info("[Muxer] Passing through {} audio to {}", avcodec_get_name(m_audioParams->codec_id), m_url);
+            }
+        }
+
+        if (!(m_formatCtx->oformat->flags & AVFMT_NOFILE) && !isNetworkOutput())
+        {
+            // 本地录制：大块对齐写入 + 预分配，不支持的平台回退到 avio_open2
+            RecordingWriter::Options recordingOptions;
+            recordingOptions.directIo = m_directIo;
+            m_recordingWriter = RecordingWriter::open(m_url, recordingOptions);
+            if (m_recordingWriter)
+            {
+                m_formatCtx->pb = m_recordingWriter->context();
+                m_formatCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+            }
+        }
+        else if (m_udpPacing && (m_url.find("udp://") == 0 || m_url.find("rtp://") == 0))
+        {
+            // 替代 FFmpeg 的 udp 协议：数据报按令牌桶节拍发出，避免关键帧瞬间打满接收端缓冲
+            UdpPacer::Options pacerOptions;
+            pacerOptions.rateBps = m_pacingRate;
+            if (pacerOptions.rateBps <= 0)
+            {
+                // 重连时沿用码率控制器当前的目标码率
+                std::lock_guard<std::mutex> lock(m_queueMutex);
+                if (m_pacedBitRate <= 0)
+                    m_pacedBitRate = m_videoParams->bit_rate;
+                pacerOptions.rateBps = autoPacingRate(m_pacedBitRate);
+            }
+            if (m_srcTimeBase.num > 0)
+                pacerOptions.frameInterval = av_q2d(m_srcTimeBase);
+            auto pacer = UdpPacer::open(m_url, pacerOptions);
+            if (pacer)
+            {
+                m_formatCtx->pb = pacer->context();
+                m_formatCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+                // stats() 在界面线程读取发送统计，替换时持队列锁
+                std::lock_guard<std::mutex> lock(m_queueMutex);
+                m_udpPacer = std::move(pacer);
+            }
+        }
 
-        if (!(m_formatCtx->oformat->flags & AVFMT_NOFILE))
+        if (!(m_formatCtx->oformat->flags & AVFMT_NOFILE) && !m_formatCtx->pb)
         {
-            if (avio_open(&m_formatCtx->pb, m_url.c_str(), AVIO_FLAG_WRITE) < 0)
+            if (avio_open2(&m_formatCtx->pb, m_url.c_str(), AVIO_FLAG_WRITE, &m_formatCtx->interrupt_callback, nullptr) < 0)
             {
                 spdlog::error("Could not open output URL: {}", m_url);
+                av_dict_free(&options);
                 return false;
             }
         }
@@ -114,45 +216,494 @@ namespace pb
             return false;
         }
         m_headerWritten = true;
+        armDeadline(std::chrono::milliseconds(0));
 
         if (options)
             av_dict_free(&options);
-        spdlog::info("Muxer initialized for URL: {}", m_url);
         return true;
     }
 
+    void Muxer::closeOutput()
+    {
+        if (!m_formatCtx)
+            return;
+        if (m_recordingWriter)
+        {
+            spdlog::info("[Muxer] Closing recording");
+            spdlog::default_logger()->flush();
+            // 块写入是异步提交的，磁盘满等错误可能到关闭时才暴露
+            if (!m_recordingWriter->close() && !m_failed)
+                markFailed("write to file failed");
+            m_recordingWriter.reset();
+            m_formatCtx->pb = nullptr;
+        }
+        else if (m_udpPacer)
+        {
+            m_udpPacer->close();
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_udpPacer.reset();
+            m_formatCtx->pb = nullptr;
+        }
+        else if (!(m_formatCtx->oformat->flags & AVFMT_NOFILE))
+        {
+            spdlog::info("[Muxer] Closing IO");
+            spdlog::default_logger()->flush();
+            avio_closep(&m_formatCtx->pb);
+        }
+        spdlog::info("[Muxer] Freeing format context");
+        spdlog::default_logger()->flush();
+        avformat_free_context(m_formatCtx);
+        m_formatCtx = nullptr;
+        m_outStream = nullptr;
+        m_audioStream = nullptr;
+        m_headerWritten = false;
+    }
+
+    bool Muxer::isNetworkOutput() const
+    {
+        // 本地文件写失败 (如磁盘已满) 时重开会截断已写的内容，只对网络输出重连
+        static const char *schemes[] = {"rtmp://", "rtmps://", "rtsp://", "srt://", "tcp://", "udp://", "rtp://", "http://", "https://"};
+        for (const char *scheme : schemes)
+        {
+            if (m_url.find(scheme) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    void Muxer::setReconnect(bool enabled, int maxAttempts)
+    {
+        m_reconnect = enabled;
+        m_maxReconnectAttempts = maxAttempts;
+    }
+
+    void Muxer::setAudioStream(const AVCodecParameters *params, AVRational timeBase)
+    {
+        if (m_audioParams)
+            avcodec_parameters_free(&m_audioParams);
+        if (!params)
+            return;
+        m_audioParams = avcodec_parameters_alloc();
+        avcodec_parameters_copy(m_audioParams, params);
+        m_audioTimeBase = timeBase;
+    }
+
     void Muxer::process(DataPacket::Ptr packet)
     {
-        if (packet->type() != PacketType::AV_PACKET)
+        if (packet->type() != PacketType::AV_PACKET || m_aborting || m_draining || m_failed)
             return;
 
         auto pktWrapper = std::static_pointer_cast<AVPacketWrapper>(packet);
         AVPacket *pkt = pktWrapper->get();
+        bool audio = pktWrapper->mediaType() == AVMEDIA_TYPE_AUDIO;
+        if (audio && !m_hasAudio)
+            return;
+        bool keyframe = !audio && (pkt->flags & AV_PKT_FLAG_KEY);
+        int64_t pts = pkt->pts;
+        int64_t dts = pkt->dts;
+
+        size_t depth = 0;
+        bool connected = m_connected;
+        {
+            // 音频包由解复用线程送入，视频包来自编码线程
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            if (m_hasAudio)
+            {
+                // 两路时间戳处于同一源时间轴，以第一个视频包为共同零点
+                int64_t ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+                if (!audio && m_videoOrigin == AV_NOPTS_VALUE && ts != AV_NOPTS_VALUE)
+                {
+                    m_videoOrigin = ts;
+                    m_audioOrigin = av_rescale_q(ts, m_srcTimeBase, m_audioTimeBase);
+                }
+                int64_t origin = audio ? m_audioOrigin : m_videoOrigin;
+                if (origin == AV_NOPTS_VALUE || (audio && ts != AV_NOPTS_VALUE && ts < origin))
+                    return;
+                if (pts != AV_NOPTS_VALUE)
+                    pts -= origin;
+                if (dts != AV_NOPTS_VALUE)
+                    dts -= origin;
+            }
+
+            if (audio)
+            {
+                // 音频不参与 GOP 丢弃判断，只防止视频长期缺席时无限堆积
+                if (m_queue.size() >= m_queueCapacity * 8)
+                {
+                    m_dropped++;
+                    return;
+                }
+            }
+            else
+            {
+                if (!connected && keyframe && !m_queue.empty())
+                {
+                    // 断线期间只保留从最近一个关键帧开始的积压，恢复后补发的内容最少且可以直接解码
+                    m_dropped += m_queue.size();
+                    m_queue.clear();
+                    m_queuedFrames = 0;
+                }
+
+                if (m_waitKeyframe && !keyframe)
+                {
+                    m_dropped++;
+                    return;
+                }
+                m_waitKeyframe = false;
+
+                if (m_queuedFrames >= m_queueCapacity)
+                {
+                    dropOldestGop();
+                    if (m_waitKeyframe && !keyframe)
+                    {
+                        m_dropped++;
+                        return;
+                    }
+                    m_waitKeyframe = false;
+                }
+                m_queuedFrames++;
+            }
+
+            // 时间戳保持源时间基，由写出线程换算到 (可能因重连而重建的) 输出流时间基
+            m_queue.push_back({pktWrapper, pts, dts, audio, keyframe});
+            depth = m_queuedFrames;
+        }
+        m_queueCv.notify_one();
 
-        // Rescale timestamps from encoder timebase to muxer stream timebase
-        av_packet_rescale_ts(pkt, m_srcTimeBase, m_outStream->time_base);
-        pkt->stream_index = m_outStream->index;
+        // 断线期间的积压不是拥塞，不应让码率控制器降码率
+        if (m_rateController && !audio && connected)
+        {
+            m_rateController->onQueueDepth(depth, m_queueCapacity);
+        }
+
+        // 自动速率跟随码率控制器调整后的目标码率
+        if (m_rateController && !audio && m_pacingRate <= 0)
+        {
+            int64_t bitRate = m_rateController->targetBitRate();
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            if (bitRate != m_pacedBitRate)
+            {
+                m_pacedBitRate = bitRate;
+                if (m_udpPacer)
+                    m_udpPacer->setRate(autoPacingRate(bitRate));
+            }
+        }
+    }
+
+    int64_t Muxer::autoPacingRate(int64_t videoBitRate) const
+    {
+        if (videoBitRate <= 0)
+            return 0;
+        return (videoBitRate + (m_audioParams ? m_audioParams->bit_rate : 0)) * 3 / 2;
+    }
+
+    void Muxer::dropOldestGop()
+    {
+        // 从第二个元素开始找下一个关键帧，其之前的部分 (一个完整 GOP) 整体丢弃
+        auto next = m_queue.end();
+        for (auto it = m_queue.begin() + (m_queue.empty() ? 0 : 1); it != m_queue.end(); ++it)
+        {
+            if (it->keyframe)
+            {
+                next = it;
+                break;
+            }
+        }
+        if (next == m_queue.end())
+        {
+            // 队列里只剩一个不完整的 GOP：全部丢弃，之后从下一个关键帧重新开始
+            m_waitKeyframe = true;
+        }
+
+        size_t dropped = 0;
+        for (auto it = m_queue.begin(); it != next; ++it)
+        {
+            if (!it->audio)
+                m_queuedFrames--;
+            dropped++;
+        }
+        m_queue.erase(m_queue.begin(), next);
+        m_dropped += dropped;
+        m_droppedGops++;
+        spdlog::warn("[Muxer] Output queue for {} full, dropped {} packets ({} GOPs dropped so far)", m_url, dropped, m_droppedGops.load());
+    }
+
+    void Muxer::writerLoop()
+    {
+        while (true)
+        {
+            QueuedPacket item;
+            {
+                std::unique_lock<std::mutex> lock(m_queueMutex);
+                m_queueCv.wait(lock, [this]
+                               { return m_aborting || m_draining || !m_queue.empty(); });
+                if (m_aborting || m_queue.empty())
+                    break;
+                if (m_draining && std::chrono::steady_clock::now() >= m_drainDeadline)
+                {
+                    spdlog::warn("[Muxer] Stop grace exceeded for {}, discarding {} queued packets", m_url, m_queue.size());
+                    break;
+                }
+                item = std::move(m_queue.front());
+                m_queue.pop_front();
+                if (!item.audio)
+                    m_queuedFrames--;
+            }
+
+            if (writePacket(item))
+                continue;
+
+            // 连接断开：编码器继续入队，这里重建输出后从积压中的关键帧开始补发
+            if (m_aborting || m_draining)
+                break;
+            if (!isNetworkOutput())
+            {
+                // 文件输出 (磁盘满、设备出错等) 不重连，重新打开会截断已写的内容
+                markFailed("write to file failed");
+                break;
+            }
+            if (!m_reconnect || !reconnect())
+            {
+                if (!m_aborting && !m_draining)
+                    markFailed("connection lost");
+                break;
+            }
+        }
+    }
+
+    void Muxer::markFailed(const std::string &error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            // 保留写出时记录的具体错误 (如 No space left on device)
+            m_error = m_error.empty() ? error : error + ": " + m_error;
+            m_dropped += m_queue.size();
+            m_queue.clear();
+            m_queuedFrames = 0;
+        }
+        m_failed = true;
+        m_connected = false;
+        spdlog::error("[Muxer] Output {} stopped: {}", m_url, m_error);
+    }
+
+    bool Muxer::writePacket(const QueuedPacket &item)
+    {
+        bool audio = item.audio;
+        AVStream *stream = audio ? m_audioStream : m_outStream;
+        if (!stream)
+            return true;
+
+        // 只增加数据缓冲的引用计数，不复制包内容；av_interleaved_write_frame 会接管这份引用
+        AVPacket *pkt = m_writePacket;
+        if (av_packet_ref(pkt, item.packet->get()) < 0)
+            return true;
+        pkt->pts = item.pts;
+        pkt->dts = item.dts;
+        av_packet_rescale_ts(pkt, audio ? m_audioTimeBase : m_srcTimeBase, stream->time_base);
+        pkt->stream_index = stream->index;
 
         static int muxLog = 0;
-        if (++muxLog % 60 == 0)
+        if (!audio && ++muxLog % 60 == 0)
         {
             spdlog::info("[Muxer] Writing packet pts={}, size={} to {}", pkt->pts, pkt->size, m_url);
         }
 
-        if (av_interleaved_write_frame(m_formatCtx, pkt) < 0)
+        auto writeStart = std::chrono::steady_clock::now();
+        if (m_draining)
+        {
+            // 停止时排空队列：单次写入也不能越过整体的截止时间
+            std::chrono::steady_clock::time_point drainDeadline;
+            {
+                std::lock_guard<std::mutex> lock(m_queueMutex);
+                drainDeadline = m_drainDeadline;
+            }
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(drainDeadline - writeStart);
+            armDeadline(std::max(remaining, std::chrono::milliseconds(1)));
+        }
+        else
+        {
+            armDeadline(kWriteTimeout);
+        }
+        int ret = av_interleaved_write_frame(m_formatCtx, pkt);
+        armDeadline(std::chrono::milliseconds(0));
+        av_packet_unref(pkt);
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - writeStart).count();
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_writeMs = 0.9 * m_writeMs + 0.1 * ms;
+            m_peakWriteMs = std::max(ms, m_peakWriteMs * 0.99);
+        }
+
+        if (ret >= 0)
+        {
+            m_written++;
+            return true;
+        }
+
+        char errStr[AV_ERROR_MAX_STRING_SIZE];
+        av_make_error_string(errStr, sizeof(errStr), ret);
+        // EINVAL 是单个包的时间戳等问题，连接仍然可用
+        if (ret == AVERROR(EINVAL) || m_aborting || m_draining)
+        {
+            spdlog::error(audio ? "Error while writing audio packet: {}" : "Error while writing frame: {}", errStr);
+            return true;
+        }
+        spdlog::error("[Muxer] Output {} failed: {}", m_url, errStr);
         {
-            spdlog::error("Error while writing frame");
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_error = errStr;
         }
+        return false;
+    }
+
+    bool Muxer::reconnect()
+    {
+        m_connected = false;
+        {
+            // 断开前尚未写出的包从下一个关键帧开始保留，新连接的第一个视频包必须是关键帧
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            while (!m_queue.empty() && !m_queue.front().keyframe)
+            {
+                if (!m_queue.front().audio)
+                    m_queuedFrames--;
+                m_queue.pop_front();
+                m_dropped++;
+            }
+            if (m_queue.empty())
+                m_waitKeyframe = true;
+        }
+
+        auto delay = kReconnectMinDelay;
+        for (int attempt = 1; !m_aborting && !m_draining; attempt++)
+        {
+            closeOutput();
+
+            {
+                std::unique_lock<std::mutex> lock(m_queueMutex);
+                m_queueCv.wait_for(lock, delay, [this]
+                                   { return m_aborting || m_draining; });
+            }
+            if (m_aborting || m_draining)
+                break;
+
+            spdlog::info("[Muxer] Reconnect attempt {} to {}", attempt, m_url);
+            if (openOutput())
+            {
+                size_t backlog = 0;
+                {
+                    std::lock_guard<std::mutex> lock(m_queueMutex);
+                    backlog = m_queue.size();
+                }
+                spdlog::info("[Muxer] Reconnected to {} after {} attempt(s), replaying {} queued packets", m_url, attempt, backlog);
+                m_reconnects++;
+                m_connected = true;
+                return true;
+            }
+
+            if (m_maxReconnectAttempts > 0 && attempt >= m_maxReconnectAttempts)
+            {
+                spdlog::error("[Muxer] Giving up on {} after {} attempts", m_url, attempt);
+                break;
+            }
+            delay = std::min(delay * 2, kReconnectMaxDelay);
+        }
+        closeOutput();
+        return false;
+    }
+
+    Muxer::Stats Muxer::stats() const
+    {
+        Stats s;
+        s.written = m_written;
+        s.dropped = m_dropped;
+        s.droppedGops = m_droppedGops;
+        s.connected = m_connected;
+        s.failed = m_failed;
+        s.reconnects = m_reconnects;
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        s.error = m_error;
+        s.queuedFrames = m_queuedFrames;
+        s.capacity = m_queueCapacity;
+        s.writeMs = m_writeMs;
+        s.peakWriteMs = m_peakWriteMs;
+        if (m_udpPacer)
+        {
+            auto pacerStats = m_udpPacer->stats();
+            s.pacerBacklogBytes = pacerStats.backlogBytes;
+            s.pacerDropped = pacerStats.dropped;
+        }
+        return s;
+    }
+
+    int Muxer::interrupt_callback(void *opaque)
+    {
+        auto *self = static_cast<Muxer *>(opaque);
+        // 建立连接 (初始化或重连) 期间收到停止请求时立即打断，断线时没有可排空的去处
+        if ((self->m_aborting || self->m_draining) && !self->m_connected)
+            return 1;
+        int64_t deadline = self->m_deadline;
+        if (deadline != 0 && std::chrono::steady_clock::now().time_since_epoch().count() > deadline)
+        {
+            spdlog::warn("[Muxer] I/O deadline exceeded for {}", self->m_url);
+            return 1;
+        }
+        return 0;
+    }
+
+    void Muxer::armDeadline(std::chrono::milliseconds timeout)
+    {
+        if (timeout.count() == 0)
+        {
+            m_deadline = 0;
+            return;
+        }
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        m_deadline = std::chrono::duration_cast<std::chrono::steady_clock::duration>(deadline.time_since_epoch()).count();
+    }
+
+    void Muxer::requestStop()
+    {
+        // 中止：正在进行的写入最多再等 kStopGrace，队列中剩余的包直接丢弃
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_aborting = true;
+        }
+        m_queueCv.notify_all();
+        armDeadline(kStopGrace);
     }
 
     void Muxer::stop()
     {
-        if (m_formatCtx && m_headerWritten && !m_trailerWritten)
+        if (m_writerThread.joinable())
+        {
+            // 正常停止：已入队的包在 kStopGrace 内写完再写尾，超时或已中止时剩余部分丢弃
+            {
+                std::lock_guard<std::mutex> lock(m_queueMutex);
+                if (!m_draining)
+                    m_drainDeadline = std::chrono::steady_clock::now() + kStopGrace;
+                m_draining = true;
+            }
+            m_queueCv.notify_all();
+            m_writerThread.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_queue.clear();
+            m_queuedFrames = 0;
+        }
+
+        // 重连失败后输出已关闭，只有仍处于连接状态时才写尾
+        if (m_formatCtx && m_headerWritten && m_connected)
         {
             spdlog::info("[Muxer] Writing trailer for {}", m_url);
+            // 写尾同样限时，避免对端失联时 stop() 无限阻塞
+            armDeadline(kStopGrace);
             av_write_trailer(m_formatCtx);
-            m_trailerWritten = true;
+            armDeadline(std::chrono::milliseconds(0));
+            m_headerWritten = false;
         }
+        m_connected = false;
     }
 
 } // namespace pb
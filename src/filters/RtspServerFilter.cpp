@@ -1,111 +1,413 @@
 #include "filters/RtspServerFilter.h"
+#include "core/RateController.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
 #include <spdlog/spdlog.h>
 #include <OnDemandServerMediaSubsession.hh>
 #include <H264VideoRTPSink.hh>
 #include <H264VideoStreamFramer.hh>
+#include <H265VideoRTPSink.hh>
+#include <H265VideoStreamFramer.hh>
+#include <MPEG4GenericRTPSink.hh>
+#include <SimpleRTPSink.hh>
 #include <Base64.hh>
 #include <GroupsockHelper.hh>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 namespace pb
 {
+    static constexpr size_t kMaxQueueSize = 10;
+    // 音频帧小而密 (AAC 约 21ms 一帧)，队列按约 1s 的量限制
+    static constexpr size_t kMaxAudioQueueSize = 50;
+
+    namespace
+    {
+        // 事件循环的唤醒 fd：Linux 用 eventfd，其他 POSIX 平台用自管道，
+        // Windows 的 select() 只接受套接字，用连向自身的回环 UDP 套接字
+        bool openWakeFds(int &readFd, int &writeFd)
+        {
+#if defined(__linux__)
+            readFd = writeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            return readFd >= 0;
+#elif defined(_WIN32)
+            SOCKET s = socket(AF_INET, SOCK_DGRAM, 0);
+            if (s == INVALID_SOCKET)
+                return false;
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            int len = sizeof(addr);
+            u_long nonBlocking = 1;
+            if (bind(s, (sockaddr *)&addr, sizeof(addr)) != 0 || getsockname(s, (sockaddr *)&addr, &len) != 0 ||
+                connect(s, (sockaddr *)&addr, sizeof(addr)) != 0 || ioctlsocket(s, FIONBIO, &nonBlocking) != 0)
+            {
+                closesocket(s);
+                return false;
+            }
+            readFd = writeFd = (int)s;
+            return true;
+#else
+            int fds[2];
+            if (pipe(fds) != 0)
+                return false;
+            for (int fd : fds)
+            {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+            readFd = fds[0];
+            writeFd = fds[1];
+            return true;
+#endif
+        }
+
+        void signalWakeFd(int fd)
+        {
+            // eventfd 只接受 8 字节写入；写满 (EAGAIN) 说明已有未处理的唤醒，可以忽略
+            uint64_t one = 1;
+#ifdef _WIN32
+            send((SOCKET)fd, (const char *)&one, sizeof(one), 0);
+#else
+            ssize_t written = write(fd, &one, sizeof(one));
+            (void)written;
+#endif
+        }
+
+        void drainWakeFd(int fd)
+        {
+            uint64_t buf[16];
+#ifdef _WIN32
+            while (recv((SOCKET)fd, (char *)buf, sizeof(buf), 0) > 0)
+            {
+            }
+#else
+            while (read(fd, buf, sizeof(buf)) > 0)
+            {
+            }
+#endif
+        }
+
+        void closeWakeFds(int readFd, int writeFd)
+        {
+#ifdef _WIN32
+            if (readFd >= 0)
+                closesocket((SOCKET)readFd);
+#else
+            if (writeFd >= 0 && writeFd != readFd)
+                close(writeFd);
+            if (readFd >= 0)
+                close(readFd);
+#endif
+        }
+    }
+
     class PacketSource : public FramedSource
     {
-    public:
+        // 通道设置了锚点 (有音频直通) 且 timeBase 有效时按包的 pts 在共用锚点上推算呈现时间，否则取送出时的系统时间；
+        // timeBase 有效时按包的 pts 在通道共用的锚点上推算呈现时间，否则取送出时的系统时间；
+        // stripAdts 用于 AAC：RTP 打包需要裸的 access unit，去掉 MPEG-TS 来源带的 ADTS 头
         static PacketSource *createNew(UsageEnvironment &env,
-                                       std::queue<DataPacket::Ptr> &queue,
-                                       std::mutex &mutex,
-                                       std::condition_variable &cv)
+                                       PacketChannel &channel,
+                                       AVRational timeBase = {0, 1},
+                                       bool stripAdts = false)
         {
-            return new PacketSource(env, queue, mutex, cv);
+            return new PacketSource(env, channel, timeBase, stripAdts);
+        }
+
+        // 事件循环被唤醒后调用 (事件循环线程)，只有下游正在等待时才送出
+        void deliver()
+        {
+            if (isCurrentlyAwaitingData())
+                doGetNextFrame();
         }
 
     protected:
         PacketSource(UsageEnvironment &env,
-                     std::queue<DataPacket::Ptr> &queue,
-                     std::mutex &mutex,
-                     std::condition_variable &cv)
-            : FramedSource(env), m_queue(queue), m_mutex(mutex), m_cv(cv) {}
+                     PacketChannel &channel,
+                     AVRational timeBase,
+                     bool stripAdts)
+            : FramedSource(env), m_channel(channel), m_timeBase(timeBase), m_stripAdts(stripAdts)
+        {
+            m_channel.sources.push_back(this);
+            m_channel.liveSources++;
+        }
+
+        ~PacketSource() override
+        {
+            auto &sources = m_channel.sources;
+            sources.erase(std::remove(sources.begin(), sources.end(), this), sources.end());
+            m_channel.liveSources--;
+        }
 
         void doGetNextFrame() override
         {
-            std::unique_lock<std::mutex> lock(m_mutex);
-            if (m_queue.empty())
+            std::unique_lock<std::mutex> lock(m_channel.mutex);
+            if (m_channel.queue.empty())
             {
-                nextTask() = envir().taskScheduler().scheduleDelayedTask(1000, (TaskFunc *)staticDoGetNextFrame, this);
+                // 保持等待状态，下一个包入队唤醒事件循环后调用 deliver()
                 return;
             }
 
-            auto packet = m_queue.front();
+            auto packet = m_channel.queue.front();
             auto pktWrapper = std::static_pointer_cast<AVPacketWrapper>(packet);
             AVPacket *pkt = pktWrapper->get();
 
-            m_queue.pop();
+            m_channel.queue.pop();
             lock.unlock();
 
-            if (pkt->size > fMaxSize)
+            const uint8_t *data = pkt->data;
+            unsigned size = (unsigned)pkt->size;
+            if (m_stripAdts && size >= 7 && data[0] == 0xFF && (data[1] & 0xF0) == 0xF0)
+            {
+                // protection_absent 为 0 时头部后面还有 2 字节 CRC
+                unsigned header = (data[1] & 0x01) ? 7 : 9;
+                header = std::min(header, size);
+                data += header;
+                size -= header;
+            }
+
+            if (size > fMaxSize)
             {
                 fFrameSize = fMaxSize;
-                fNumTruncatedBytes = pkt->size - fMaxSize;
+                fNumTruncatedBytes = size - fMaxSize;
             }
             else
             {
-                fFrameSize = pkt->size;
+                fFrameSize = size;
                 fNumTruncatedBytes = 0;
             }
 
-            memcpy(fTo, pkt->data, fFrameSize);
-            gettimeofday(&fPresentationTime, NULL);
+            memcpy(fTo, data, fFrameSize);
+            setPresentationTime(pkt);
             FramedSource::afterGetting(this);
         }
 
-        static void staticDoGetNextFrame(void *clientData)
+        void setPresentationTime(const AVPacket *pkt)
         {
-            ((PacketSource *)clientData)->doGetNextFrame();
+            PresentationAnchor *anchor = m_channel.anchor;
+            if (!anchor || m_timeBase.num <= 0 || pkt->pts == AV_NOPTS_VALUE)
+            {
+                gettimeofday(&fPresentationTime, NULL);
+                return;
+            }
+
+            // 两路时间戳处于同一源时间轴，先送出的一路确定锚点，另一路沿用
+            int64_t ptsUs = av_rescale_q(pkt->pts, m_timeBase, {1, 1000000});
+            int64_t us;
+            {
+                std::lock_guard<std::mutex> lock(anchor->mutex);
+                if (anchor->originUs == AV_NOPTS_VALUE)
+                {
+                    anchor->originUs = ptsUs;
+                    gettimeofday(&anchor->wall, NULL);
+                }
+                us = (int64_t)anchor->wall.tv_sec * 1000000 + anchor->wall.tv_usec + (ptsUs - anchor->originUs);
+            }
+            fPresentationTime.tv_sec = (long)(us / 1000000);
+            fPresentationTime.tv_usec = (long)(us % 1000000);
         }
 
     private:
-        std::queue<DataPacket::Ptr> &m_queue;
-        std::mutex &m_mutex;
-        std::condition_variable &m_cv;
+        PacketChannel &m_channel;
+        AVRational m_timeBase;
+        bool m_stripAdts;
     };
 
-    class LiveH264Subsession : public OnDemandServerMediaSubsession
+    // 根据编码器的 codec id 选择对应的 Framer / RTPSink (H.264 或 H.265)
+    class LiveVideoSubsession : public OnDemandServerMediaSubsession
     {
     public:
-        static LiveH264Subsession *createNew(UsageEnvironment &env,
-                                             std::queue<DataPacket::Ptr> &queue,
-                                             std::mutex &mutex,
-                                             std::condition_variable &cv,
-                                             AVCodecContext *encoderCtx)
+        static LiveVideoSubsession *createNew(UsageEnvironment &env,
+                                              PacketChannel &channel,
+                                              AVCodecID codecId,
+                                              AVRational timeBase,
+                                              unsigned estBitrateKbps,
+                                              RateController *rateController)
         {
-            return new LiveH264Subsession(env, queue, mutex, cv, encoderCtx);
+            return new LiveVideoSubsession(env, channel, codecId, timeBase, estBitrateKbps, rateController);
+        }
+
+        static bool isSupported(AVCodecID codecId)
+        {
+            // live555 没有 AV1 / MJPEG (非 JPEGVideoSource) 的 RTP 打包器
+            return codecId == AV_CODEC_ID_H264 || codecId == AV_CODEC_ID_HEVC;
         }
 
     protected:
-        LiveH264Subsession(UsageEnvironment &env,
-                           std::queue<DataPacket::Ptr> &queue,
-                           std::mutex &mutex,
-                           std::condition_variable &cv,
-                           AVCodecContext *encoderCtx)
-            : OnDemandServerMediaSubsession(env, True), m_queue(queue), m_mutex(mutex), m_cv(cv), m_encoderCtx(encoderCtx) {}
+        LiveVideoSubsession(UsageEnvironment &env,
+                            PacketChannel &channel,
+                            AVCodecID codecId,
+                            AVRational timeBase,
+                            unsigned estBitrateKbps,
+                            RateController *rateController)
+            : OnDemandServerMediaSubsession(env, True), m_channel(channel),
+              m_codecId(codecId), m_timeBase(timeBase), m_estBitrateKbps(estBitrateKbps), m_rateController(rateController) {}
 
         FramedSource *createNewStreamSource(unsigned /*clientSessionId*/, unsigned &estBitrate) override
         {
-            estBitrate = 4000; // kbps
-            auto source = PacketSource::createNew(envir(), m_queue, m_mutex, m_cv);
+            estBitrate = m_estBitrateKbps;
+            auto source = PacketSource::createNew(envir(), m_channel, m_timeBase);
+            if (m_codecId == AV_CODEC_ID_HEVC)
+                return H265VideoStreamFramer::createNew(envir(), source);
             return H264VideoStreamFramer::createNew(envir(), source);
         }
 
         RTPSink *createNewRTPSink(Groupsock *rtpGroupsock, unsigned char rtpPayloadTypeIfDynamic, FramedSource * /*inputSource*/) override
         {
+            if (m_codecId == AV_CODEC_ID_HEVC)
+                return H265VideoRTPSink::createNew(envir(), rtpGroupsock, rtpPayloadTypeIfDynamic);
             return H264VideoRTPSink::createNew(envir(), rtpGroupsock, rtpPayloadTypeIfDynamic);
         }
 
+        RTCPInstance *createRTCP(Groupsock *RTCPgs, unsigned totSessionBW, unsigned char const *cname, RTPSink *sink) override
+        {
+            RTCPInstance *rtcp = OnDemandServerMediaSubsession::createRTCP(RTCPgs, totSessionBW, cname, sink);
+            if (rtcp && m_rateController)
+            {
+                // reuseFirstSource 模式下同一时刻只有一个 RTPSink / RTCPInstance
+                m_rtpSink = sink;
+                rtcp->setRRHandler((TaskFunc *)handleReceiverReport, this);
+            }
+            return rtcp;
+        }
+
+        static void handleReceiverReport(void *clientData)
+        {
+            ((LiveVideoSubsession *)clientData)->handleReceiverReport1();
+        }
+
+        void handleReceiverReport1()
+        {
+            if (!m_rtpSink || !m_rateController)
+                return;
+
+            // 取所有客户端中最差的丢包率和抖动，保证最弱的接收端也能流畅播放
+            double worstLoss = 0.0;
+            double worstJitterMs = 0.0;
+            unsigned freq = m_rtpSink->rtpTimestampFrequency();
+            RTPTransmissionStatsDB::Iterator it(m_rtpSink->transmissionStatsDB());
+            RTPTransmissionStats *stats;
+            while ((stats = it.next()) != NULL)
+            {
+                worstLoss = std::max(worstLoss, stats->packetLossRatio() / 256.0);
+                if (freq > 0)
+                    worstJitterMs = std::max(worstJitterMs, stats->jitter() * 1000.0 / freq);
+            }
+            m_rateController->onReceiverReport(worstLoss, worstJitterMs);
+        }
+
     private:
-        std::queue<DataPacket::Ptr> &m_queue;
-        std::mutex &m_mutex;
-        std::condition_variable &m_cv;
-        AVCodecContext *m_encoderCtx;
+        PacketChannel &m_channel;
+        AVCodecID m_codecId;
+        AVRational m_timeBase;
+        unsigned m_estBitrateKbps;
+        RateController *m_rateController;
+        RTPSink *m_rtpSink = nullptr;
+    };
+
+    // 直通的压缩音频：AAC 走 RFC 3640 (MPEG4-GENERIC)，Opus / G.711 每帧一个 RTP 包
+    class LiveAudioSubsession : public OnDemandServerMediaSubsession
+    {
+    public:
+        static LiveAudioSubsession *createNew(UsageEnvironment &env,
+                                              PacketChannel &channel,
+                                              const AVCodecParameters *params,
+                                              AVRational timeBase)
+        {
+            return new LiveAudioSubsession(env, channel, params, timeBase);
+        }
+
+        static bool isSupported(AVCodecID codecId)
+        {
+            return codecId == AV_CODEC_ID_AAC || codecId == AV_CODEC_ID_OPUS ||
+                   codecId == AV_CODEC_ID_PCM_MULAW || codecId == AV_CODEC_ID_PCM_ALAW;
+        }
+
+    protected:
+        LiveAudioSubsession(UsageEnvironment &env,
+                            PacketChannel &channel,
+                            const AVCodecParameters *params,
+                            AVRational timeBase)
+            : OnDemandServerMediaSubsession(env, True), m_channel(channel),
+              m_codecId(params->codec_id), m_sampleRate(params->sample_rate > 0 ? params->sample_rate : 48000),
+              m_channels(std::max(1, params->ch_layout.nb_channels)), m_timeBase(timeBase),
+              m_estBitrateKbps(params->bit_rate > 0 ? (unsigned)(params->bit_rate / 1000) : 128)
+        {
+            if (m_codecId == AV_CODEC_ID_AAC)
+                m_config = aacConfig(params);
+        }
+
+        FramedSource *createNewStreamSource(unsigned /*clientSessionId*/, unsigned &estBitrate) override
+        {
+            estBitrate = m_estBitrateKbps;
+            return PacketSource::createNew(envir(), m_channel, m_timeBase, m_codecId == AV_CODEC_ID_AAC);
+        }
+
+        RTPSink *createNewRTPSink(Groupsock *rtpGroupsock, unsigned char rtpPayloadTypeIfDynamic, FramedSource * /*inputSource*/) override
+        {
+            switch (m_codecId)
+            {
+            case AV_CODEC_ID_AAC:
+                return MPEG4GenericRTPSink::createNew(envir(), rtpGroupsock, rtpPayloadTypeIfDynamic, m_sampleRate,
+                                                      "audio", "AAC-hbr", m_config.c_str(), m_channels);
+            case AV_CODEC_ID_OPUS:
+                // RFC 7587：时钟固定 48kHz，SDP 中声道数固定写 2
+                return SimpleRTPSink::createNew(envir(), rtpGroupsock, rtpPayloadTypeIfDynamic, 48000,
+                                                "audio", "OPUS", 2, False);
+            case AV_CODEC_ID_PCM_MULAW:
+                return SimpleRTPSink::createNew(envir(), rtpGroupsock, m_sampleRate == 8000 && m_channels == 1 ? 0 : rtpPayloadTypeIfDynamic,
+                                                m_sampleRate, "audio", "PCMU", m_channels);
+            default:
+                return SimpleRTPSink::createNew(envir(), rtpGroupsock, m_sampleRate == 8000 && m_channels == 1 ? 8 : rtpPayloadTypeIfDynamic,
+                                                m_sampleRate, "audio", "PCMA", m_channels);
+            }
+        }
+
+    private:
+        // AudioSpecificConfig 的十六进制串；MPEG-TS 来源没有 extradata，按 AAC-LC 从采样率和声道数构造
+        static std::string aacConfig(const AVCodecParameters *params)
+        {
+            std::vector<uint8_t> config(params->extradata, params->extradata + params->extradata_size);
+            if (config.size() < 2)
+            {
+                static const int rates[] = {96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350};
+                int index = 4;
+                for (int i = 0; i < 13; i++)
+                {
+                    if (rates[i] == params->sample_rate)
+                        index = i;
+                }
+                int channels = std::clamp(params->ch_layout.nb_channels, 1, 7);
+                uint16_t asc = (uint16_t)((2 << 11) | (index << 7) | (channels << 3));
+                config = {(uint8_t)(asc >> 8), (uint8_t)(asc & 0xFF)};
+            }
+
+            static const char hex[] = "0123456789abcdef";
+            std::string out;
+            for (uint8_t b : config)
+            {
+                out += hex[b >> 4];
+                out += hex[b & 0x0F];
+            }
+            return out;
+        }
+
+        PacketChannel &m_channel;
+        AVCodecID m_codecId;
+        unsigned m_sampleRate;
+        unsigned m_channels;
+        AVRational m_timeBase;
+        unsigned m_estBitrateKbps;
+        std::string m_config;
     };
 
     RtspServerFilter::RtspServerFilter(int port, const std::string &streamName, const std::string &address)
@@ -126,6 +428,9 @@ namespace pb
             spdlog::default_logger()->flush();
             Medium::close(m_rtspServer);
         }
+        if (m_scheduler && m_wakeReadFd >= 0)
+            m_scheduler->disableBackgroundHandling(m_wakeReadFd);
+        closeWakeFds(m_wakeReadFd, m_wakeWriteFd);
         if (m_env)
         {
             spdlog::info("[RtspServerFilter] Reclaiming environment");
@@ -138,23 +443,44 @@ namespace pb
             spdlog::default_logger()->flush();
             delete m_scheduler;
         }
+        if (m_audioParams)
+            avcodec_parameters_free(&m_audioParams);
         spdlog::info("[RtspServerFilter] Destructor finished");
         spdlog::default_logger()->flush();
     }
 
     bool RtspServerFilter::initialize(AVCodecContext *encoderCtx)
     {
-        m_encoderCtx = encoderCtx;
+        // 只在初始化时读取编码器参数：运行时编码器可能被替换 (reconfigure)，不能长期持有该指针
+        m_codecId = encoderCtx->codec_id;
+        // 编码器重配置时 time_base 保持不变 (始终为 1/输入帧率)
+        m_videoTimeBase = encoderCtx->time_base;
+        if (!LiveVideoSubsession::isSupported(m_codecId))
+        {
+            spdlog::error("RTSP server does not support codec {} (only H.264 / H.265 can be packetized)",
+                          avcodec_get_name(m_codecId));
+            return false;
+        }
+        unsigned estBitrateKbps = encoderCtx->bit_rate > 0 ? (unsigned)(encoderCtx->bit_rate / 1000) : 4000;
 
         // 降低 live555 默认缓冲区大小，避免 5GB 级别的虚拟内存分配
-        // 1080P H.264 关键帧通常在 500KB-1MB 左右，2MB 足够安全
+        // 1080P H.264 / H.265 关键帧通常在 500KB-1MB 左右，2MB 足够安全
         if (OutPacketBuffer::maxSize < 2000000)
         {
             OutPacketBuffer::maxSize = 2000000;
         }
 
-        m_scheduler = BasicTaskScheduler::createNew();
+        // 默认 10ms 的调度粒度会让事件循环空闲时也每秒醒 100 次，且 triggerEvent 只能在下一次醒来时被处理；
+        // 这里关闭周期节拍，跨线程的新包经唤醒 fd 立即打断 select()
+        m_scheduler = BasicTaskScheduler::createNew(0);
         m_env = BasicUsageEnvironment::createNew(*m_scheduler);
+        if (!openWakeFds(m_wakeReadFd, m_wakeWriteFd))
+        {
+            m_wakeReadFd = m_wakeWriteFd = -1;
+            spdlog::error("Failed to create wakeup fd for RTSP server: {}", strerror(errno));
+            return false;
+        }
+        m_scheduler->setBackgroundHandling(m_wakeReadFd, SOCKET_READABLE, onWakeup, this);
 
         if (!m_address.empty())
         {
@@ -169,8 +495,26 @@ namespace pb
             return false;
         }
 
-        ServerMediaSession *sms = ServerMediaSession::createNew(*m_env, m_streamName.c_str(), "PixelBridge Live Stream", "H.264 streaming from PixelBridge");
-        sms->addSubsession(LiveH264Subsession::createNew(*m_env, m_packetQueue, m_queueMutex, m_queueCv, m_encoderCtx));
+        std::string description = std::string(m_codecId == AV_CODEC_ID_HEVC ? "H.265" : "H.264") + " streaming from PixelBridge";
+        ServerMediaSession *sms = ServerMediaSession::createNew(*m_env, m_streamName.c_str(), "PixelBridge Live Stream", description.c_str());
+        sms->addSubsession(LiveVideoSubsession::createNew(*m_env, m_video, m_codecId, m_videoTimeBase, estBitrateKbps, m_rateController.get()));
+        if (m_audioParams)
+        {
+            if (LiveAudioSubsession::isSupported(m_audioParams->codec_id))
+            {
+                sms->addSubsession(LiveAudioSubsession::createNew(*m_env, m_audio, m_audioParams, m_audioTimeBase));
+                m_hasAudio = true;
+                // 只有音视频需要互相对齐时才按 pts 打时间戳；纯视频 (屏幕采集、全速文件、保持帧等)
+                // 的 pts 会偏离实时，仍取送出时的系统时间，RTP / RTCP SR 时间才不会无限漂移
+                m_video.anchor = &m_anchor;
+                m_audio.anchor = &m_anchor;
+                spdlog::info("RTSP server passing through {} audio", avcodec_get_name(m_audioParams->codec_id));
+            }
+            else
+            {
+                spdlog::warn("RTSP server cannot packetize {} audio, serving video only", avcodec_get_name(m_audioParams->codec_id));
+            }
+        }
         m_rtspServer->addServerMediaSession(sms);
 
         char *url = m_rtspServer->rtspURL(sms);
@@ -183,11 +527,40 @@ namespace pb
         return true;
     }
 
+    void RtspServerFilter::setAudioStream(const AVCodecParameters *params, AVRational timeBase)
+    {
+        if (m_audioParams)
+            avcodec_parameters_free(&m_audioParams);
+        if (!params)
+            return;
+        m_audioParams = avcodec_parameters_alloc();
+        avcodec_parameters_copy(m_audioParams, params);
+        m_audioTimeBase = timeBase;
+    }
+
     void RtspServerFilter::process(DataPacket::Ptr packet)
     {
         if (!m_running || packet->type() != PacketType::AV_PACKET)
             return;
 
+        if (std::static_pointer_cast<AVPacketWrapper>(packet)->mediaType() == AVMEDIA_TYPE_AUDIO)
+        {
+            // 视频还要经过解码 / 编码，在第一个视频包到达前的音频没有可对齐的画面，直接丢弃
+            if (!m_hasAudio || !m_videoStarted)
+                return;
+            {
+                std::lock_guard<std::mutex> lock(m_audio.mutex);
+                while (m_audio.queue.size() >= kMaxAudioQueueSize)
+                {
+                    m_audio.queue.pop();
+                }
+                m_audio.queue.push(packet);
+            }
+            wakeEventLoop();
+            return;
+        }
+        m_videoStarted = true;
+
         static int packetLog = 0;
         if (++packetLog % 60 == 0)
         {
@@ -195,27 +568,68 @@ namespace pb
             spdlog::info("[RtspServerFilter] Received packet pts={}, size={}", pkt->pts, pkt->size);
         }
 
-        std::lock_guard<std::mutex> lock(m_queueMutex);
-        // 严格限制队列深度到 10 帧，约 0.3s 的缓冲。
-        // 超出时直接丢掉最旧的帧，确保内存不爆炸。
-        while (m_packetQueue.size() >= 10)
+        size_t depth = 0;
         {
-            m_packetQueue.pop();
+            std::lock_guard<std::mutex> lock(m_video.mutex);
+            // 严格限制队列深度到 10 帧，约 0.3s 的缓冲。
+            // 超出时直接丢掉最旧的帧，确保内存不爆炸。
+            while (m_video.queue.size() >= kMaxQueueSize)
+            {
+                m_video.queue.pop();
+            }
+            m_video.queue.push(packet);
+            depth = m_video.queue.size();
+        }
+        wakeEventLoop();
+
+        // 没有客户端时队列必然积满，那不是拥塞；有源在消费时入队后的深度就是它落后的帧数
+        if (m_rateController && m_video.liveSources > 0)
+        {
+            m_rateController->onQueueDepth(depth, kMaxQueueSize);
         }
-        m_packetQueue.push(packet);
-        m_queueCv.notify_one();
     }
 
     void RtspServerFilter::stop()
     {
         m_running = false;
         m_watchVariable = 1;
+        // 事件循环只在 select() 返回后检查 watch variable，没有周期节拍时需要主动唤醒
+        m_wakePending = false;
+        wakeEventLoop();
         if (m_serverThread.joinable())
         {
             m_serverThread.join();
         }
     }
 
+    void RtspServerFilter::wakeEventLoop()
+    {
+        if (m_wakeWriteFd < 0 || m_wakePending.exchange(true))
+            return;
+        signalWakeFd(m_wakeWriteFd);
+    }
+
+    void RtspServerFilter::onWakeup(void *clientData, int /*mask*/)
+    {
+        auto *self = static_cast<RtspServerFilter *>(clientData);
+        // 先清标记再读空 fd：之后入队的包一定会再写一次 fd
+        self->m_wakePending = false;
+        drainWakeFd(self->m_wakeReadFd);
+        deliverPending(self->m_video);
+        deliverPending(self->m_audio);
+    }
+
+    void RtspServerFilter::deliverPending(PacketChannel &channel)
+    {
+        // 遍历副本：deliver() 中下游可能同步关闭会话并销毁源
+        auto sources = channel.sources;
+        for (PacketSource *source : sources)
+        {
+            if (std::find(channel.sources.begin(), channel.sources.end(), source) != channel.sources.end())
+                source->deliver();
+        }
+    }
+
     void RtspServerFilter::serverLoop()
     {
         if (m_env)
@@ -0,0 +1,527 @@
+#include "filters/SegmentMuxer.h"
+#include <algorithm>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <spdlog/spdlog.h>
+
+extern "C"
+{
+#include <libavutil/opt.h>
+}
+
+namespace pb
+{
+    namespace
+    {
+        constexpr int kAvioBufferSize = 64 * 1024;
+        // 只有最近几个分片列出部分分片，更早的播放器已不会按部分请求
+        constexpr size_t kPartListSegments = 3;
+
+        uint32_t readBoxSize(const uint8_t *p)
+        {
+            return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+        }
+    }
+
+    SegmentMuxer::SegmentMuxer(const std::string &playlistPath)
+        : Filter("SegmentMuxer"), m_playlistPath(playlistPath)
+    {
+        std::filesystem::path path(playlistPath);
+        m_directory = path.has_parent_path() ? path.parent_path().string() : ".";
+        m_stem = path.stem().string();
+    }
+
+    SegmentMuxer::~SegmentMuxer()
+    {
+        stop();
+        if (m_writePacket)
+            av_packet_free(&m_writePacket);
+        if (m_audioParams)
+            avcodec_parameters_free(&m_audioParams);
+    }
+
+    void SegmentMuxer::setAudioStream(const AVCodecParameters *params, AVRational timeBase)
+    {
+        if (m_audioParams)
+            avcodec_parameters_free(&m_audioParams);
+        if (!params)
+            return;
+        m_audioParams = avcodec_parameters_alloc();
+        avcodec_parameters_copy(m_audioParams, params);
+        m_audioTimeBase = timeBase;
+    }
+
+    bool SegmentMuxer::initialize(AVCodecContext *encoderCtx)
+    {
+        // Standard 用常规 HLS 的 6s 分片；低延迟等级用 2s 分片加 LL-HLS 部分分片
+        if (m_segmentDuration <= 0.0)
+            m_segmentDuration = m_latencyLevel == LatencyLevel::Standard ? 6.0 : 2.0;
+        if (m_partDuration < 0.0)
+            m_partDuration = m_latencyLevel == LatencyLevel::UltraLow ? 0.2 : (m_latencyLevel == LatencyLevel::Low ? 0.5 : 0.0);
+        m_partDuration = std::min(m_partDuration, m_segmentDuration);
+        m_targetDuration = std::max(1, (int)std::ceil(m_segmentDuration - 1e-3));
+
+        std::error_code ec;
+        std::filesystem::create_directories(m_directory, ec);
+
+        const char *formatName = m_format == Format::FragmentedMp4 ? "mp4" : "mpegts";
+        if (avformat_alloc_output_context2(&m_formatCtx, nullptr, formatName, nullptr) < 0)
+        {
+            spdlog::error("[SegmentMuxer] Could not create {} context for {}", formatName, m_playlistPath);
+            return false;
+        }
+
+        m_videoStream = avformat_new_stream(m_formatCtx, nullptr);
+        if (!m_videoStream || avcodec_parameters_from_context(m_videoStream->codecpar, encoderCtx) < 0)
+        {
+            spdlog::error("[SegmentMuxer] Could not create video stream");
+            return false;
+        }
+        m_srcTimeBase = encoderCtx->time_base;
+        m_videoStream->time_base = m_srcTimeBase;
+        if (encoderCtx->gop_size > 0 && encoderCtx->gop_size * av_q2d(m_srcTimeBase) > m_targetDuration)
+        {
+            spdlog::warn("[SegmentMuxer] GOP ({} frames) is longer than the {}s target duration, some segments of {} will not start on a keyframe",
+                         encoderCtx->gop_size, m_targetDuration, m_playlistPath);
+        }
+
+        if (m_audioParams)
+        {
+            if (avformat_query_codec(m_formatCtx->oformat, m_audioParams->codec_id, FF_COMPLIANCE_NORMAL) == 0)
+            {
+                spdlog::warn("[SegmentMuxer] {} cannot carry {} audio, writing video only",
+                             formatName, avcodec_get_name(m_audioParams->codec_id));
+            }
+            else if ((m_audioStream = avformat_new_stream(m_formatCtx, nullptr)) != nullptr)
+            {
+                avcodec_parameters_copy(m_audioStream->codecpar, m_audioParams);
+                m_audioStream->codecpar->codec_tag = 0;
+                m_audioStream->time_base = m_audioTimeBase;
+            }
+        }
+        m_hasAudio = m_audioStream != nullptr;
+
+        // 封装结果先进内存，由写出线程在部分 / 分片边界一次写入文件
+        auto *buffer = static_cast<unsigned char *>(av_malloc(kAvioBufferSize));
+        if (!buffer)
+            return false;
+        m_formatCtx->pb = avio_alloc_context(buffer, kAvioBufferSize, 1, this, nullptr, &SegmentMuxer::writeCallback, nullptr);
+        if (!m_formatCtx->pb)
+        {
+            av_free(buffer);
+            return false;
+        }
+        m_formatCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+        AVDictionary *options = nullptr;
+        if (m_format == Format::FragmentedMp4)
+        {
+            // 每次 av_write_frame(nullptr) 切出一个 moof+mdat 片段，作为一个部分分片
+            av_dict_set(&options, "movflags", "frag_custom+empty_moov+delay_moov+default_base_moof", 0);
+        }
+        if (avformat_write_header(m_formatCtx, &options) < 0)
+        {
+            spdlog::error("[SegmentMuxer] Error writing header for {}", m_playlistPath);
+            av_dict_free(&options);
+            return false;
+        }
+        av_dict_free(&options);
+
+        m_writePacket = av_packet_alloc();
+
+        // 写磁盘允许约 3s 的积压，超出后清空并从下一个关键帧继续
+        double fps = m_srcTimeBase.num > 0 ? 1.0 / av_q2d(m_srcTimeBase) : 30.0;
+        m_queueCapacity = std::max<size_t>(4, (size_t)(fps * 3.0));
+
+        m_writerThread = std::thread(&SegmentMuxer::writerLoop, this);
+        spdlog::info("[SegmentMuxer] Writing {} segments to {} (segment {}s, part {}s, keep {})",
+                     m_format == Format::FragmentedMp4 ? "fMP4" : "TS", m_playlistPath,
+                     m_segmentDuration, m_partDuration, m_retention);
+        return true;
+    }
+
+    void SegmentMuxer::process(DataPacket::Ptr packet)
+    {
+        if (packet->type() != PacketType::AV_PACKET || m_aborting)
+            return;
+
+        auto pktWrapper = std::static_pointer_cast<AVPacketWrapper>(packet);
+        AVPacket *pkt = pktWrapper->get();
+        bool audio = pktWrapper->mediaType() == AVMEDIA_TYPE_AUDIO;
+        if (audio && !m_hasAudio)
+            return;
+        bool keyframe = !audio && (pkt->flags & AV_PKT_FLAG_KEY);
+        int64_t pts = pkt->pts;
+        int64_t dts = pkt->dts;
+
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            if (m_hasAudio)
+            {
+                // 与 Muxer 相同：两路以第一个视频包为共同零点
+                int64_t ts = dts != AV_NOPTS_VALUE ? dts : pts;
+                if (!audio && m_videoOrigin == AV_NOPTS_VALUE && ts != AV_NOPTS_VALUE)
+                {
+                    m_videoOrigin = ts;
+                    m_audioOrigin = av_rescale_q(ts, m_srcTimeBase, m_audioTimeBase);
+                }
+                int64_t origin = audio ? m_audioOrigin : m_videoOrigin;
+                if (origin == AV_NOPTS_VALUE || (audio && ts != AV_NOPTS_VALUE && ts < origin))
+                    return;
+                if (pts != AV_NOPTS_VALUE)
+                    pts -= origin;
+                if (dts != AV_NOPTS_VALUE)
+                    dts -= origin;
+            }
+
+            if (!audio)
+            {
+                if (m_queuedFrames >= m_queueCapacity)
+                {
+                    m_dropped += m_queue.size();
+                    m_queue.clear();
+                    m_queuedFrames = 0;
+                    m_waitKeyframe = true;
+                    spdlog::warn("[SegmentMuxer] Disk writes for {} fell behind, skipping to next keyframe", m_playlistPath);
+                }
+                if (m_waitKeyframe && !keyframe)
+                {
+                    m_dropped++;
+                    return;
+                }
+                m_waitKeyframe = false;
+                m_queuedFrames++;
+            }
+            else if (m_waitKeyframe)
+            {
+                return;
+            }
+
+            m_queue.push_back({pktWrapper, pts, dts, audio, keyframe});
+        }
+        m_queueCv.notify_one();
+    }
+
+    void SegmentMuxer::writerLoop()
+    {
+        while (true)
+        {
+            QueuedPacket item;
+            {
+                std::unique_lock<std::mutex> lock(m_queueMutex);
+                m_queueCv.wait(lock, [this]
+                               { return m_aborting || !m_queue.empty(); });
+                if (m_aborting && m_queue.empty())
+                    break;
+                item = std::move(m_queue.front());
+                m_queue.pop_front();
+                if (!item.audio)
+                    m_queuedFrames--;
+            }
+            writePacket(item);
+        }
+    }
+
+    void SegmentMuxer::writePacket(const QueuedPacket &item)
+    {
+        AVStream *stream = item.audio ? m_audioStream : m_videoStream;
+        int64_t ts = item.dts != AV_NOPTS_VALUE ? item.dts : item.pts;
+
+        if (!item.audio && ts != AV_NOPTS_VALUE)
+        {
+            double t = ts * av_q2d(m_srcTimeBase);
+            if (m_segmentOpen && t > m_lastVideoTime)
+                m_frameDuration = t - m_lastVideoTime;
+
+            bool boundary = false;
+            if (!m_segmentOpen)
+            {
+                openSegment(t);
+                boundary = true;
+            }
+            else if ((item.keyframe && t - m_segmentStart >= m_segmentDuration - 1e-3) ||
+                     t + m_frameDuration - m_segmentStart > m_targetDuration + 1e-3)
+            {
+                // 关键帧迟迟不来时，在加上这一帧就会超过 TARGETDURATION 处强制切开
+                flushPart(t);
+                closeSegment(t);
+                openSegment(t);
+                if (!item.keyframe)
+                    m_allIndependent = false;
+                boundary = true;
+            }
+            else if (m_partDuration > 0.0 && m_partHasData && t - m_partStart + m_frameDuration > m_partDuration + 1e-3)
+            {
+                // 加上这一帧会超过 PART-TARGET，先切出当前部分
+                flushPart(t);
+                boundary = true;
+            }
+            if (boundary)
+            {
+                // 部分分片总是在视频包处切开，它的第一个视频帧决定能否独立解码
+                m_partIndependent = item.keyframe;
+                if (m_partDuration > 0.0)
+                    writePlaylist(false);
+            }
+            m_lastVideoTime = t;
+        }
+        if (!m_segmentOpen || !stream)
+            return;
+
+        AVPacket *pkt = m_writePacket;
+        if (av_packet_ref(pkt, item.packet->get()) < 0)
+            return;
+        pkt->pts = item.pts;
+        pkt->dts = item.dts;
+        av_packet_rescale_ts(pkt, item.audio ? m_audioTimeBase : m_srcTimeBase, stream->time_base);
+        pkt->stream_index = stream->index;
+        // 各路包按到达顺序且各自单调，不需要 interleave 缓冲，部分边界处的数据也就完全确定
+        if (av_write_frame(m_formatCtx, pkt) < 0)
+            spdlog::error("[SegmentMuxer] Error writing packet to {}", m_current.fileName);
+        av_packet_unref(pkt);
+        m_partHasData = true;
+    }
+
+    void SegmentMuxer::openSegment(double startTime)
+    {
+        m_current = Segment{};
+        m_current.sequence = m_nextSequence++;
+        m_current.fileName = segmentFileName(m_current.sequence);
+        std::string path = (std::filesystem::path(m_directory) / m_current.fileName).string();
+        m_segmentFile = fopen(path.c_str(), "wb");
+        if (!m_segmentFile)
+            spdlog::error("[SegmentMuxer] Could not open segment {}: {}", path, strerror(errno));
+
+        if (m_format == Format::MpegTs)
+        {
+            // 每个 TS 分片都以 PAT/PMT 开头，才能独立解码
+            av_opt_set(m_formatCtx->priv_data, "mpegts_flags", "+resend_headers", 0);
+        }
+        m_segmentBytes = 0;
+        m_segmentStart = startTime;
+        m_partStart = startTime;
+        m_partHasData = false;
+        m_segmentOpen = true;
+    }
+
+    void SegmentMuxer::flushPart(double endTime)
+    {
+        if (!m_segmentOpen)
+            return;
+        // fMP4 在此切出一个片段；TS 则冲出复用器中尚未成包的 PES
+        av_write_frame(m_formatCtx, nullptr);
+        avio_flush(m_formatCtx->pb);
+        if (m_format == Format::FragmentedMp4 && !m_initWritten)
+            writeInitSegment();
+        if (m_pending.empty())
+            return;
+
+        if (m_segmentFile)
+        {
+            if (fwrite(m_pending.data(), 1, m_pending.size(), m_segmentFile) != m_pending.size())
+                spdlog::error("[SegmentMuxer] Short write to {}: {}", m_current.fileName, strerror(errno));
+            fflush(m_segmentFile);
+        }
+        m_current.parts.push_back({endTime - m_partStart, m_segmentBytes, (int64_t)m_pending.size(), m_partIndependent});
+        m_segmentBytes += (int64_t)m_pending.size();
+        m_bytes += m_pending.size();
+        m_partCount++;
+        m_pending.clear();
+        m_partStart = endTime;
+        m_partHasData = false;
+    }
+
+    void SegmentMuxer::writeInitSegment()
+    {
+        // 按顶层 box 查找第一个 moof，其之前的 ftyp + moov 写入初始化段
+        size_t offset = 0;
+        while (offset + 8 <= m_pending.size())
+        {
+            if (memcmp(m_pending.data() + offset + 4, "moof", 4) == 0)
+                break;
+            uint32_t size = readBoxSize(m_pending.data() + offset);
+            if (size < 8)
+                break;
+            offset += size;
+        }
+        if (offset == 0 || offset > m_pending.size())
+            return;
+
+        std::string path = (std::filesystem::path(m_directory) / (m_stem + "_init.mp4")).string();
+        if (FILE *file = fopen(path.c_str(), "wb"))
+        {
+            fwrite(m_pending.data(), 1, offset, file);
+            fclose(file);
+        }
+        else
+        {
+            spdlog::error("[SegmentMuxer] Could not write init segment {}: {}", path, strerror(errno));
+        }
+        m_bytes += offset;
+        m_pending.erase(m_pending.begin(), m_pending.begin() + offset);
+        m_initWritten = true;
+    }
+
+    void SegmentMuxer::closeSegment(double endTime)
+    {
+        if (!m_segmentOpen)
+            return;
+        if (m_segmentFile)
+        {
+            fclose(m_segmentFile);
+            m_segmentFile = nullptr;
+        }
+        m_current.duration = endTime - m_segmentStart;
+        m_segments.push_back(std::move(m_current));
+        m_segmentOpen = false;
+        m_segmentCount++;
+
+        while (m_retention > 0 && m_segments.size() > (size_t)m_retention)
+        {
+            std::error_code ec;
+            std::filesystem::remove(std::filesystem::path(m_directory) / m_segments.front().fileName, ec);
+            m_segments.pop_front();
+        }
+        writePlaylist(false);
+    }
+
+    std::string SegmentMuxer::segmentFileName(uint64_t sequence) const
+    {
+        return m_stem + "_" + std::to_string(sequence) + (m_format == Format::FragmentedMp4 ? ".m4s" : ".ts");
+    }
+
+    void SegmentMuxer::writePlaylist(bool ended)
+    {
+        bool lowLatency = m_partDuration > 0.0;
+
+        std::ostringstream out;
+        out.setf(std::ios::fixed);
+        out.precision(3);
+        out << "#EXTM3U\n";
+        out << "#EXT-X-VERSION:" << (m_format == Format::FragmentedMp4 ? 7 : (lowLatency ? 6 : 3)) << "\n";
+        out << "#EXT-X-TARGETDURATION:" << m_targetDuration << "\n";
+        if (lowLatency)
+        {
+            out << "#EXT-X-PART-INF:PART-TARGET=" << m_partDuration << "\n";
+            out << "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=" << m_partDuration * 3.0 << "\n";
+        }
+        if (m_retention == 0)
+            out << "#EXT-X-PLAYLIST-TYPE:EVENT\n";
+        out << "#EXT-X-MEDIA-SEQUENCE:" << (m_segments.empty() ? m_current.sequence : m_segments.front().sequence) << "\n";
+        if (m_allIndependent)
+            out << "#EXT-X-INDEPENDENT-SEGMENTS\n";
+        if (m_format == Format::FragmentedMp4)
+            out << "#EXT-X-MAP:URI=\"" << m_stem << "_init.mp4\"\n";
+
+        auto writeParts = [&](const Segment &segment)
+        {
+            for (const auto &part : segment.parts)
+            {
+                out << "#EXT-X-PART:DURATION=" << part.duration << ",URI=\"" << segment.fileName
+                    << "\",BYTERANGE=\"" << part.size << "@" << part.offset << "\"";
+                if (part.independent)
+                    out << ",INDEPENDENT=YES";
+                out << "\n";
+            }
+        };
+
+        for (size_t i = 0; i < m_segments.size(); i++)
+        {
+            const auto &segment = m_segments[i];
+            if (lowLatency && i + kPartListSegments >= m_segments.size())
+                writeParts(segment);
+            out << "#EXTINF:" << segment.duration << ",\n"
+                << segment.fileName << "\n";
+        }
+        // 进行中的分片只以部分分片的形式出现
+        if (lowLatency && m_segmentOpen && !ended)
+            writeParts(m_current);
+        if (ended)
+            out << "#EXT-X-ENDLIST\n";
+
+        // 先写临时文件再改名，HTTP 服务端不会读到写了一半的播放列表
+        std::string tmpPath = m_playlistPath + ".tmp";
+        FILE *file = fopen(tmpPath.c_str(), "wb");
+        if (!file)
+        {
+            spdlog::error("[SegmentMuxer] Could not write playlist {}: {}", tmpPath, strerror(errno));
+            return;
+        }
+        std::string text = out.str();
+        fwrite(text.data(), 1, text.size(), file);
+        fclose(file);
+        std::error_code ec;
+        std::filesystem::rename(tmpPath, m_playlistPath, ec);
+        if (ec)
+            spdlog::error("[SegmentMuxer] Could not replace playlist {}: {}", m_playlistPath, ec.message());
+    }
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+    int SegmentMuxer::writeCallback(void *opaque, const uint8_t *buf, int bufSize)
+#else
+    int SegmentMuxer::writeCallback(void *opaque, uint8_t *buf, int bufSize)
+#endif
+    {
+        auto *self = static_cast<SegmentMuxer *>(opaque);
+        self->m_pending.insert(self->m_pending.end(), buf, buf + bufSize);
+        return bufSize;
+    }
+
+    SegmentMuxer::Stats SegmentMuxer::stats() const
+    {
+        Stats s;
+        s.segments = m_segmentCount;
+        s.parts = m_partCount;
+        s.bytes = m_bytes;
+        s.dropped = m_dropped;
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        s.queued = m_queue.size();
+        return s;
+    }
+
+    void SegmentMuxer::requestStop()
+    {
+        // 与 Muxer 不同，这里是本地磁盘写入，已排队的包写完再退出，录制不丢尾
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_aborting = true;
+        }
+        m_queueCv.notify_all();
+    }
+
+    void SegmentMuxer::stop()
+    {
+        if (m_writerThread.joinable())
+        {
+            requestStop();
+            m_writerThread.join();
+        }
+        if (!m_formatCtx)
+            return;
+
+        if (m_segmentOpen)
+        {
+            double end = m_lastVideoTime + m_frameDuration;
+            flushPart(end);
+            closeSegment(end);
+        }
+        if (m_nextSequence > 0)
+            writePlaylist(true);
+
+        // 片段已手动切出，不写 mp4 尾部 (mfra)，分片文件保持可独立播放
+        if (m_formatCtx->pb)
+        {
+            av_freep(&m_formatCtx->pb->buffer);
+            avio_context_free(&m_formatCtx->pb);
+        }
+        avformat_free_context(m_formatCtx);
+        m_formatCtx = nullptr;
+        m_videoStream = nullptr;
+        m_audioStream = nullptr;
+        spdlog::info("[SegmentMuxer] Finished {} ({} segments)", m_playlistPath, m_segmentCount.load());
+    }
+
+} // namespace pb
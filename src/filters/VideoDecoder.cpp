@@ -1,11 +1,58 @@
 #include "filters/VideoDecoder.h"
+#include <algorithm>
 #include <iostream>
+#include <thread>
 #include <spdlog/spdlog.h>
 
-namespace pb
+namespace
 {
+    // 进入降级的落后阈值 (秒)；低于一半并保持 kRecoverHold 后逐级恢复
+    double shedThreshold(pb::LatencyLevel level)
+    {
+        switch (level)
+        {
+        case pb::LatencyLevel::UltraLow:
+            return 0.15;
+        case pb::LatencyLevel::Low:
+            return 0.3;
+        default:
+            return 0.8;
+        }
+    }
+
+    void setDiscard(AVCodecContext *ctx, pb::VideoDecoder::ShedLevel level)
+    {
+        using ShedLevel = pb::VideoDecoder::ShedLevel;
+        switch (level)
+        {
+        case ShedLevel::None:
+            ctx->skip_frame = AVDISCARD_DEFAULT;
+            ctx->skip_loop_filter = AVDISCARD_DEFAULT;
+            break;
+        case ShedLevel::NonRef:
+            ctx->skip_frame = AVDISCARD_NONREF;
+            ctx->skip_loop_filter = AVDISCARD_NONREF;
+            break;
+        case ShedLevel::Bidir:
+            ctx->skip_frame = AVDISCARD_BIDIR;
+            ctx->skip_loop_filter = AVDISCARD_ALL;
+            break;
+        case ShedLevel::NonKey:
+            ctx->skip_frame = AVDISCARD_NONKEY;
+            ctx->skip_loop_filter = AVDISCARD_ALL;
+            break;
+        }
+    }
 
-    static enum AVPixelFormat g_hw_pix_fmt = AV_PIX_FMT_NONE;
+    constexpr auto kEscalateInterval = std::chrono::milliseconds(500);
+    constexpr auto kRecoverHold = std::chrono::seconds(2);
+    // 积压基线每秒最多上浮 1ms：足以跟随源端与本地时钟的漂移 (通常 < 0.1ms/s)，
+    // 而真实的积压增长远快于此，不会被基线吸收
+    constexpr double kBaselineDrift = 0.001;
+}
+
+namespace pb
+{
 
     VideoDecoder::VideoDecoder(AVCodecParameters *params, const std::string &hwTypeName)
         : Filter("VideoDecoder"), m_codecParams(params)
@@ -43,10 +90,12 @@ namespace pb
 
     enum AVPixelFormat VideoDecoder::get_hw_format(AVCodecContext *ctx, const enum AVPixelFormat *pix_fmts)
     {
+        // 每个解码器实例通过 opaque 取回自己协商的硬件格式，多路解码互不干扰
+        auto *self = static_cast<VideoDecoder *>(ctx->opaque);
         const enum AVPixelFormat *p;
         for (p = pix_fmts; *p != -1; p++)
         {
-            if (*p == g_hw_pix_fmt)
+            if (self && *p == self->m_hwPixFmt)
                 return *p;
         }
         spdlog::error("Failed to get HW surface format.");
@@ -88,12 +137,35 @@ namespace pb
                 if (config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX &&
                     config->device_type == m_hwType)
                 {
-                    g_hw_pix_fmt = config->pix_fmt;
+                    m_hwPixFmt = config->pix_fmt;
                     break;
                 }
             }
         }
 
+        if (m_hwType != AV_HWDEVICE_TYPE_NONE)
+        {
+            if (init_hw_decoder(m_hwType))
+            {
+                spdlog::info("Hardware acceleration initialized: {}", av_hwdevice_get_type_name(m_hwType));
+            }
+        }
+        else
+        {
+            spdlog::info("Using software decoding for {}", m_codec->name);
+        }
+
+        // 首个关键帧之前不知道每帧的 slice 数，先按单 slice 估计
+        return openCodec(resolveThreading(1));
+    }
+
+    bool VideoDecoder::openCodec(const ThreadingChoice &choice)
+    {
+        if (m_codecCtx)
+        {
+            avcodec_free_context(&m_codecCtx);
+        }
+
         m_codecCtx = avcodec_alloc_context3(m_codec);
         if (!m_codecCtx)
         {
@@ -107,37 +179,32 @@ namespace pb
             return false;
         }
 
-        if (m_hwType != AV_HWDEVICE_TYPE_NONE)
-        {
-            if (init_hw_decoder(m_hwType))
-            {
-                m_codecCtx->hw_device_ctx = av_buffer_ref(m_hwDeviceCtx);
-                m_codecCtx->get_format = get_hw_format;
-                spdlog::info("Hardware acceleration initialized: {}", av_hwdevice_get_type_name(m_hwType));
-            }
-        }
-        else
+        if (m_hwDeviceCtx)
         {
-            spdlog::info("Using software decoding for {}", m_codec->name);
+            m_codecCtx->hw_device_ctx = av_buffer_ref(m_hwDeviceCtx);
+            m_codecCtx->opaque = this;
+            m_codecCtx->get_format = get_hw_format;
         }
 
         // 根据延迟等级配置解码器
-        if (m_latencyLevel == LatencyLevel::UltraLow)
+        // 注意 LOW_DELAY 会让 FFmpeg 禁用帧线程，因此只在未选择帧线程时设置
+        bool frameThreads = choice.threadType & FF_THREAD_FRAME;
+        if (m_latencyLevel != LatencyLevel::Standard && !frameThreads)
         {
             m_codecCtx->flags |= AV_CODEC_FLAG_LOW_DELAY;
-            m_codecCtx->flags2 |= AV_CODEC_FLAG2_FAST;
-            m_codecCtx->thread_count = 1; // 禁用多线程解码以消除线程间同步延迟
         }
-        else if (m_latencyLevel == LatencyLevel::Low)
-        {
-            m_codecCtx->flags |= AV_CODEC_FLAG_LOW_DELAY;
-            m_codecCtx->thread_count = 0; // 自动线程数
-        }
-        else
+        if (m_latencyLevel == LatencyLevel::UltraLow)
         {
-            m_codecCtx->thread_count = 0; // 标准模式，优先考虑吞吐量
+            m_codecCtx->flags2 |= AV_CODEC_FLAG2_FAST;
         }
 
+        m_codecCtx->thread_type = choice.threadType;
+        m_codecCtx->thread_count = choice.threadCount;
+        m_threading = choice;
+
+        // 重新打开时保留当前的降级设置
+        setDiscard(m_codecCtx, m_shedLevel);
+
         AVDictionary *options = nullptr;
         if (m_latencyLevel != LatencyLevel::Standard)
         {
@@ -154,15 +221,165 @@ namespace pb
         if (options)
             av_dict_free(&options);
 
+        spdlog::info("[VideoDecoder] {} threading: type={}, count={} (active type={}, slices={})",
+                     m_codec->name, choice.threadType, choice.threadCount,
+                     m_codecCtx->active_thread_type, m_slicesPerFrame);
         return true;
     }
 
+    VideoDecoder::ThreadingChoice VideoDecoder::resolveThreading(int slicesPerFrame) const
+    {
+        int cores = std::max(1, (int)std::thread::hardware_concurrency());
+        int64_t pixels = (int64_t)m_codecParams->width * m_codecParams->height;
+
+        ThreadingProfile profile = m_threadingProfile;
+        if (profile == ThreadingProfile::Auto)
+        {
+            if (m_hwDeviceCtx)
+            {
+                // 硬件解码不依赖 CPU 线程，帧线程只会额外引入延迟
+                profile = ThreadingProfile::Single;
+            }
+            else if (m_latencyLevel == LatencyLevel::Standard)
+            {
+                profile = ThreadingProfile::FrameSlice;
+            }
+            else if (slicesPerFrame > 1)
+            {
+                // 多 slice 码流：slice 线程没有额外帧延迟
+                profile = ThreadingProfile::Slice;
+            }
+            else if (pixels >= 3840 * 2160 || (m_latencyLevel == LatencyLevel::Low && pixels >= 1920 * 1080))
+            {
+                // 单 slice 的大分辨率流单线程跟不上，用少量帧线程换吞吐
+                profile = ThreadingProfile::Frame;
+            }
+            else
+            {
+                profile = ThreadingProfile::Single;
+            }
+        }
+
+        ThreadingChoice choice;
+        choice.profile = profile;
+        switch (profile)
+        {
+        case ThreadingProfile::Single:
+            choice.threadType = FF_THREAD_SLICE;
+            choice.threadCount = 1;
+            break;
+        case ThreadingProfile::Slice:
+            choice.threadType = FF_THREAD_SLICE;
+            choice.threadCount = m_threadCount > 0 ? m_threadCount : std::min(cores, std::max(slicesPerFrame, 2));
+            break;
+        case ThreadingProfile::Frame:
+            // 每多一个帧线程多一帧延迟：UltraLow 只允许 1 帧，Low 允许 2 帧
+            choice.threadType = FF_THREAD_FRAME;
+            choice.threadCount = m_threadCount > 0 ? m_threadCount
+                                                   : std::min(cores, m_latencyLevel == LatencyLevel::UltraLow ? 2 : 3);
+            break;
+        case ThreadingProfile::FrameSlice:
+        case ThreadingProfile::Auto:
+            choice.threadType = FF_THREAD_FRAME | FF_THREAD_SLICE;
+            choice.threadCount = m_threadCount > 0 ? m_threadCount : 0;
+            break;
+        }
+        return choice;
+    }
+
+    void VideoDecoder::setThreadingProfile(ThreadingProfile profile, int threadCount)
+    {
+        m_threadingProfile = profile;
+        m_threadCount = threadCount;
+    }
+
+    void VideoDecoder::updateThreading(const AVPacket *pkt)
+    {
+        m_threadingProbed = true;
+        m_slicesPerFrame = countSlices(pkt);
+        if (m_slicesPerFrame <= 0)
+            return;
+
+        ThreadingChoice choice = resolveThreading(m_slicesPerFrame);
+        if (choice.threadType == m_threading.threadType && choice.threadCount == m_threading.threadCount)
+            return;
+
+        // 在关键帧处重开解码器不会丢失参考帧
+        spdlog::info("[VideoDecoder] Stream has {} slice(s) per frame, reopening decoder", m_slicesPerFrame);
+        if (!openCodec(choice))
+        {
+            spdlog::error("[VideoDecoder] Failed to reopen decoder with new threading profile");
+        }
+    }
+
+    int VideoDecoder::countSlices(const AVPacket *pkt) const
+    {
+        AVCodecID id = m_codecParams->codec_id;
+        if (id != AV_CODEC_ID_H264 && id != AV_CODEC_ID_HEVC)
+            return 0;
+
+        const uint8_t *data = pkt->data;
+        int size = pkt->size;
+        const uint8_t *extra = m_codecParams->extradata;
+        int extraSize = m_codecParams->extradata_size;
+
+        auto isSlice = [id](const uint8_t *nal)
+        {
+            if (id == AV_CODEC_ID_H264)
+            {
+                int type = nal[0] & 0x1f;
+                return type == 1 || type == 5;
+            }
+            // HEVC：VCL NAL (0-9, 16-21) 各对应一个 slice segment
+            int type = (nal[0] >> 1) & 0x3f;
+            return type <= 9 || (type >= 16 && type <= 21);
+        };
+
+        int slices = 0;
+        // avcC / hvcC (MP4 等容器)：长度前缀格式
+        bool lengthPrefixed = extra && extraSize > 0 && extra[0] == 1;
+        if (lengthPrefixed)
+        {
+            int lengthSize = 4;
+            if (id == AV_CODEC_ID_H264 && extraSize > 4)
+                lengthSize = (extra[4] & 0x3) + 1;
+            else if (id == AV_CODEC_ID_HEVC && extraSize > 21)
+                lengthSize = (extra[21] & 0x3) + 1;
+
+            int pos = 0;
+            while (pos + lengthSize < size)
+            {
+                uint32_t nalSize = 0;
+                for (int i = 0; i < lengthSize; i++)
+                    nalSize = (nalSize << 8) | data[pos + i];
+                pos += lengthSize;
+                if (nalSize == 0 || pos + (int64_t)nalSize > size)
+                    break;
+                if (isSlice(data + pos))
+                    slices++;
+                pos += nalSize;
+            }
+            return slices;
+        }
+
+        // Annex B：按起始码切分
+        for (int i = 0; i + 3 < size; i++)
+        {
+            if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)
+            {
+                if (isSlice(data + i + 3))
+                    slices++;
+                i += 2;
+            }
+        }
+        return slices;
+    }
+
     void VideoDecoder::process(DataPacket::Ptr packet)
     {
         if (packet->type() == PacketType::AV_FRAME)
         {
-            static int passLog = 0;
-            if (++passLog % 60 == 0)
+            if (++m_passLog % 60 == 0)
             {
                 spdlog::info("[VideoDecoder] Direct pass-through for frame (already decoded/raw)");
             }
@@ -175,6 +392,17 @@ namespace pb
             return;
 
         auto pktWrapper = std::static_pointer_cast<AVPacketWrapper>(packet);
+        if (m_loadShedding)
+        {
+            updateLag(pktWrapper->get());
+        }
+
+        if (!m_threadingProbed && (pktWrapper->get()->flags & AV_PKT_FLAG_KEY))
+        {
+            updateThreading(pktWrapper->get());
+        }
+
+        m_packetsIn++;
         int ret = avcodec_send_packet(m_codecCtx, pktWrapper->get());
         if (ret < 0)
         {
@@ -196,11 +424,12 @@ namespace pb
                 return;
             }
 
+            m_framesOut++;
             AVFrame *finalFrame = frameWrapper->get();
             DataPacket::Ptr outputPacket = frameWrapper;
 
             // If it's a HW frame, we might need to transfer it to CPU for simple Sinks
-            if (finalFrame->format == g_hw_pix_fmt)
+            if (m_hwPixFmt != AV_PIX_FMT_NONE && finalFrame->format == m_hwPixFmt)
             {
                 auto swFrameWrapper = std::make_shared<AVFrameWrapper>();
                 if (av_hwframe_transfer_data(swFrameWrapper->get(), finalFrame, 0) < 0)
@@ -219,6 +448,113 @@ namespace pb
                 m_next->process(outputPacket);
             }
         }
+
+        // 帧线程下输出天然比送入滞后若干包：以完整解码时 "送入 - 输出" 的差为基线，
+        // 降级期间超出基线的部分才是被 skip_frame 丢弃的包
+        int64_t deficit = (int64_t)m_packetsIn - (int64_t)m_framesOut;
+        if (m_shedLevel == ShedLevel::None)
+        {
+            m_decodeDelay = deficit;
+        }
+        else if (deficit > m_decodeDelay)
+        {
+            m_skipped += deficit - m_decodeDelay;
+            m_decodeDelay = deficit;
+        }
+    }
+
+    void VideoDecoder::updateLag(const AVPacket *pkt)
+    {
+        AVRational tb = m_timeBase.num > 0 ? m_timeBase : pkt->time_base;
+        int64_t ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+        if (tb.num <= 0 || tb.den <= 0 || ts == AV_NOPTS_VALUE)
+            return;
+
+        auto now = std::chrono::steady_clock::now();
+
+        // 时间戳回退或大幅跳变 (循环播放、流重启) 时重建基线
+        if (m_clockValid)
+        {
+            double step = (ts - m_lastTs) * av_q2d(tb);
+            if (step < -1.0 || step > 10.0)
+            {
+                m_clockValid = false;
+            }
+        }
+        if (!m_clockValid)
+        {
+            m_clockValid = true;
+            m_firstTs = ts;
+            m_clockStart = now;
+            m_minOffset = 0.0;
+            m_lastLagUpdate = now;
+            m_lastLevelChange = now;
+            m_belowSince = now;
+        }
+        m_lastTs = ts;
+
+        // 墙钟与媒体时间之差减去历史最小值即为积压：整条链路同步调用，
+        // 下游 (编码、推流) 变慢同样会体现在这里
+        double wall = std::chrono::duration<double>(now - m_clockStart).count();
+        double media = (ts - m_firstTs) * av_q2d(tb);
+        double offset = wall - media;
+        double dt = std::chrono::duration<double>(now - m_lastLagUpdate).count();
+        m_lastLagUpdate = now;
+        if (offset < m_minOffset)
+            m_minOffset = offset;
+        else
+            m_minOffset += std::min(offset - m_minOffset, kBaselineDrift * dt);
+        double lag = offset - m_minOffset;
+        m_lagMs = lag * 1000.0;
+        m_statLag = m_lagMs;
+
+        double threshold = shedThreshold(m_latencyLevel);
+        if (lag > threshold)
+        {
+            m_belowSince = now;
+            // 当前级别生效后仍未追回时才继续升级
+            if (m_shedLevel != ShedLevel::NonKey && now - m_lastLevelChange >= kEscalateInterval && m_lagMs >= m_lagAtChange)
+            {
+                applyShedLevel((ShedLevel)((int)m_shedLevel + 1));
+            }
+        }
+        else if (lag < threshold / 2)
+        {
+            if (m_shedLevel != ShedLevel::None && now - m_belowSince >= kRecoverHold)
+            {
+                applyShedLevel((ShedLevel)((int)m_shedLevel - 1));
+                m_belowSince = now;
+            }
+        }
+        else
+        {
+            m_belowSince = now;
+        }
+    }
+
+    void VideoDecoder::applyShedLevel(ShedLevel level)
+    {
+        setDiscard(m_codecCtx, level);
+
+        spdlog::info("[VideoDecoder] Load shedding level {} -> {} (lag {:.0f} ms, skipped {})",
+                     (int)m_shedLevel, (int)level, m_lagMs, m_skipped.load());
+        m_shedLevel = level;
+        m_statLevel = (int)level;
+        m_lagAtChange = m_lagMs;
+        m_lastLevelChange = std::chrono::steady_clock::now();
+        m_levelChanges++;
+    }
+
+    VideoDecoder::Stats VideoDecoder::stats() const
+    {
+        Stats s;
+        s.level = (ShedLevel)m_statLevel.load();
+        s.lagMs = m_statLag;
+        s.packets = m_packetsIn;
+        s.frames = m_framesOut;
+        s.skippedFrames = m_skipped;
+        s.levelChanges = m_levelChanges;
+        return s;
     }
 
     void VideoDecoder::stop()
@@ -1,9 +1,12 @@
 #include "filters/VideoEncoder.h"
+#include <algorithm>
+#include <array>
 #include <spdlog/spdlog.h>
 
 extern "C"
 {
 #include <libavutil/pixdesc.h>
+#include <libavutil/imgutils.h>
 }
 
 namespace pb
@@ -89,6 +92,23 @@ namespace pb
     }
 
     bool VideoEncoder::initialize(int width, int height, int fps)
+    {
+        m_width = width;
+        m_height = height;
+        m_fps = fps > 0 ? fps : 30;
+        m_outputFps = m_fps;
+        m_fpsAccumulator = m_fps;
+
+        // 码率控制：标准模式允许更高质量
+        if (m_bitRate <= 0)
+        {
+            m_bitRate = (m_latencyLevel == LatencyLevel::Standard) ? 8000000 : 4000000; // 8 / 4 Mbps
+        }
+
+        return openCodec();
+    }
+
+    bool VideoEncoder::openCodec()
     {
         m_codec = avcodec_find_encoder_by_name(m_codecName.c_str());
         if (!m_codec)
@@ -104,20 +124,20 @@ namespace pb
             return false;
         }
 
-        m_codecCtx->width = width;
-        m_codecCtx->height = height;
-        m_codecCtx->time_base = {1, fps};
-        m_codecCtx->framerate = {fps, 1};
+        m_codecCtx->width = m_width;
+        m_codecCtx->height = m_height;
+        // time_base 始终跟随输入帧率，保证下游 (Muxer / RTSP) 的时间基在重配置后不变
+        m_codecCtx->time_base = {1, m_fps};
+        m_codecCtx->framerate = {m_outputFps, 1};
+        m_codecCtx->bit_rate = m_bitRate;
+        m_profiler.setFrameInterval(1000.0 / m_outputFps);
 
-        // 码率控制：标准模式允许更高质量
         if (m_latencyLevel == LatencyLevel::Standard)
         {
-            m_codecCtx->bit_rate = 8000000; // 8 Mbps
             m_codecCtx->gop_size = 60;
         }
         else
         {
-            m_codecCtx->bit_rate = 4000000; // 4 Mbps
             m_codecCtx->gop_size = (m_latencyLevel == LatencyLevel::UltraLow) ? 10 : 30;
         }
 
@@ -163,7 +183,36 @@ namespace pb
             {
                 av_dict_set(&options, "preset", "medium", 0);
             }
-            av_dict_set(&options, "x264-params", "repeat-headers=1:nal-hrd=cbr:force-cfr=1", 0);
+
+            std::string x264Params = "repeat-headers=1:nal-hrd=cbr:force-cfr=1";
+            if (m_contentType == ContentType::Screen)
+            {
+                // 屏幕内容：关闭 AQ 与心理视觉优化（它们会把码率浪费在平坦区域），
+                // 减弱去块滤波保留文字边缘，增加参考帧以利用大面积静止内容
+                av_dict_set(&options, "tune", m_latencyLevel == LatencyLevel::Standard ? "stillimage" : "stillimage,zerolatency", 0);
+                x264Params += ":aq-mode=0:psy=0:deblock=-1,-1";
+                x264Params += (m_latencyLevel == LatencyLevel::UltraLow) ? ":ref=2" : ":ref=4";
+            }
+            av_dict_set(&options, "x264-params", x264Params.c_str(), 0);
+        }
+        else if (m_codecName == "libx265")
+        {
+            if (m_latencyLevel == LatencyLevel::UltraLow)
+            {
+                av_dict_set(&options, "preset", "ultrafast", 0);
+                av_dict_set(&options, "tune", "zerolatency", 0);
+            }
+            else if (m_latencyLevel == LatencyLevel::Low)
+            {
+                av_dict_set(&options, "preset", "superfast", 0);
+                av_dict_set(&options, "tune", "zerolatency", 0);
+            }
+            else
+            {
+                av_dict_set(&options, "preset", "fast", 0);
+            }
+            // 与 x264 相同：每个 IDR 前重复 VPS/SPS/PPS，RTSP 客户端可随时加入
+            av_dict_set(&options, "x265-params", "repeat-headers=1:bframes=0:log-level=error", 0);
         }
         else if (m_codecName.find("nvenc") != std::string::npos)
         {
@@ -188,11 +237,24 @@ namespace pb
             av_dict_set(&options, "repeat_headers", "1", 0);
         }
 
+        if (!m_preset.empty())
+        {
+            av_dict_set(&options, "preset", m_preset.c_str(), 0);
+        }
+        if (m_threadCount > 0)
+        {
+            m_codecCtx->thread_count = m_threadCount;
+        }
+
         if (avcodec_open2(m_codecCtx, m_codec, &options) < 0)
         {
             spdlog::error("Could not open encoder");
+            if (options)
+                av_dict_free(&options);
             return false;
         }
+        if (options)
+            av_dict_free(&options);
 
         return true;
     }
@@ -205,6 +267,42 @@ namespace pb
         auto frameWrapper = std::static_pointer_cast<AVFrameWrapper>(packet);
         AVFrame *frame = frameWrapper->get();
 
+        applyPendingConfig();
+        if (m_contentAdaptive)
+        {
+            analyzeContent(frame);
+        }
+
+        if (m_sourceTimeBase.num <= 0 && m_inputTimeBase.num > 0 && frame->pts != AV_NOPTS_VALUE)
+        {
+            // 相邻输入帧间隔超过一帧说明上游丢了帧，序号跟着跳过；回退或过大的跳变 (循环、流重启) 不计
+            if (m_lastInputPts != AV_NOPTS_VALUE)
+            {
+                int64_t gap = av_rescale_q(frame->pts - m_lastInputPts, m_inputTimeBase, m_codecCtx->time_base);
+                if (gap > 1 && gap <= (int64_t)m_fps * 10)
+                    m_pts += gap - 1;
+            }
+            m_lastInputPts = frame->pts;
+        }
+
+        // 时间戳按输入帧序号计算；输出帧率低于输入帧率时按比例丢帧，时间轴保持连续
+        int64_t framePts = m_pts++;
+        if (m_outputFps < m_fps)
+        {
+            m_fpsAccumulator += m_outputFps;
+            if (m_fpsAccumulator < m_fps)
+                return;
+            m_fpsAccumulator -= m_fps;
+        }
+        if (m_sourceTimeBase.num > 0 && frame->pts != AV_NOPTS_VALUE)
+        {
+            // 换算到 1/fps 后可能与上一帧落在同一格，保持严格递增
+            framePts = av_rescale_q(frame->pts, m_sourceTimeBase, m_codecCtx->time_base);
+            if (m_lastSourcePts != AV_NOPTS_VALUE && framePts <= m_lastSourcePts)
+                framePts = m_lastSourcePts + 1;
+            m_lastSourcePts = framePts;
+        }
+
         static int inputLog = 0;
         if (++inputLog % 60 == 0)
         {
@@ -221,31 +319,32 @@ namespace pb
 
         if (frame->format != targetSwFormat && frame->format != m_codecCtx->pix_fmt)
         {
-            swFrameWrapper = std::make_shared<AVFrameWrapper>();
-            AVFrame *swFrame = swFrameWrapper->get();
-            swFrame->format = targetSwFormat;
-            swFrame->width = frame->width;
-            swFrame->height = frame->height;
-            if (av_frame_get_buffer(swFrame, 32) < 0)
+            swFrameWrapper = acquireConversionFrame(targetSwFormat, frame->width, frame->height);
+            if (!swFrameWrapper)
             {
                 spdlog::error("[VideoEncoder] Failed to allocate alignment buffer");
                 return;
             }
+            AVFrame *swFrame = swFrameWrapper->get();
 
-            if (!m_swsContext || m_swsWidth != frame->width || m_swsHeight != frame->height || m_swsInFmt != frame->format || m_swsOutFmt != targetSwFormat)
+            if (!convertFastPath(frame, swFrame))
             {
-                if (m_swsContext)
-                    sws_freeContext(m_swsContext);
-                m_swsContext = sws_getContext(frame->width, frame->height, (AVPixelFormat)frame->format,
-                                              frame->width, frame->height, targetSwFormat,
-                                              SWS_BILINEAR, nullptr, nullptr, nullptr);
-                m_swsWidth = frame->width;
-                m_swsHeight = frame->height;
-                m_swsInFmt = (AVPixelFormat)frame->format;
-                m_swsOutFmt = targetSwFormat;
-                spdlog::info("[VideoEncoder] Initialized SwsContext: {}x{} {} -> {}", m_swsWidth, m_swsHeight, av_get_pix_fmt_name(m_swsInFmt), av_get_pix_fmt_name(m_swsOutFmt));
+                if (!m_swsContext || m_swsWidth != frame->width || m_swsHeight != frame->height || m_swsInFmt != frame->format || m_swsOutFmt != targetSwFormat)
+                {
+                    if (m_swsContext)
+                        sws_freeContext(m_swsContext);
+                    // 尺寸不变，但 RGB / 4:4:4 -> 4:2:0 需要色度下采样，最近邻会在文字和界面边缘产生色边
+                    m_swsContext = sws_getContext(frame->width, frame->height, (AVPixelFormat)frame->format,
+                                                  frame->width, frame->height, targetSwFormat,
+                                                  SWS_BILINEAR, nullptr, nullptr, nullptr);
+                    m_swsWidth = frame->width;
+                    m_swsHeight = frame->height;
+                    m_swsInFmt = (AVPixelFormat)frame->format;
+                    m_swsOutFmt = targetSwFormat;
+                    spdlog::info("[VideoEncoder] Initialized SwsContext: {}x{} {} -> {}", m_swsWidth, m_swsHeight, av_get_pix_fmt_name(m_swsInFmt), av_get_pix_fmt_name(m_swsOutFmt));
+                }
+                sws_scale(m_swsContext, frame->data, frame->linesize, 0, frame->height, swFrame->data, swFrame->linesize);
             }
-            sws_scale(m_swsContext, frame->data, frame->linesize, 0, frame->height, swFrame->data, swFrame->linesize);
             swFrame->pts = frame->pts;
             encodingFrame = swFrame;
         }
@@ -259,12 +358,15 @@ namespace pb
                 spdlog::warn("[VideoEncoder] Resolution changed from {}x{} to {}x{}. Re-initializing...",
                              m_codecCtx->width, m_codecCtx->height, encodingFrame->width, encodingFrame->height);
 
-                int savedFps = m_codecCtx->framerate.num;
                 avcodec_free_context(&m_codecCtx);
                 if (m_hwFramesCtx)
                     av_buffer_unref(&m_hwFramesCtx);
+                if (m_hwDeviceCtx)
+                    av_buffer_unref(&m_hwDeviceCtx);
 
-                if (!initialize(encodingFrame->width, encodingFrame->height, savedFps))
+                m_width = encodingFrame->width;
+                m_height = encodingFrame->height;
+                if (!openCodec())
                 {
                     spdlog::error("[VideoEncoder] Re-initialization failed!");
                     return;
@@ -296,8 +398,9 @@ namespace pb
             encodingFrame = hwFrame;
         }
 
-        encodingFrame->pts = m_pts++;
+        encodingFrame->pts = framePts;
 
+        m_profiler.onFrameSent(framePts);
         int ret = avcodec_send_frame(m_codecCtx, encodingFrame);
         if (ret < 0)
         {
@@ -319,6 +422,12 @@ namespace pb
                 return;
             }
 
+            m_profiler.onPacket(pktWrapper->get());
+            if (pktWrapper->get()->flags & AV_PKT_FLAG_KEY)
+                m_framesSinceKeyframe = 0;
+            else
+                m_framesSinceKeyframe++;
+
             if (m_next)
             {
                 m_next->process(pktWrapper);
@@ -326,6 +435,291 @@ namespace pb
         }
     }
 
+    void VideoEncoder::setContentAdaptive(bool enabled, ContentType hint)
+    {
+        // 两套配置目前只针对 libx264 的参数
+        m_contentAdaptive = enabled && m_codecName == "libx264";
+        m_contentType = hint;
+        m_pendingContent = hint;
+        m_classifier.reset(hint);
+    }
+
+    void VideoEncoder::analyzeContent(const AVFrame *frame)
+    {
+        // 只对首平面为亮度的软件帧分析，每 5 帧采样一次
+        if (frame->format != AV_PIX_FMT_YUV420P && frame->format != AV_PIX_FMT_YUVJ420P &&
+            frame->format != AV_PIX_FMT_NV12)
+            return;
+        if (m_analyzedFrames++ % 5 == 0)
+            m_pendingContent = m_classifier.analyze(frame->data[0], frame->linesize[0], frame->width, frame->height);
+
+        ContentType detected = m_pendingContent;
+        if (detected == m_contentType || !m_codecCtx)
+            return;
+
+        // 检测结果先记下，等到任意一帧到达 GOP 边界时再切换，新编码器的 IDR 替代原本的关键帧
+        if (m_framesSinceKeyframe + 1 < m_codecCtx->gop_size)
+            return;
+
+        const auto &st = m_classifier.lastStats();
+        ContentType previous = m_contentType;
+        m_contentType = detected;
+        if (swapEncoder())
+        {
+            spdlog::info("[VideoEncoder] Content switched to {} (motion={:.1f}, flat={:.2f}, edge={:.1f}, top={:.2f})",
+                         detected == ContentType::Screen ? "screen" : "natural", st.motion, st.flat, st.edge, st.topMass);
+        }
+        else
+        {
+            // 切换失败时放弃这次检测结果，避免此后每帧重试
+            m_contentType = previous;
+            m_pendingContent = previous;
+        }
+    }
+
+    std::shared_ptr<AVFrameWrapper> VideoEncoder::acquireConversionFrame(AVPixelFormat format, int width, int height)
+    {
+        // 复用编码器和下游都不再引用的转换帧；编码器仍持有引用时 av_frame_is_writable 返回 false
+        for (auto &wrapper : m_conversionPool)
+        {
+            AVFrame *f = wrapper->get();
+            if (wrapper.use_count() == 1 && f->format == format && f->width == width && f->height == height &&
+                av_frame_is_writable(f))
+                return wrapper;
+        }
+
+        auto wrapper = std::make_shared<AVFrameWrapper>();
+        AVFrame *f = wrapper->get();
+        f->format = format;
+        f->width = width;
+        f->height = height;
+        if (av_frame_get_buffer(f, 32) < 0)
+            return nullptr;
+
+        // 格式或尺寸变化后旧的缓存帧不再有用
+        m_conversionPool.erase(std::remove_if(m_conversionPool.begin(), m_conversionPool.end(),
+                                              [&](const std::shared_ptr<AVFrameWrapper> &w)
+                                              {
+                                                  const AVFrame *o = w->get();
+                                                  return o->format != format || o->width != width || o->height != height;
+                                              }),
+                               m_conversionPool.end());
+        if (m_conversionPool.size() < kConversionPoolSize)
+            m_conversionPool.push_back(wrapper);
+        return wrapper;
+    }
+
+    bool VideoEncoder::convertFastPath(const AVFrame *src, AVFrame *dst)
+    {
+        const int w = src->width;
+        const int h = src->height;
+        const int cw = (w + 1) / 2;
+        const int ch = (h + 1) / 2;
+        const AVPixelFormat in = (AVPixelFormat)src->format;
+        const AVPixelFormat out = (AVPixelFormat)dst->format;
+
+        if (in == AV_PIX_FMT_NV12 && out == AV_PIX_FMT_YUV420P)
+        {
+            // 亮度平面直接拷贝，色度平面只是 UV 交织 -> 平面的拆分
+            av_image_copy_plane(dst->data[0], dst->linesize[0], src->data[0], src->linesize[0], w, h);
+            for (int y = 0; y < ch; ++y)
+            {
+                const uint8_t *uv = src->data[1] + (size_t)y * src->linesize[1];
+                uint8_t *u = dst->data[1] + (size_t)y * dst->linesize[1];
+                uint8_t *v = dst->data[2] + (size_t)y * dst->linesize[2];
+                for (int x = 0; x < cw; ++x)
+                {
+                    u[x] = uv[2 * x];
+                    v[x] = uv[2 * x + 1];
+                }
+            }
+            return true;
+        }
+
+        if (in == AV_PIX_FMT_YUV420P && out == AV_PIX_FMT_NV12)
+        {
+            av_image_copy_plane(dst->data[0], dst->linesize[0], src->data[0], src->linesize[0], w, h);
+            for (int y = 0; y < ch; ++y)
+            {
+                const uint8_t *u = src->data[1] + (size_t)y * src->linesize[1];
+                const uint8_t *v = src->data[2] + (size_t)y * src->linesize[2];
+                uint8_t *uv = dst->data[1] + (size_t)y * dst->linesize[1];
+                for (int x = 0; x < cw; ++x)
+                {
+                    uv[2 * x] = u[x];
+                    uv[2 * x + 1] = v[x];
+                }
+            }
+            return true;
+        }
+
+        if (in == AV_PIX_FMT_YUVJ420P && out == AV_PIX_FMT_YUV420P)
+        {
+            // Full range -> Limited range：查表完成，亮度 [0,255] -> [16,235]，色度 [0,255] -> [16,240]
+            static const auto luts = []
+            {
+                std::array<std::array<uint8_t, 256>, 2> t{};
+                for (int i = 0; i < 256; ++i)
+                {
+                    t[0][i] = (uint8_t)(16 + (i * 219 + 127) / 255);
+                    int c = (i - 128) * 224;
+                    t[1][i] = (uint8_t)(128 + (c >= 0 ? (c + 127) / 255 : (c - 127) / 255));
+                }
+                return t;
+            }();
+
+            for (int plane = 0; plane < 3; ++plane)
+            {
+                const auto &lut = luts[plane == 0 ? 0 : 1];
+                int pw = plane == 0 ? w : cw;
+                int ph = plane == 0 ? h : ch;
+                for (int y = 0; y < ph; ++y)
+                {
+                    const uint8_t *s = src->data[plane] + (size_t)y * src->linesize[plane];
+                    uint8_t *d = dst->data[plane] + (size_t)y * dst->linesize[plane];
+                    for (int x = 0; x < pw; ++x)
+                        d[x] = lut[s[x]];
+                }
+            }
+            dst->color_range = AVCOL_RANGE_MPEG;
+            return true;
+        }
+
+        return false;
+    }
+
+    void VideoEncoder::reconfigure(int64_t bitRate, int fps)
+    {
+        std::lock_guard<std::mutex> lock(m_configMutex);
+        if (bitRate > 0)
+            m_pendingBitRate = bitRate;
+        if (fps > 0)
+            m_pendingFps = fps;
+        m_configPending = true;
+    }
+
+    bool VideoEncoder::supportsLiveBitrate() const
+    {
+        // nvenc 支持通过 AVCodecContext 动态修改码率 (reconfig_encoder)。
+        // libx264 虽然也支持 x264_encoder_reconfig，但启用 nal-hrd 后拒绝修改 VBV 参数，
+        // 因此和其他编码器一样走 IDR 处的编码器切换。
+        return m_codecName.find("nvenc") != std::string::npos;
+    }
+
+    void VideoEncoder::applyPendingConfig()
+    {
+        int64_t newBitRate = 0;
+        int newFps = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_configMutex);
+            if (!m_configPending)
+                return;
+            newBitRate = m_pendingBitRate > 0 ? m_pendingBitRate : m_bitRate;
+            newFps = m_pendingFps > 0 ? std::min(m_pendingFps, m_fps) : m_outputFps;
+        }
+
+        if (newBitRate == m_bitRate && newFps == m_outputFps)
+        {
+            std::lock_guard<std::mutex> lock(m_configMutex);
+            m_configPending = false;
+            m_pendingBitRate = 0;
+            m_pendingFps = 0;
+            return;
+        }
+
+        if (newFps == m_outputFps && supportsLiveBitrate())
+        {
+            m_bitRate = newBitRate;
+            m_codecCtx->bit_rate = m_bitRate;
+            m_codecCtx->rc_max_rate = m_bitRate;
+            m_codecCtx->rc_buffer_size = m_bitRate * 2;
+            spdlog::info("[VideoEncoder] Live bitrate change to {} kbps", m_bitRate / 1000);
+        }
+        else
+        {
+            // 等到下一个 GOP 边界再切换，新编码器的首帧 IDR 正好替代原本的关键帧
+            if (m_codecCtx && m_framesSinceKeyframe + 1 < m_codecCtx->gop_size)
+                return;
+
+            int64_t oldBitRate = m_bitRate;
+            int oldFps = m_outputFps;
+            m_bitRate = newBitRate;
+            m_outputFps = newFps;
+            if (!swapEncoder())
+            {
+                m_bitRate = oldBitRate;
+                m_outputFps = oldFps;
+            }
+            else
+            {
+                m_fpsAccumulator = m_fps;
+                spdlog::info("[VideoEncoder] Encoder swapped: {} kbps @ {} fps", m_bitRate / 1000, m_outputFps);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_configMutex);
+        m_configPending = false;
+        m_pendingBitRate = 0;
+        m_pendingFps = 0;
+    }
+
+    bool VideoEncoder::swapEncoder()
+    {
+        AVCodecContext *oldCtx = m_codecCtx;
+        AVBufferRef *oldFramesCtx = m_hwFramesCtx;
+        AVBufferRef *oldDeviceCtx = m_hwDeviceCtx;
+        m_codecCtx = nullptr;
+        m_hwFramesCtx = nullptr;
+        m_hwDeviceCtx = nullptr;
+
+        if (!openCodec())
+        {
+            spdlog::error("[VideoEncoder] Failed to open replacement encoder, keeping current one");
+            if (m_codecCtx)
+                avcodec_free_context(&m_codecCtx);
+            if (m_hwFramesCtx)
+                av_buffer_unref(&m_hwFramesCtx);
+            if (m_hwDeviceCtx)
+                av_buffer_unref(&m_hwDeviceCtx);
+            m_codecCtx = oldCtx;
+            m_hwFramesCtx = oldFramesCtx;
+            m_hwDeviceCtx = oldDeviceCtx;
+            return false;
+        }
+
+        // 旧编码器中缓存的帧先送往下游，再释放
+        drainEncoder(oldCtx);
+        avcodec_free_context(&oldCtx);
+        if (oldFramesCtx)
+            av_buffer_unref(&oldFramesCtx);
+        if (oldDeviceCtx)
+            av_buffer_unref(&oldDeviceCtx);
+        m_framesSinceKeyframe = 0;
+        return true;
+    }
+
+    void VideoEncoder::drainEncoder(AVCodecContext *ctx)
+    {
+        if (avcodec_send_frame(ctx, nullptr) < 0)
+            return;
+
+        while (true)
+        {
+            auto pktWrapper = std::make_shared<AVPacketWrapper>();
+            if (avcodec_receive_packet(ctx, pktWrapper->get()) < 0)
+                break;
+            m_profiler.onPacket(pktWrapper->get());
+            if (m_next)
+                m_next->process(pktWrapper);
+        }
+    }
+
+    void VideoEncoder::flush()
+    {
+        if (m_codecCtx)
+            drainEncoder(m_codecCtx);
+    }
+
     void VideoEncoder::stop()
     {
         // Flush encoder
@@ -0,0 +1,250 @@
+// 解码线程模型基准：对同一码流分别用 Single / Slice / Frame / FrameSlice / Auto 解码，
+// 输出每帧延迟 (送包 -> 出帧) 与吞吐。
+// 用法: bench_decoder_threading [input_file]
+// 不带参数时用 libx264 (4 slice) 生成 1080p 合成码流，不可用时回退到 MPEG-4。
+#include "filters/VideoDecoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct Stream
+{
+    AVCodecParameters *params = nullptr;
+    std::vector<AVPacket *> packets;
+};
+
+static bool loadFile(const char *path, Stream &stream)
+{
+    AVFormatContext *fmt = nullptr;
+    if (avformat_open_input(&fmt, path, nullptr, nullptr) < 0 || avformat_find_stream_info(fmt, nullptr) < 0)
+    {
+        std::cerr << "Could not open " << path << std::endl;
+        return false;
+    }
+    int index = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (index < 0)
+    {
+        avformat_close_input(&fmt);
+        return false;
+    }
+
+    stream.params = avcodec_parameters_alloc();
+    avcodec_parameters_copy(stream.params, fmt->streams[index]->codecpar);
+
+    AVPacket *pkt = av_packet_alloc();
+    while (av_read_frame(fmt, pkt) >= 0 && stream.packets.size() < 600)
+    {
+        if (pkt->stream_index == index)
+            stream.packets.push_back(av_packet_clone(pkt));
+        av_packet_unref(pkt);
+    }
+    av_packet_free(&pkt);
+    avformat_close_input(&fmt);
+    return !stream.packets.empty();
+}
+
+static bool synthesize(Stream &stream)
+{
+    const int width = 1920, height = 1080, frames = 300;
+
+    const AVCodec *codec = avcodec_find_encoder_by_name("libx264");
+    bool x264 = codec != nullptr;
+    if (!codec)
+        codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    if (!codec)
+        return false;
+
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    ctx->width = width;
+    ctx->height = height;
+    ctx->time_base = {1, 30};
+    ctx->framerate = {30, 1};
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    ctx->gop_size = 60;
+    ctx->max_b_frames = 0;
+    ctx->bit_rate = 8000000;
+
+    AVDictionary *options = nullptr;
+    if (x264)
+    {
+        av_dict_set(&options, "preset", "ultrafast", 0);
+        av_dict_set(&options, "x264-params", "slices=4:repeat-headers=1", 0);
+    }
+    int ret = avcodec_open2(ctx, codec, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+    {
+        avcodec_free_context(&ctx);
+        return false;
+    }
+    std::cout << "Synthetic " << width << "x" << height << " stream encoded with " << codec->name << std::endl;
+
+    AVFrame *frame = av_frame_alloc();
+    frame->width = width;
+    frame->height = height;
+    frame->format = AV_PIX_FMT_YUV420P;
+    av_frame_get_buffer(frame, 0);
+
+    AVPacket *pkt = av_packet_alloc();
+    for (int i = 0; i <= frames; i++)
+    {
+        AVFrame *input = nullptr;
+        if (i < frames)
+        {
+            av_frame_make_writable(frame);
+            // 斜向移动的渐变，保证每帧都有真实的残差
+            for (int y = 0; y < height; y++)
+            {
+                uint8_t *row = frame->data[0] + y * frame->linesize[0];
+                for (int x = 0; x < width; x++)
+                    row[x] = (uint8_t)((x + y + i * 8) ^ (y * 3));
+            }
+            for (int y = 0; y < height / 2; y++)
+            {
+                memset(frame->data[1] + y * frame->linesize[1], 128 + (i % 32), width / 2);
+                memset(frame->data[2] + y * frame->linesize[2], 128 - (i % 32), width / 2);
+            }
+            frame->pts = i;
+            input = frame;
+        }
+        if (avcodec_send_frame(ctx, input) < 0)
+            break;
+        while (avcodec_receive_packet(ctx, pkt) == 0)
+        {
+            stream.packets.push_back(av_packet_clone(pkt));
+            av_packet_unref(pkt);
+        }
+    }
+
+    stream.params = avcodec_parameters_alloc();
+    avcodec_parameters_from_context(stream.params, ctx);
+
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+    return !stream.packets.empty();
+}
+
+// 记录每帧的出帧时间，按包序号匹配送包时间
+class LatencySink : public pb::Filter
+{
+public:
+    LatencySink(std::map<int64_t, Clock::time_point> &sent) : Filter("LatencySink"), m_sent(sent) {}
+
+    bool initialize() override { return true; }
+    void stop() override {}
+
+    void process(pb::DataPacket::Ptr packet) override
+    {
+        if (packet->type() != pb::PacketType::AV_FRAME)
+            return;
+        AVFrame *frame = std::static_pointer_cast<pb::AVFrameWrapper>(packet)->get();
+        auto it = m_sent.find(frame->best_effort_timestamp);
+        if (it == m_sent.end())
+            return;
+        latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - it->second).count());
+    }
+
+    std::vector<double> latencies;
+
+private:
+    std::map<int64_t, Clock::time_point> &m_sent;
+};
+
+static const char *profileName(pb::VideoDecoder::ThreadingProfile profile)
+{
+    switch (profile)
+    {
+    case pb::VideoDecoder::ThreadingProfile::Auto:
+        return "Auto";
+    case pb::VideoDecoder::ThreadingProfile::Single:
+        return "Single";
+    case pb::VideoDecoder::ThreadingProfile::Slice:
+        return "Slice";
+    case pb::VideoDecoder::ThreadingProfile::Frame:
+        return "Frame";
+    case pb::VideoDecoder::ThreadingProfile::FrameSlice:
+        return "FrameSlice";
+    }
+    return "?";
+}
+
+static void runCase(const Stream &stream, pb::LatencyLevel level, pb::VideoDecoder::ThreadingProfile profile)
+{
+    std::map<int64_t, Clock::time_point> sent;
+    LatencySink sink(sent);
+    pb::VideoDecoder decoder(stream.params);
+    decoder.setLatencyLevel(level);
+    decoder.setLoadShedding(false);
+    decoder.setThreadingProfile(profile);
+    decoder.setNextFilter(&sink);
+    if (!decoder.initialize())
+    {
+        std::cerr << "Failed to initialize decoder" << std::endl;
+        return;
+    }
+
+    auto start = Clock::now();
+    int64_t index = 0;
+    for (auto *pkt : stream.packets)
+    {
+        auto wrapper = std::make_shared<pb::AVPacketWrapper>();
+        av_packet_ref(wrapper->get(), pkt);
+        // 用序号覆盖时间戳，便于与输出帧对应
+        wrapper->get()->pts = wrapper->get()->dts = index;
+        sent[index++] = Clock::now();
+        decoder.process(wrapper);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    auto &lat = sink.latencies;
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&lat](double p)
+    { return lat.empty() ? 0.0 : lat[std::min(lat.size() - 1, (size_t)(p * lat.size()))]; };
+
+    std::cout << std::left << std::setw(10) << profileName(decoder.threadingProfile())
+              << " requested=" << std::setw(10) << profileName(profile)
+              << " threads=" << std::setw(3) << decoder.threadCount()
+              << std::right << std::fixed << std::setprecision(1)
+              << " fps=" << std::setw(7) << (seconds > 0 ? lat.size() / seconds : 0.0)
+              << " p50=" << std::setw(6) << pct(0.5) << "ms"
+              << " p95=" << std::setw(6) << pct(0.95) << "ms"
+              << " max=" << std::setw(6) << (lat.empty() ? 0.0 : lat.back()) << "ms"
+              << " frames=" << lat.size() << "/" << stream.packets.size() << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    Stream stream;
+    bool ok = argc > 1 ? loadFile(argv[1], stream) : synthesize(stream);
+    if (!ok)
+    {
+        std::cerr << "No input stream" << std::endl;
+        return 1;
+    }
+
+    using Profile = pb::VideoDecoder::ThreadingProfile;
+    const Profile profiles[] = {Profile::Single, Profile::Slice, Profile::Frame, Profile::FrameSlice, Profile::Auto};
+    const std::pair<pb::LatencyLevel, const char *> levels[] = {
+        {pb::LatencyLevel::UltraLow, "UltraLow"},
+        {pb::LatencyLevel::Low, "Low"},
+        {pb::LatencyLevel::Standard, "Standard"}};
+
+    for (const auto &level : levels)
+    {
+        std::cout << "== " << level.second << " ==" << std::endl;
+        for (auto profile : profiles)
+            runCase(stream, level.first, profile);
+    }
+
+    for (auto *pkt : stream.packets)
+        av_packet_free(&pkt);
+    avcodec_parameters_free(&stream.params);
+    return 0;
+}
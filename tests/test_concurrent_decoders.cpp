@@ -0,0 +1,221 @@
+// 多路 VideoDecoder 并发解码测试
+// 每路使用不同分辨率与不同亮度的合成码流，在独立线程中同时解码，
+// 校验每路输出的尺寸与像素内容都属于自己的码流 (实例间无状态串扰)。
+#include "filters/VideoDecoder.h"
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+#include <libavutil/imgutils.h>
+}
+
+namespace
+{
+    constexpr int kStreamCount = 4;
+    constexpr int kFramesPerStream = 48;
+
+    struct SyntheticStream
+    {
+        int width = 0;
+        int height = 0;
+        int luma = 0;
+        AVCodecParameters *params = nullptr;
+        std::vector<AVPacket *> packets;
+
+        ~SyntheticStream()
+        {
+            for (auto *pkt : packets)
+                av_packet_free(&pkt);
+            avcodec_parameters_free(&params);
+        }
+    };
+
+    // 用 FFmpeg 内置的 MPEG-4 编码器生成码流，无需任何外部编码库
+    bool encodeStream(SyntheticStream &stream)
+    {
+        const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+        if (!codec)
+        {
+            std::cerr << "MPEG-4 encoder not available" << std::endl;
+            return false;
+        }
+
+        AVCodecContext *ctx = avcodec_alloc_context3(codec);
+        ctx->width = stream.width;
+        ctx->height = stream.height;
+        ctx->time_base = {1, 30};
+        ctx->framerate = {30, 1};
+        ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+        ctx->gop_size = 12;
+        ctx->max_b_frames = 0;
+        ctx->bit_rate = 1000000;
+        if (avcodec_open2(ctx, codec, nullptr) < 0)
+        {
+            avcodec_free_context(&ctx);
+            return false;
+        }
+
+        AVFrame *frame = av_frame_alloc();
+        frame->width = stream.width;
+        frame->height = stream.height;
+        frame->format = AV_PIX_FMT_YUV420P;
+        av_frame_get_buffer(frame, 0);
+
+        AVPacket *pkt = av_packet_alloc();
+        for (int i = 0; i <= kFramesPerStream; i++)
+        {
+            AVFrame *input = nullptr;
+            if (i < kFramesPerStream)
+            {
+                av_frame_make_writable(frame);
+                // 亮度恒定 (每路不同)，加一个移动的小方块避免编码器输出全跳过宏块
+                for (int y = 0; y < stream.height; y++)
+                    memset(frame->data[0] + y * frame->linesize[0], stream.luma, stream.width);
+                for (int y = 0; y < 8; y++)
+                    memset(frame->data[0] + y * frame->linesize[0] + (i * 4) % (stream.width - 8), 255 - stream.luma, 8);
+                for (int y = 0; y < stream.height / 2; y++)
+                {
+                    memset(frame->data[1] + y * frame->linesize[1], 128, stream.width / 2);
+                    memset(frame->data[2] + y * frame->linesize[2], 128, stream.width / 2);
+                }
+                frame->pts = i;
+                input = frame;
+            }
+
+            if (avcodec_send_frame(ctx, input) < 0)
+                break;
+            while (avcodec_receive_packet(ctx, pkt) == 0)
+            {
+                stream.packets.push_back(av_packet_clone(pkt));
+                av_packet_unref(pkt);
+            }
+        }
+
+        stream.params = avcodec_parameters_alloc();
+        avcodec_parameters_from_context(stream.params, ctx);
+
+        av_packet_free(&pkt);
+        av_frame_free(&frame);
+        avcodec_free_context(&ctx);
+        return !stream.packets.empty();
+    }
+
+    // 解码输出的终点：统计帧数并检查尺寸与平均亮度
+    class FrameChecker : public pb::Filter
+    {
+    public:
+        FrameChecker(const SyntheticStream &stream) : Filter("FrameChecker"), m_stream(stream) {}
+
+        bool initialize() override { return true; }
+        void stop() override {}
+
+        void process(pb::DataPacket::Ptr packet) override
+        {
+            if (packet->type() != pb::PacketType::AV_FRAME)
+                return;
+            AVFrame *frame = std::static_pointer_cast<pb::AVFrameWrapper>(packet)->get();
+
+            m_frames++;
+            if (frame->width != m_stream.width || frame->height != m_stream.height)
+            {
+                m_errors++;
+                return;
+            }
+
+            // 取底部一行 (远离移动方块) 的平均亮度
+            const uint8_t *row = frame->data[0] + (frame->height - 1) * frame->linesize[0];
+            long sum = 0;
+            for (int x = 0; x < frame->width; x++)
+                sum += row[x];
+            double mean = (double)sum / frame->width;
+            if (std::abs(mean - m_stream.luma) > 6.0)
+                m_errors++;
+        }
+
+        int frames() const { return m_frames; }
+        int errors() const { return m_errors; }
+
+    private:
+        const SyntheticStream &m_stream;
+        int m_frames = 0;
+        int m_errors = 0;
+    };
+} // namespace
+
+int main()
+{
+    static const int sizes[kStreamCount][2] = {{320, 240}, {640, 360}, {176, 144}, {480, 272}};
+
+    std::vector<std::unique_ptr<SyntheticStream>> streams;
+    for (int i = 0; i < kStreamCount; i++)
+    {
+        auto stream = std::make_unique<SyntheticStream>();
+        stream->width = sizes[i][0];
+        stream->height = sizes[i][1];
+        stream->luma = 40 + i * 50;
+        if (!encodeStream(*stream))
+        {
+            std::cerr << "Failed to encode synthetic stream " << i << std::endl;
+            return 1;
+        }
+        streams.push_back(std::move(stream));
+    }
+
+    std::atomic<int> failures{0};
+    std::mutex printMutex;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kStreamCount; i++)
+    {
+        threads.emplace_back([&, i]()
+                             {
+            const SyntheticStream &stream = *streams[i];
+            FrameChecker checker(stream);
+            pb::VideoDecoder decoder(stream.params);
+            decoder.setNextFilter(&checker);
+            if (!decoder.initialize())
+            {
+                failures++;
+                return;
+            }
+
+            // 循环送入多遍，拉长并发重叠的时间窗口
+            for (int pass = 0; pass < 4; pass++)
+            {
+                for (auto *pkt : stream.packets)
+                {
+                    auto wrapper = std::make_shared<pb::AVPacketWrapper>();
+                    av_packet_ref(wrapper->get(), pkt);
+                    decoder.process(wrapper);
+                }
+            }
+
+            // 多线程解码会暂存少量帧，这里只要求绝大多数帧已输出
+            int expected = (int)stream.packets.size() * 4;
+            bool ok = checker.errors() == 0 && checker.frames() >= expected - 16;
+            if (!ok)
+                failures++;
+
+            std::lock_guard<std::mutex> lock(printMutex);
+            std::cout << "stream " << i << " (" << stream.width << "x" << stream.height << "): "
+                      << checker.frames() << "/" << expected << " frames, "
+                      << checker.errors() << " errors " << (ok ? "OK" : "FAILED") << std::endl; });
+    }
+
+    for (auto &t : threads)
+        t.join();
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " decoder(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All " << kStreamCount << " concurrent decoders passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,123 @@
+// JitterBuffer 测试：以 30fps 的节奏送入带乱序、到达抖动和丢帧的包序列，
+// 校验输出严格按时间戳递增、乱序包没有被丢弃，且丢失帧数按时间戳间隔统计正确。
+#include "filters/JitterBuffer.h"
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr AVRational kTimeBase = {1, 90000};
+    constexpr int64_t kFrameDuration = 3000; // 30fps
+    constexpr int kFrameCount = 150;
+
+    class OrderChecker : public pb::Filter
+    {
+    public:
+        OrderChecker() : Filter("OrderChecker") {}
+
+        bool initialize() override { return true; }
+        void stop() override {}
+
+        void process(pb::DataPacket::Ptr packet) override
+        {
+            AVPacket *pkt = std::static_pointer_cast<pb::AVPacketWrapper>(packet)->get();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (pkt->dts <= m_last)
+                m_errors++;
+            m_last = pkt->dts;
+            m_count++;
+        }
+
+        int count()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_count;
+        }
+        int errors()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_errors;
+        }
+
+    private:
+        std::mutex m_mutex;
+        int64_t m_last = -1;
+        int m_count = 0;
+        int m_errors = 0;
+    };
+}
+
+int main()
+{
+    // 每 10 帧交换一对相邻帧，每 50 帧丢一帧
+    std::vector<int> order;
+    int dropped = 0;
+    for (int i = 0; i < kFrameCount; i++)
+    {
+        if (i % 50 == 25)
+        {
+            dropped++;
+            continue;
+        }
+        order.push_back(i);
+    }
+    int swapped = 0;
+    for (size_t i = 5; i + 1 < order.size(); i += 10)
+    {
+        std::swap(order[i], order[i + 1]);
+        swapped++;
+    }
+
+    OrderChecker checker;
+    pb::JitterBuffer jitter(kTimeBase);
+    jitter.setLatencyLevel(pb::LatencyLevel::Standard);
+    jitter.setNextFilter(&checker);
+    if (!jitter.initialize())
+    {
+        std::cerr << "Failed to initialize jitter buffer" << std::endl;
+        return 1;
+    }
+    jitter.start();
+
+    // 到达时间 = 媒体时间 + 0~8ms 的随机抖动
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> jitterUs(0, 8000);
+    auto start = std::chrono::steady_clock::now();
+    for (int index : order)
+    {
+        auto arrival = start + std::chrono::microseconds(index * 1000000LL / 30 + jitterUs(rng));
+        std::this_thread::sleep_until(arrival);
+
+        auto wrapper = std::make_shared<pb::AVPacketWrapper>();
+        av_new_packet(wrapper->get(), 16);
+        wrapper->get()->pts = wrapper->get()->dts = index * kFrameDuration;
+        wrapper->get()->duration = kFrameDuration;
+        jitter.process(wrapper);
+    }
+
+    // 等待缓冲中的包全部送出
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (checker.count() < (int)order.size() && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto stats = jitter.stats();
+    jitter.stop();
+
+    bool ok = checker.errors() == 0 &&
+              checker.count() == (int)order.size() &&
+              stats.late == 0 &&
+              stats.reordered == (uint64_t)swapped &&
+              stats.lost == (uint64_t)dropped;
+
+    std::cout << "released " << checker.count() << "/" << order.size()
+              << ", order errors " << checker.errors()
+              << ", reordered " << stats.reordered << "/" << swapped
+              << ", late " << stats.late
+              << ", lost " << stats.lost << "/" << dropped
+              << ", jitter " << stats.jitterMs << " ms, delay " << stats.delayMs << " ms "
+              << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}